@@ -0,0 +1,43 @@
+#ifndef RADAR_ENCODE_H
+#define RADAR_ENCODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "radar_frame.h"
+
+// Builders for every command the firmware sends to the R60AFD1. Each writes a
+// complete frame into buf and returns its length (0 if cap is too small).
+// Range checks are left to the caller; values are encoded as given.
+
+// Single-byte query (e.g. 0x83/0x0E height proportion with payload 0x0F)
+size_t radar_encode_query(uint8_t *buf, size_t cap, uint8_t control, uint8_t command, uint8_t payload);
+
+// 0x80/0x00
+size_t radar_encode_presence_detection(uint8_t *buf, size_t cap, bool enable);
+// 0x06/0x01, degrees, 3 x int16 big-endian (the reply is decoded the same way)
+size_t radar_encode_installation_angles(uint8_t *buf, size_t cap, int16_t x, int16_t y, int16_t z);
+// 0x06/0x02, cm, big-endian
+size_t radar_encode_installation_height(uint8_t *buf, size_t cap, uint16_t height_cm);
+// 0x83/0x01
+size_t radar_encode_fall_switch(uint8_t *buf, size_t cap, bool enable);
+// 0x83/0x0D, 0..3
+size_t radar_encode_fall_sensitivity(uint8_t *buf, size_t cap, uint8_t sensitivity);
+// 0x83/0x0C, seconds, big-endian
+size_t radar_encode_fall_duration(uint8_t *buf, size_t cap, uint32_t seconds);
+// 0x83/0x11, cm, big-endian
+size_t radar_encode_fall_breaking_height(uint8_t *buf, size_t cap, uint16_t height_cm);
+// 0x80/0x0D, cm, big-endian
+size_t radar_encode_sitting_still_distance(uint8_t *buf, size_t cap, uint16_t distance_cm);
+// 0x80/0x0E, cm, big-endian
+size_t radar_encode_moving_distance(uint8_t *buf, size_t cap, uint16_t distance_cm);
+// 0x83/0x0B, 1-byte payload
+size_t radar_encode_stay_still_switch(uint8_t *buf, size_t cap, bool enable);
+// 0x83/0x0A, seconds, big-endian
+size_t radar_encode_stay_still_duration(uint8_t *buf, size_t cap, uint32_t seconds);
+// 0x83/0x8F, seconds, big-endian
+size_t radar_encode_height_accumulation_time(uint8_t *buf, size_t cap, uint32_t seconds);
+// 0x80/0x12, seconds, big-endian; the radar answers on the same opcode
+size_t radar_encode_non_presence_time(uint8_t *buf, size_t cap, uint32_t seconds);
+
+#endif // RADAR_ENCODE_H
@@ -0,0 +1,102 @@
+#ifndef RADAR_FRAME_H
+#define RADAR_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// R60AFD1 frame layout:
+// HEADER (2) + CONTROL (1) + COMMAND (1) + LENGTH (2, big-endian) + PAYLOAD (n) + CHECK (1) + TAIL (2)
+#define FRAME_HEADER0      0x53
+#define FRAME_HEADER1      0x59
+#define FRAME_TAIL0        0x54
+#define FRAME_TAIL1        0x43
+
+#define RADAR_FRAME_PREFIX_LEN     6    // header + control + command + length
+#define RADAR_FRAME_OVERHEAD       9    // prefix + check + tail
+#define RADAR_FRAME_MAX_PAYLOAD    128  // longest report we accept; longer lengths are treated as noise
+#define RADAR_FRAME_MAX_LEN        (RADAR_FRAME_MAX_PAYLOAD + RADAR_FRAME_OVERHEAD)
+
+// Ring buffer size for the streaming decoder (must be a power of two and
+// comfortably larger than RADAR_FRAME_MAX_LEN so a partial frame never blocks new input).
+#define RADAR_DECODER_RING_SIZE    512
+
+// A complete, checksum-verified frame. raw/payload point into the decoder's
+// scratch buffer and are only valid for the duration of the callback.
+typedef struct {
+    uint8_t control;
+    uint8_t command;
+    uint16_t payload_len;
+    const uint8_t *payload;
+    const uint8_t *raw;
+    uint16_t raw_len;
+} radar_frame_t;
+
+typedef void (*radar_frame_cb_t)(const radar_frame_t *frame, void *ctx);
+
+typedef struct {
+    uint32_t frames;            // frames delivered to the callback
+    uint32_t checksum_errors;   // frames dropped because the check byte did not match
+    uint32_t tail_errors;       // candidate frames without a valid 0x54 0x43 tail
+    uint32_t length_errors;     // candidate frames with an impossible length field
+    uint32_t resyncs;           // times the decoder had to hunt for the next header
+    uint32_t bytes_discarded;   // bytes skipped while looking for a header
+} radar_decoder_stats_t;
+
+typedef enum {
+    RADAR_DEC_SEEK_HEADER = 0,  // looking for 0x53 0x59
+    RADAR_DEC_READ_PREFIX,      // header found, waiting for control/command/length
+    RADAR_DEC_READ_BODY,        // length known, waiting for payload + check + tail
+} radar_decoder_state_t;
+
+// Incremental frame decoder. Bytes are pushed in whatever chunks the UART
+// delivers them; partial frames are carried over to the next call.
+typedef struct {
+    uint8_t ring[RADAR_DECODER_RING_SIZE];
+    uint16_t head;              // write index (free-running, masked on access)
+    uint16_t tail;              // read index: first byte of the current candidate frame
+    radar_decoder_state_t state;
+    uint16_t frame_len;         // total length of the frame being read (valid in READ_BODY)
+    uint8_t scratch[RADAR_FRAME_MAX_LEN];
+    radar_frame_cb_t cb;
+    void *cb_ctx;
+    radar_decoder_stats_t stats;
+} radar_decoder_t;
+
+// Payload field encodings for radar_frame_encode. The radar mixes byte orders
+// between commands, so every multi-byte field states its own.
+typedef enum {
+    RADAR_FIELD_U8 = 0,
+    RADAR_FIELD_U16_BE,
+    RADAR_FIELD_U16_LE,
+    RADAR_FIELD_U32_BE,
+    RADAR_FIELD_U32_LE,
+} radar_field_type_t;
+
+typedef struct {
+    radar_field_type_t type;
+    uint32_t value;             // signed values are passed through (uint32_t) and truncated
+} radar_field_t;
+
+#define RADAR_U8(v)         ((radar_field_t){ RADAR_FIELD_U8, (uint32_t)(v) })
+#define RADAR_U16_BE(v)     ((radar_field_t){ RADAR_FIELD_U16_BE, (uint32_t)(v) })
+#define RADAR_U16_LE(v)     ((radar_field_t){ RADAR_FIELD_U16_LE, (uint32_t)(v) })
+#define RADAR_U32_BE(v)     ((radar_field_t){ RADAR_FIELD_U32_BE, (uint32_t)(v) })
+#define RADAR_U32_LE(v)     ((radar_field_t){ RADAR_FIELD_U32_LE, (uint32_t)(v) })
+
+// Build a complete frame (header, length, payload, check, tail) into buf.
+// Returns the frame length, or 0 if it does not fit in cap.
+size_t radar_frame_encode(uint8_t *buf, size_t cap, uint8_t control, uint8_t command,
+                          const radar_field_t *fields, size_t count);
+
+// radar_frame_encode into an array with the fields given inline, e.g.
+// RADAR_FRAME_ENCODE(frame, 0x06, 0x02, RADAR_U16_BE(height))
+#define RADAR_FRAME_ENCODE(buf, control, command, ...) \
+    radar_frame_encode((buf), sizeof(buf), (control), (command), \
+                       (const radar_field_t[]){ __VA_ARGS__ }, \
+                       sizeof((const radar_field_t[]){ __VA_ARGS__ }) / sizeof(radar_field_t))
+
+void radar_decoder_init(radar_decoder_t *dec, radar_frame_cb_t cb, void *ctx);
+void radar_decoder_reset(radar_decoder_t *dec);
+void radar_decoder_feed(radar_decoder_t *dec, const uint8_t *data, size_t len);
+
+#endif // RADAR_FRAME_H
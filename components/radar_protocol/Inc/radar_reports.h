@@ -0,0 +1,81 @@
+#ifndef RADAR_REPORTS_H
+#define RADAR_REPORTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "radar_frame.h"
+
+#define RADAR_REPORT_TEXT_LEN 32
+
+// Report kinds understood by the decoder. Several opcodes can map to the same
+// kind (e.g. heartbeat arrives as 0x80/0x04 and as 0x01/0x01).
+typedef enum {
+    RADAR_RPT_NONE = 0,
+    RADAR_RPT_PRESENCE,
+    RADAR_RPT_WORKING_STATUS,
+    RADAR_RPT_WORKING_STATUS_ACK,
+    RADAR_RPT_MOVEMENT_STATE,
+    RADAR_RPT_BODY_MOVEMENT,
+    RADAR_RPT_FALL_ALARM,
+    RADAR_RPT_STAY_STILL_ALARM,
+    RADAR_RPT_HEARTBEAT,
+    RADAR_RPT_TRAJECTORY,
+    RADAR_RPT_HEIGHT_PROPORTION,
+    RADAR_RPT_NON_PRESENCE_TIME,
+    RADAR_RPT_SCENARIO,
+    RADAR_RPT_INSTALL_ANGLES,
+    RADAR_RPT_INSTALL_HEIGHT,
+    RADAR_RPT_FALL_PARAMS,
+    RADAR_RPT_FALL_SENSITIVITY,
+    RADAR_RPT_FALL_DURATION,
+    RADAR_RPT_FALL_BREAKING_HEIGHT,
+    RADAR_RPT_SITTING_STILL_DISTANCE,
+    RADAR_RPT_MOVING_DISTANCE,
+    RADAR_RPT_PRODUCT_MODEL,
+    RADAR_RPT_PRODUCT_ID,
+    RADAR_RPT_HARDWARE_MODEL,
+    RADAR_RPT_FIRMWARE_VERSION,
+    RADAR_RPT_OPERATING_TIME,
+    RADAR_RPT_STAY_STILL_SWITCH,
+    RADAR_RPT_STAY_STILL_DURATION,
+    RADAR_RPT_HEIGHT_ACCUMULATION_TIME,
+    RADAR_RPT_HEIGHT_MEASUREMENT,
+    RADAR_RPT_COUNT
+} radar_report_id_t;
+
+// A decoded report. Which union member is valid depends on id.
+typedef struct {
+    radar_report_id_t id;
+    uint8_t control;
+    uint8_t command;
+    bool fallback;      // decoded by the 6-byte height-proportion fallback, not by opcode
+    union {
+        bool flag;
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        struct { int16_t x, y; } traj;
+        struct { int16_t x, y, z; } angles;
+        struct { uint16_t total; uint8_t prop[4]; } height_prop;
+        struct { uint8_t sensitivity; uint32_t duration; uint16_t breaking_height; } fall;
+        char text[RADAR_REPORT_TEXT_LEN];
+    };
+} radar_report_t;
+
+// Look up the frame's opcode and decode its payload. Returns false for
+// unknown opcodes or unexpected payload lengths; those are counted per opcode.
+bool radar_report_decode(const radar_frame_t *frame, radar_report_t *out);
+
+// Number of frames seen so far with this unknown opcode (0 if it is known).
+uint32_t radar_reports_unknown_count(uint8_t control, uint8_t command);
+
+// Short lower-case name of a report kind, for logs and tools.
+const char *radar_report_name(radar_report_id_t id);
+
+typedef void (*radar_unknown_cb_t)(uint8_t control, uint8_t command, uint32_t count, void *ctx);
+
+// Walk the unknown-opcode counters. Returns the number of frames whose opcode
+// did not fit in the counter table.
+uint32_t radar_reports_foreach_unknown(radar_unknown_cb_t cb, void *ctx);
+
+#endif // RADAR_REPORTS_H
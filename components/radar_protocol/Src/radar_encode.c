@@ -0,0 +1,76 @@
+#include "radar_encode.h"
+
+#define ENCODE(buf, cap, control, command, ...) \
+    radar_frame_encode((buf), (cap), (control), (command), \
+                       (const radar_field_t[]){ __VA_ARGS__ }, \
+                       sizeof((const radar_field_t[]){ __VA_ARGS__ }) / sizeof(radar_field_t))
+
+size_t radar_encode_query(uint8_t *buf, size_t cap, uint8_t control, uint8_t command, uint8_t payload)
+{
+    return ENCODE(buf, cap, control, command, RADAR_U8(payload));
+}
+
+size_t radar_encode_presence_detection(uint8_t *buf, size_t cap, bool enable)
+{
+    return ENCODE(buf, cap, 0x80, 0x00, RADAR_U8(enable ? 0x01 : 0x00));
+}
+
+size_t radar_encode_installation_angles(uint8_t *buf, size_t cap, int16_t x, int16_t y, int16_t z)
+{
+    return ENCODE(buf, cap, 0x06, 0x01, RADAR_U16_BE(x), RADAR_U16_BE(y), RADAR_U16_BE(z));
+}
+
+size_t radar_encode_installation_height(uint8_t *buf, size_t cap, uint16_t height_cm)
+{
+    return ENCODE(buf, cap, 0x06, 0x02, RADAR_U16_BE(height_cm));
+}
+
+size_t radar_encode_fall_switch(uint8_t *buf, size_t cap, bool enable)
+{
+    return ENCODE(buf, cap, 0x83, 0x01, RADAR_U8(enable ? 0x01 : 0x00));
+}
+
+size_t radar_encode_fall_sensitivity(uint8_t *buf, size_t cap, uint8_t sensitivity)
+{
+    return ENCODE(buf, cap, 0x83, 0x0D, RADAR_U8(sensitivity));
+}
+
+size_t radar_encode_fall_duration(uint8_t *buf, size_t cap, uint32_t seconds)
+{
+    return ENCODE(buf, cap, 0x83, 0x0C, RADAR_U32_BE(seconds));
+}
+
+size_t radar_encode_fall_breaking_height(uint8_t *buf, size_t cap, uint16_t height_cm)
+{
+    return ENCODE(buf, cap, 0x83, 0x11, RADAR_U16_BE(height_cm));
+}
+
+size_t radar_encode_sitting_still_distance(uint8_t *buf, size_t cap, uint16_t distance_cm)
+{
+    return ENCODE(buf, cap, 0x80, 0x0D, RADAR_U16_BE(distance_cm));
+}
+
+size_t radar_encode_moving_distance(uint8_t *buf, size_t cap, uint16_t distance_cm)
+{
+    return ENCODE(buf, cap, 0x80, 0x0E, RADAR_U16_BE(distance_cm));
+}
+
+size_t radar_encode_stay_still_switch(uint8_t *buf, size_t cap, bool enable)
+{
+    return ENCODE(buf, cap, 0x83, 0x0B, RADAR_U8(enable ? 0x01 : 0x00));
+}
+
+size_t radar_encode_stay_still_duration(uint8_t *buf, size_t cap, uint32_t seconds)
+{
+    return ENCODE(buf, cap, 0x83, 0x0A, RADAR_U32_BE(seconds));
+}
+
+size_t radar_encode_height_accumulation_time(uint8_t *buf, size_t cap, uint32_t seconds)
+{
+    return ENCODE(buf, cap, 0x83, 0x8F, RADAR_U32_BE(seconds));
+}
+
+size_t radar_encode_non_presence_time(uint8_t *buf, size_t cap, uint32_t seconds)
+{
+    return ENCODE(buf, cap, 0x80, 0x12, RADAR_U32_BE(seconds));
+}
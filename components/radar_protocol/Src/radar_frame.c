@@ -0,0 +1,255 @@
+#include <string.h>
+#include <stdbool.h>
+#include "radar_frame.h"
+
+#define RING_MASK (RADAR_DECODER_RING_SIZE - 1)
+
+_Static_assert((RADAR_DECODER_RING_SIZE & RING_MASK) == 0, "ring size must be a power of two");
+_Static_assert(RADAR_DECODER_RING_SIZE > 2 * RADAR_FRAME_MAX_LEN, "ring must hold a full frame plus new input");
+
+static inline uint16_t ring_used(const radar_decoder_t *dec)
+{
+    return (uint16_t)(dec->head - dec->tail);
+}
+
+static inline uint8_t ring_at(const radar_decoder_t *dec, uint16_t offset)
+{
+    return dec->ring[(uint16_t)(dec->tail + offset) & RING_MASK];
+}
+
+static inline void ring_discard(radar_decoder_t *dec, uint16_t n)
+{
+    dec->tail += n;
+    dec->stats.bytes_discarded += n;
+}
+
+// Copy n bytes starting at the read index into dst, handling wrap-around.
+static void ring_copy(const radar_decoder_t *dec, uint8_t *dst, uint16_t n)
+{
+    uint16_t start = dec->tail & RING_MASK;
+    uint16_t first = RADAR_DECODER_RING_SIZE - start;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, &dec->ring[start], first);
+    memcpy(dst + first, dec->ring, n - first);
+}
+
+// Drop bytes until the ring starts with 0x53 0x59. Uses memchr over the
+// contiguous ring segments rather than testing one byte per iteration.
+// Returns false if more input is needed (a lone 0x53 is kept at the end).
+static bool seek_header(radar_decoder_t *dec)
+{
+    uint16_t used = ring_used(dec);
+    while (used > 0) {
+        uint16_t start = dec->tail & RING_MASK;
+        uint16_t span = RADAR_DECODER_RING_SIZE - start;
+        if (span > used) {
+            span = used;
+        }
+        const uint8_t *hit = memchr(&dec->ring[start], FRAME_HEADER0, span);
+        if (hit == NULL) {
+            ring_discard(dec, span);
+            used -= span;
+            continue;
+        }
+        uint16_t skip = (uint16_t)(hit - &dec->ring[start]);
+        ring_discard(dec, skip);
+        used -= skip;
+        if (used < 2) {
+            return false;
+        }
+        if (ring_at(dec, 1) == FRAME_HEADER1) {
+            return true;
+        }
+        ring_discard(dec, 1);
+        used -= 1;
+    }
+    return false;
+}
+
+// The candidate at the read index is not a frame: step over its header and
+// go back to hunting for the next one.
+static void resync(radar_decoder_t *dec)
+{
+    dec->stats.resyncs++;
+    ring_discard(dec, 2);
+    dec->state = RADAR_DEC_SEEK_HEADER;
+}
+
+static void process(radar_decoder_t *dec)
+{
+    for (;;) {
+        switch (dec->state) {
+        case RADAR_DEC_SEEK_HEADER:
+            if (!seek_header(dec)) {
+                return;
+            }
+            dec->state = RADAR_DEC_READ_PREFIX;
+            // fall through
+        case RADAR_DEC_READ_PREFIX: {
+            if (ring_used(dec) < RADAR_FRAME_PREFIX_LEN) {
+                return;
+            }
+            uint16_t payload_len = ((uint16_t)ring_at(dec, 4) << 8) | ring_at(dec, 5);
+            if (payload_len > RADAR_FRAME_MAX_PAYLOAD) {
+                dec->stats.length_errors++;
+                resync(dec);
+                continue;
+            }
+            dec->frame_len = payload_len + RADAR_FRAME_OVERHEAD;
+            dec->state = RADAR_DEC_READ_BODY;
+        }
+            // fall through
+        case RADAR_DEC_READ_BODY: {
+            uint16_t frame_len = dec->frame_len;
+            if (ring_used(dec) < frame_len) {
+                return;
+            }
+            if (ring_at(dec, frame_len - 2) != FRAME_TAIL0 ||
+                ring_at(dec, frame_len - 1) != FRAME_TAIL1) {
+                dec->stats.tail_errors++;
+                resync(dec);
+                continue;
+            }
+
+            ring_copy(dec, dec->scratch, frame_len);
+            dec->tail += frame_len;
+            dec->state = RADAR_DEC_SEEK_HEADER;
+
+            // Check digit: low byte of the sum of everything before it.
+            uint16_t payload_len = frame_len - RADAR_FRAME_OVERHEAD;
+            uint32_t sum = 0;
+            for (uint16_t j = 0; j < RADAR_FRAME_PREFIX_LEN + payload_len; j++) {
+                sum += dec->scratch[j];
+            }
+            if ((uint8_t)(sum & 0xFF) != dec->scratch[RADAR_FRAME_PREFIX_LEN + payload_len]) {
+                // Tail matched, so the boundaries are right; drop the whole frame.
+                dec->stats.checksum_errors++;
+                continue;
+            }
+
+            dec->stats.frames++;
+            if (dec->cb) {
+                radar_frame_t frame = {
+                    .control = dec->scratch[2],
+                    .command = dec->scratch[3],
+                    .payload_len = payload_len,
+                    .payload = &dec->scratch[RADAR_FRAME_PREFIX_LEN],
+                    .raw = dec->scratch,
+                    .raw_len = frame_len,
+                };
+                dec->cb(&frame, dec->cb_ctx);
+            }
+            break;
+        }
+        }
+    }
+}
+
+static const uint8_t s_field_size[] = {
+    [RADAR_FIELD_U8] = 1,
+    [RADAR_FIELD_U16_BE] = 2,
+    [RADAR_FIELD_U16_LE] = 2,
+    [RADAR_FIELD_U32_BE] = 4,
+    [RADAR_FIELD_U32_LE] = 4,
+};
+
+size_t radar_frame_encode(uint8_t *buf, size_t cap, uint8_t control, uint8_t command,
+                          const radar_field_t *fields, size_t count)
+{
+    size_t payload_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        payload_len += s_field_size[fields[i].type];
+    }
+    size_t frame_len = payload_len + RADAR_FRAME_OVERHEAD;
+    if (payload_len > RADAR_FRAME_MAX_PAYLOAD || frame_len > cap) {
+        return 0;
+    }
+
+    // The check digit (low byte of the sum of everything before it) is
+    // accumulated while the bytes are written.
+    uint8_t *p = buf;
+    uint8_t check = 0;
+#define PUT(b) do { uint8_t b_ = (uint8_t)(b); check += b_; *p++ = b_; } while (0)
+    PUT(FRAME_HEADER0);
+    PUT(FRAME_HEADER1);
+    PUT(control);
+    PUT(command);
+    PUT(payload_len >> 8);
+    PUT(payload_len);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = fields[i].value;
+        switch (fields[i].type) {
+        case RADAR_FIELD_U8:
+            PUT(v);
+            break;
+        case RADAR_FIELD_U16_BE:
+            PUT(v >> 8);
+            PUT(v);
+            break;
+        case RADAR_FIELD_U16_LE:
+            PUT(v);
+            PUT(v >> 8);
+            break;
+        case RADAR_FIELD_U32_BE:
+            PUT(v >> 24);
+            PUT(v >> 16);
+            PUT(v >> 8);
+            PUT(v);
+            break;
+        case RADAR_FIELD_U32_LE:
+            PUT(v);
+            PUT(v >> 8);
+            PUT(v >> 16);
+            PUT(v >> 24);
+            break;
+        }
+    }
+#undef PUT
+    *p++ = check;
+    *p++ = FRAME_TAIL0;
+    *p++ = FRAME_TAIL1;
+    return frame_len;
+}
+
+void radar_decoder_init(radar_decoder_t *dec, radar_frame_cb_t cb, void *ctx)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->cb = cb;
+    dec->cb_ctx = ctx;
+}
+
+void radar_decoder_reset(radar_decoder_t *dec)
+{
+    dec->head = 0;
+    dec->tail = 0;
+    dec->state = RADAR_DEC_SEEK_HEADER;
+    dec->frame_len = 0;
+}
+
+void radar_decoder_feed(radar_decoder_t *dec, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        uint16_t space = RADAR_DECODER_RING_SIZE - ring_used(dec);
+        if (space == 0) {
+            // Cannot happen while frames are bounded by RADAR_FRAME_MAX_LEN,
+            // but never stall the UART reader if it does.
+            resync(dec);
+            continue;
+        }
+        uint16_t n = len < space ? (uint16_t)len : space;
+        uint16_t start = dec->head & RING_MASK;
+        uint16_t first = RADAR_DECODER_RING_SIZE - start;
+        if (first > n) {
+            first = n;
+        }
+        memcpy(&dec->ring[start], data, first);
+        memcpy(dec->ring, data + first, n - first);
+        dec->head += n;
+        data += n;
+        len -= n;
+
+        process(dec);
+    }
+}
@@ -0,0 +1,297 @@
+#include <string.h>
+#include "radar_reports.h"
+
+typedef void (*radar_decode_fn_t)(const uint8_t *p, uint16_t len, radar_report_t *out);
+
+// ---------------------- Typed payload decoders ----------------------
+
+static void decode_flag(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->flag = (p[0] == 0x01);
+}
+
+static void decode_u8(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->u8 = p[0];
+}
+
+static void decode_u16_be(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->u16 = ((uint16_t)p[0] << 8) | p[1];
+}
+
+static void decode_u32_be(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->u32 = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8)  | p[3];
+}
+
+static void decode_u32_le(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->u32 = ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+               ((uint32_t)p[1] << 8)  | p[0];
+}
+
+// Trajectory point, 2 bytes X + 2 bytes Y
+static void decode_traj_le(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->traj.x = (int16_t)((p[1] << 8) | p[0]);
+    out->traj.y = (int16_t)((p[3] << 8) | p[2]);
+}
+
+static void decode_traj_be(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->traj.x = (int16_t)((p[0] << 8) | p[1]);
+    out->traj.y = (int16_t)((p[2] << 8) | p[3]);
+}
+
+// Installation angles, 3 x 16-bit big-endian (X, Y, Z), the same order
+// radar_encode_installation_angles() sends them in
+static void decode_angles_be(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->angles.x = (int16_t)((p[0] << 8) | p[1]);
+    out->angles.y = (int16_t)((p[2] << 8) | p[3]);
+    out->angles.z = (int16_t)((p[4] << 8) | p[5]);
+}
+
+// Height proportion: total count (16-bit BE) + proportions for 0-0.5, 0.5-1, 1-1.5, 1.5-2 m
+static void decode_height_prop(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->height_prop.total = ((uint16_t)p[0] << 8) | p[1];
+    memcpy(out->height_prop.prop, &p[2], 4);
+}
+
+// Fall parameters: sensitivity (1) + duration (4, LE) + breaking height (2, LE)
+static void decode_fall_params(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->fall.sensitivity = p[0];
+    out->fall.duration = ((uint32_t)p[4] << 24) | ((uint32_t)p[3] << 16) |
+                         ((uint32_t)p[2] << 8)  | p[1];
+    out->fall.breaking_height = ((uint16_t)p[6] << 8) | p[5];
+}
+
+static void decode_text(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    if (len > RADAR_REPORT_TEXT_LEN - 1) {
+        len = RADAR_REPORT_TEXT_LEN - 1;
+    }
+    memcpy(out->text, p, len);
+    out->text[len] = '\0';
+}
+
+// 0x82/0x02 is undocumented; working hypothesis is that payload byte [1] is a height in cm.
+static void decode_height_measurement(const uint8_t *p, uint16_t len, radar_report_t *out)
+{
+    out->u16 = p[1];
+}
+
+// ---------------------- Dispatch table ----------------------
+
+// Control bytes that carry reports. Add a line here when a new control family shows up.
+#define RADAR_CONTROL_LIST(X) \
+    X(0x01) X(0x02) X(0x03) X(0x05) X(0x06) X(0x80) X(0x82) X(0x83)
+
+// The one place to register a report:
+//   X(name, control, command, min payload len, max payload len, report id, decoder)
+#define RADAR_REPORT_TABLE(X) \
+    X(HEARTBEAT_ACK,        0x01, 0x01, 1, 1, RADAR_RPT_HEARTBEAT,               decode_u8) \
+    X(PRODUCT_MODEL,        0x02, 0xA1, 1, RADAR_FRAME_MAX_PAYLOAD, RADAR_RPT_PRODUCT_MODEL,    decode_text) \
+    X(PRODUCT_ID,           0x02, 0xA2, 1, RADAR_FRAME_MAX_PAYLOAD, RADAR_RPT_PRODUCT_ID,       decode_text) \
+    X(HARDWARE_MODEL,       0x02, 0xA3, 1, RADAR_FRAME_MAX_PAYLOAD, RADAR_RPT_HARDWARE_MODEL,   decode_text) \
+    X(FIRMWARE_VERSION,     0x02, 0xA4, 1, RADAR_FRAME_MAX_PAYLOAD, RADAR_RPT_FIRMWARE_VERSION, decode_text) \
+    X(OPERATING_TIME,       0x03, 0xB0, 4, 4, RADAR_RPT_OPERATING_TIME,          decode_u32_be) \
+    X(WORKING_STATUS,       0x05, 0x01, 1, 1, RADAR_RPT_WORKING_STATUS,          decode_u8) \
+    X(SCENARIO,             0x05, 0x07, 1, 1, RADAR_RPT_SCENARIO,                decode_u8) \
+    X(WORKING_STATUS_ACK,   0x05, 0x81, 1, 1, RADAR_RPT_WORKING_STATUS_ACK,      decode_u8) \
+    X(INSTALL_ANGLES,       0x06, 0x01, 6, 6, RADAR_RPT_INSTALL_ANGLES,          decode_angles_be) \
+    X(INSTALL_HEIGHT,       0x06, 0x02, 2, 2, RADAR_RPT_INSTALL_HEIGHT,          decode_u16_be) \
+    X(PRESENCE,             0x80, 0x01, 1, 1, RADAR_RPT_PRESENCE,                decode_flag) \
+    X(MOVEMENT_STATE,       0x80, 0x02, 1, 1, RADAR_RPT_MOVEMENT_STATE,          decode_u8) \
+    X(BODY_MOVEMENT,        0x80, 0x03, 1, 1, RADAR_RPT_BODY_MOVEMENT,           decode_u8) \
+    X(HEARTBEAT,            0x80, 0x04, 1, 1, RADAR_RPT_HEARTBEAT,               decode_u8) \
+    X(NON_PRESENCE_LE,      0x80, 0x0A, 4, 4, RADAR_RPT_NON_PRESENCE_TIME,       decode_u32_le) \
+    X(SITTING_STILL_DIST,   0x80, 0x0D, 2, 2, RADAR_RPT_SITTING_STILL_DISTANCE,  decode_u16_be) \
+    X(MOVING_DIST,          0x80, 0x0E, 2, 2, RADAR_RPT_MOVING_DISTANCE,         decode_u16_be) \
+    X(TRAJECTORY_LE,        0x80, 0x10, 4, 4, RADAR_RPT_TRAJECTORY,              decode_traj_le) \
+    X(NON_PRESENCE_BE,      0x80, 0x12, 4, 4, RADAR_RPT_NON_PRESENCE_TIME,       decode_u32_be) \
+    X(HEIGHT_MEASUREMENT,   0x82, 0x02, 11, 11, RADAR_RPT_HEIGHT_MEASUREMENT,    decode_height_measurement) \
+    X(FALL_ALARM,           0x83, 0x01, 1, 1, RADAR_RPT_FALL_ALARM,              decode_flag) \
+    X(FALL_PARAMS,          0x83, 0x02, 7, 7, RADAR_RPT_FALL_PARAMS,             decode_fall_params) \
+    X(STAY_STILL_ALARM,     0x83, 0x05, 1, 1, RADAR_RPT_STAY_STILL_ALARM,        decode_flag) \
+    X(STAY_STILL_DURATION,  0x83, 0x0A, 4, 4, RADAR_RPT_STAY_STILL_DURATION,     decode_u32_be) \
+    X(STAY_STILL_SWITCH,    0x83, 0x0B, 1, 1, RADAR_RPT_STAY_STILL_SWITCH,       decode_flag) \
+    X(FALL_DURATION,        0x83, 0x0C, 4, 4, RADAR_RPT_FALL_DURATION,           decode_u32_be) \
+    X(FALL_SENSITIVITY,     0x83, 0x0D, 1, 1, RADAR_RPT_FALL_SENSITIVITY,        decode_u8) \
+    X(HEIGHT_PROPORTION,    0x83, 0x0E, 6, 6, RADAR_RPT_HEIGHT_PROPORTION,       decode_height_prop) \
+    X(FALL_BREAKING_HEIGHT, 0x83, 0x11, 2, 2, RADAR_RPT_FALL_BREAKING_HEIGHT,    decode_u16_be) \
+    X(TRAJECTORY_BE,        0x83, 0x12, 4, 4, RADAR_RPT_TRAJECTORY,              decode_traj_be) \
+    X(HEIGHT_ACC_TIME,      0x83, 0x8F, 4, 4, RADAR_RPT_HEIGHT_ACCUMULATION_TIME, decode_u32_be)
+
+typedef struct {
+    uint8_t control;
+    uint8_t command;
+    uint8_t min_len;
+    uint8_t max_len;
+    radar_report_id_t id;
+    radar_decode_fn_t decode;
+} radar_report_desc_t;
+
+enum {
+    ROW_NONE = 0,
+#define X(ctl) ROW_##ctl,
+    RADAR_CONTROL_LIST(X)
+#undef X
+    ROW_COUNT
+};
+
+enum {
+    SLOT_NONE = 0,
+#define X(name, ctl, cmd, min, max, id, fn) SLOT_##name,
+    RADAR_REPORT_TABLE(X)
+#undef X
+    SLOT_COUNT
+};
+
+_Static_assert(SLOT_COUNT <= 256, "report slots must fit in a byte");
+
+static const radar_report_desc_t s_report_desc[SLOT_COUNT] = {
+#define X(name, ctl, cmd, min, max, id, fn) [SLOT_##name] = { ctl, cmd, min, max, id, fn },
+    RADAR_REPORT_TABLE(X)
+#undef X
+};
+
+// control byte -> row in s_report_slot
+static const uint8_t s_control_row[256] = {
+#define X(ctl) [ctl] = ROW_##ctl,
+    RADAR_CONTROL_LIST(X)
+#undef X
+};
+
+// [row][command] -> slot in s_report_desc
+static const uint8_t s_report_slot[ROW_COUNT][256] = {
+#define X(name, ctl, cmd, min, max, id, fn) [ROW_##ctl][cmd] = SLOT_##name,
+    RADAR_REPORT_TABLE(X)
+#undef X
+};
+
+// ---------------------- Unknown opcode counters ----------------------
+
+#define RADAR_UNKNOWN_SLOTS 16
+
+typedef struct {
+    uint16_t opcode;    // control << 8 | command
+    uint32_t count;
+} radar_unknown_entry_t;
+
+static radar_unknown_entry_t s_unknown[RADAR_UNKNOWN_SLOTS];
+static uint8_t s_unknown_used;
+static uint32_t s_unknown_overflow;
+
+static void count_unknown(uint8_t control, uint8_t command)
+{
+    uint16_t opcode = ((uint16_t)control << 8) | command;
+    for (uint8_t i = 0; i < s_unknown_used; i++) {
+        if (s_unknown[i].opcode == opcode) {
+            s_unknown[i].count++;
+            return;
+        }
+    }
+    if (s_unknown_used < RADAR_UNKNOWN_SLOTS) {
+        s_unknown[s_unknown_used].opcode = opcode;
+        s_unknown[s_unknown_used].count = 1;
+        s_unknown_used++;
+    } else {
+        s_unknown_overflow++;
+    }
+}
+
+uint32_t radar_reports_unknown_count(uint8_t control, uint8_t command)
+{
+    uint16_t opcode = ((uint16_t)control << 8) | command;
+    for (uint8_t i = 0; i < s_unknown_used; i++) {
+        if (s_unknown[i].opcode == opcode) {
+            return s_unknown[i].count;
+        }
+    }
+    return 0;
+}
+
+uint32_t radar_reports_foreach_unknown(radar_unknown_cb_t cb, void *ctx)
+{
+    for (uint8_t i = 0; i < s_unknown_used; i++) {
+        cb(s_unknown[i].opcode >> 8, s_unknown[i].opcode & 0xFF, s_unknown[i].count, ctx);
+    }
+    return s_unknown_overflow;
+}
+
+// ---------------------- Lookup ----------------------
+
+static const char *const s_report_names[RADAR_RPT_COUNT] = {
+    [RADAR_RPT_NONE] = "none",
+    [RADAR_RPT_PRESENCE] = "presence",
+    [RADAR_RPT_WORKING_STATUS] = "working_status",
+    [RADAR_RPT_WORKING_STATUS_ACK] = "working_status_ack",
+    [RADAR_RPT_MOVEMENT_STATE] = "movement_state",
+    [RADAR_RPT_BODY_MOVEMENT] = "body_movement",
+    [RADAR_RPT_FALL_ALARM] = "fall_alarm",
+    [RADAR_RPT_STAY_STILL_ALARM] = "stay_still_alarm",
+    [RADAR_RPT_HEARTBEAT] = "heartbeat",
+    [RADAR_RPT_TRAJECTORY] = "trajectory",
+    [RADAR_RPT_HEIGHT_PROPORTION] = "height_proportion",
+    [RADAR_RPT_NON_PRESENCE_TIME] = "non_presence_time",
+    [RADAR_RPT_SCENARIO] = "scenario",
+    [RADAR_RPT_INSTALL_ANGLES] = "install_angles",
+    [RADAR_RPT_INSTALL_HEIGHT] = "install_height",
+    [RADAR_RPT_FALL_PARAMS] = "fall_params",
+    [RADAR_RPT_FALL_SENSITIVITY] = "fall_sensitivity",
+    [RADAR_RPT_FALL_DURATION] = "fall_duration",
+    [RADAR_RPT_FALL_BREAKING_HEIGHT] = "fall_breaking_height",
+    [RADAR_RPT_SITTING_STILL_DISTANCE] = "sitting_still_distance",
+    [RADAR_RPT_MOVING_DISTANCE] = "moving_distance",
+    [RADAR_RPT_PRODUCT_MODEL] = "product_model",
+    [RADAR_RPT_PRODUCT_ID] = "product_id",
+    [RADAR_RPT_HARDWARE_MODEL] = "hardware_model",
+    [RADAR_RPT_FIRMWARE_VERSION] = "firmware_version",
+    [RADAR_RPT_OPERATING_TIME] = "operating_time",
+    [RADAR_RPT_STAY_STILL_SWITCH] = "stay_still_switch",
+    [RADAR_RPT_STAY_STILL_DURATION] = "stay_still_duration",
+    [RADAR_RPT_HEIGHT_ACCUMULATION_TIME] = "height_accumulation_time",
+    [RADAR_RPT_HEIGHT_MEASUREMENT] = "height_measurement",
+};
+
+const char *radar_report_name(radar_report_id_t id)
+{
+    if (id >= RADAR_RPT_COUNT || s_report_names[id] == NULL) {
+        return "?";
+    }
+    return s_report_names[id];
+}
+
+bool radar_report_decode(const radar_frame_t *frame, radar_report_t *out)
+{
+    uint8_t slot = s_report_slot[s_control_row[frame->control]][frame->command];
+    const radar_report_desc_t *desc = &s_report_desc[slot];
+
+    out->control = frame->control;
+    out->command = frame->command;
+    out->fallback = false;
+
+    if (slot != SLOT_NONE &&
+        frame->payload_len >= desc->min_len && frame->payload_len <= desc->max_len) {
+        out->id = desc->id;
+        desc->decode(frame->payload, frame->payload_len, out);
+        return true;
+    }
+
+    // Any other 6-byte payload is assumed to be a height proportion report.
+    if (frame->payload_len == 6) {
+        out->id = RADAR_RPT_HEIGHT_PROPORTION;
+        out->fallback = true;
+        decode_height_prop(frame->payload, frame->payload_len, out);
+        return true;
+    }
+
+    out->id = RADAR_RPT_NONE;
+    count_unknown(frame->control, frame->command);
+    return false;
+}
@@ -0,0 +1,296 @@
+// Host test for the command encoders: every radar_encode_* function against a
+// known-good frame, the byte order of every field type, the replies the radar
+// echoes back decoding to the value that was sent, and one opcode per setting.
+// Ends with a timing loop over all commands.
+//
+//   ctest --test-dir build/radar_protocol --output-on-failure
+//   build/radar_protocol/radar_encode_test 5000000     (longer timing run)
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "radar_encode.h"
+#include "radar_reports.h"
+
+static int s_failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static void print_bytes(const char *label, const uint8_t *p, size_t len)
+{
+    printf("  %-9s", label);
+    for (size_t i = 0; i < len; i++) {
+        printf(" %02X", p[i]);
+    }
+    printf("\n");
+}
+
+static void check_frame(const char *name, const uint8_t *got, size_t got_len,
+                        const uint8_t *want, size_t want_len)
+{
+    if (got_len != want_len || memcmp(got, want, want_len) != 0) {
+        CHECK(0, "%s: frame differs", name);
+        print_bytes("expected", want, want_len);
+        print_bytes("got", got, got_len);
+    }
+}
+
+#define EXPECT_FRAME(name, len, buf, ...) do { \
+        static const uint8_t want_[] = { __VA_ARGS__ }; \
+        check_frame((name), (buf), (len), want_, sizeof(want_)); \
+    } while (0)
+
+// Known-good frames. Values are picked so that every multi-byte field has
+// distinct bytes and a swapped byte order cannot go unnoticed.
+static void test_commands(void)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    size_t n;
+
+    n = radar_encode_query(f, sizeof(f), 0x83, 0x0E, 0x0F);
+    EXPECT_FRAME("query", n, f, 0x53, 0x59, 0x83, 0x0E, 0x00, 0x01, 0x0F, 0x4D, 0x54, 0x43);
+
+    n = radar_encode_presence_detection(f, sizeof(f), true);
+    EXPECT_FRAME("presence_detection", n, f, 0x53, 0x59, 0x80, 0x00, 0x00, 0x01, 0x01, 0x2E, 0x54, 0x43);
+
+    n = radar_encode_installation_angles(f, sizeof(f), 1, -2, 300);
+    EXPECT_FRAME("installation_angles", n, f, 0x53, 0x59, 0x06, 0x01, 0x00, 0x06,
+                 0x00, 0x01, 0xFF, 0xFE, 0x01, 0x2C, 0xE4, 0x54, 0x43);
+
+    n = radar_encode_installation_height(f, sizeof(f), 258);
+    EXPECT_FRAME("installation_height", n, f, 0x53, 0x59, 0x06, 0x02, 0x00, 0x02, 0x01, 0x02, 0xB9, 0x54, 0x43);
+
+    n = radar_encode_fall_switch(f, sizeof(f), true);
+    EXPECT_FRAME("fall_switch", n, f, 0x53, 0x59, 0x83, 0x01, 0x00, 0x01, 0x01, 0x32, 0x54, 0x43);
+
+    n = radar_encode_fall_sensitivity(f, sizeof(f), 3);
+    EXPECT_FRAME("fall_sensitivity", n, f, 0x53, 0x59, 0x83, 0x0D, 0x00, 0x01, 0x03, 0x40, 0x54, 0x43);
+
+    n = radar_encode_fall_duration(f, sizeof(f), 70000);
+    EXPECT_FRAME("fall_duration", n, f, 0x53, 0x59, 0x83, 0x0C, 0x00, 0x04,
+                 0x00, 0x01, 0x11, 0x70, 0xC1, 0x54, 0x43);
+
+    n = radar_encode_fall_breaking_height(f, sizeof(f), 0x0123);
+    EXPECT_FRAME("fall_breaking_height", n, f, 0x53, 0x59, 0x83, 0x11, 0x00, 0x02, 0x01, 0x23, 0x66, 0x54, 0x43);
+
+    n = radar_encode_sitting_still_distance(f, sizeof(f), 300);
+    EXPECT_FRAME("sitting_still_distance", n, f, 0x53, 0x59, 0x80, 0x0D, 0x00, 0x02, 0x01, 0x2C, 0x68, 0x54, 0x43);
+
+    n = radar_encode_moving_distance(f, sizeof(f), 30);
+    EXPECT_FRAME("moving_distance", n, f, 0x53, 0x59, 0x80, 0x0E, 0x00, 0x02, 0x00, 0x1E, 0x5A, 0x54, 0x43);
+
+    n = radar_encode_stay_still_switch(f, sizeof(f), false);
+    EXPECT_FRAME("stay_still_switch", n, f, 0x53, 0x59, 0x83, 0x0B, 0x00, 0x01, 0x00, 0x3B, 0x54, 0x43);
+
+    n = radar_encode_stay_still_duration(f, sizeof(f), 123456);
+    EXPECT_FRAME("stay_still_duration", n, f, 0x53, 0x59, 0x83, 0x0A, 0x00, 0x04,
+                 0x00, 0x01, 0xE2, 0x40, 0x60, 0x54, 0x43);
+
+    n = radar_encode_height_accumulation_time(f, sizeof(f), 65599);
+    EXPECT_FRAME("height_accumulation_time", n, f, 0x53, 0x59, 0x83, 0x8F, 0x00, 0x04,
+                 0x00, 0x01, 0x00, 0x3F, 0x02, 0x54, 0x43);
+
+    n = radar_encode_non_presence_time(f, sizeof(f), 1800);
+    EXPECT_FRAME("non_presence_time", n, f, 0x53, 0x59, 0x80, 0x12, 0x00, 0x04,
+                 0x00, 0x00, 0x07, 0x08, 0x51, 0x54, 0x43);
+}
+
+// Every field type, including truncation of oversized values
+static void test_field_byte_order(void)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    size_t n = RADAR_FRAME_ENCODE(f, 0x01, 0x02,
+                                  RADAR_U8(0x1FF),
+                                  RADAR_U16_LE(0x1234), RADAR_U16_BE(0x1234),
+                                  RADAR_U32_LE(0x12345678), RADAR_U32_BE(0x12345678));
+    EXPECT_FRAME("field_byte_order", n, f, 0x53, 0x59, 0x01, 0x02, 0x00, 0x0D,
+                 0xFF, 0x34, 0x12, 0x12, 0x34, 0x78, 0x56, 0x34, 0x12, 0x12, 0x34, 0x56, 0x78,
+                 0x6F, 0x54, 0x43);
+
+    // Signed values go through uint32_t and are truncated to the field
+    n = RADAR_FRAME_ENCODE(f, 0x01, 0x02, RADAR_U16_BE((int16_t)-2), RADAR_U16_LE((int16_t)-2));
+    EXPECT_FRAME("signed_fields", n, f, 0x53, 0x59, 0x01, 0x02, 0x00, 0x04,
+                 0xFF, 0xFE, 0xFE, 0xFF, 0xAD, 0x54, 0x43);
+}
+
+static void test_buffer_too_small(void)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    CHECK(radar_encode_installation_angles(f, 14, 1, 2, 3) == 0, "angles must not fit in 14 bytes");
+    CHECK(radar_encode_installation_angles(f, 15, 1, 2, 3) == 15, "angles must fit in 15 bytes");
+    CHECK(radar_encode_query(f, 0, 0x83, 0x0E, 0x0F) == 0, "nothing fits in 0 bytes");
+}
+
+// Wrap an encoded frame as the radar's reply and decode it
+static bool decode_reply(const uint8_t *raw, size_t len, radar_report_t *out)
+{
+    radar_frame_t frame = {
+        .control = raw[2],
+        .command = raw[3],
+        .payload_len = (uint16_t)(len - RADAR_FRAME_OVERHEAD),
+        .payload = raw + RADAR_FRAME_PREFIX_LEN,
+        .raw = raw,
+        .raw_len = (uint16_t)len,
+    };
+    return radar_report_decode(&frame, out);
+}
+
+// The radar echoes a setting on the opcode it was written with; the decoder
+// must read back the value the encoder wrote
+static void test_replies_round_trip(void)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    radar_report_t r;
+    size_t n;
+
+    n = radar_encode_installation_angles(f, sizeof(f), 1, -2, 300);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_INSTALL_ANGLES &&
+          r.angles.x == 1 && r.angles.y == -2 && r.angles.z == 300,
+          "installation angles read back as %d,%d,%d", r.angles.x, r.angles.y, r.angles.z);
+
+    n = radar_encode_installation_height(f, sizeof(f), 258);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_INSTALL_HEIGHT && r.u16 == 258,
+          "installation height read back as %u", r.u16);
+
+    n = radar_encode_fall_sensitivity(f, sizeof(f), 3);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_FALL_SENSITIVITY && r.u8 == 3,
+          "fall sensitivity read back as %u", r.u8);
+
+    n = radar_encode_fall_duration(f, sizeof(f), 70000);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_FALL_DURATION && r.u32 == 70000,
+          "fall duration read back as %u", (unsigned)r.u32);
+
+    n = radar_encode_fall_breaking_height(f, sizeof(f), 0x0123);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_FALL_BREAKING_HEIGHT && r.u16 == 0x0123,
+          "fall breaking height read back as %u", r.u16);
+
+    n = radar_encode_sitting_still_distance(f, sizeof(f), 300);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_SITTING_STILL_DISTANCE && r.u16 == 300,
+          "sitting still distance read back as %u", r.u16);
+
+    n = radar_encode_moving_distance(f, sizeof(f), 30);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_MOVING_DISTANCE && r.u16 == 30,
+          "moving distance read back as %u", r.u16);
+
+    n = radar_encode_stay_still_switch(f, sizeof(f), true);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_STAY_STILL_SWITCH && r.flag,
+          "stay still switch read back as %d", r.flag);
+
+    n = radar_encode_stay_still_duration(f, sizeof(f), 123456);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_STAY_STILL_DURATION && r.u32 == 123456,
+          "stay still duration read back as %u", (unsigned)r.u32);
+
+    n = radar_encode_height_accumulation_time(f, sizeof(f), 65599);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_HEIGHT_ACCUMULATION_TIME && r.u32 == 65599,
+          "height accumulation time read back as %u", (unsigned)r.u32);
+
+    n = radar_encode_non_presence_time(f, sizeof(f), 1800);
+    CHECK(decode_reply(f, n, &r) && r.id == RADAR_RPT_NON_PRESENCE_TIME && r.u32 == 1800,
+          "non-presence time read back as %u", (unsigned)r.u32);
+}
+
+// Replies are matched to requests by control/command, so no two settings may
+// share an opcode
+static void test_unique_setting_opcodes(void)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    struct { const char *name; uint8_t control, command; } ops[16];
+    size_t count = 0;
+
+#define OPCODE(label, call) do { \
+        size_t n_ = (call); \
+        CHECK(n_ > 0, "%s did not encode", (label)); \
+        ops[count].name = (label); \
+        ops[count].control = f[2]; \
+        ops[count].command = f[3]; \
+        count++; \
+    } while (0)
+
+    OPCODE("presence_detection", radar_encode_presence_detection(f, sizeof(f), true));
+    OPCODE("installation_angles", radar_encode_installation_angles(f, sizeof(f), 0, 0, 0));
+    OPCODE("installation_height", radar_encode_installation_height(f, sizeof(f), 0));
+    OPCODE("fall_switch", radar_encode_fall_switch(f, sizeof(f), true));
+    OPCODE("fall_sensitivity", radar_encode_fall_sensitivity(f, sizeof(f), 0));
+    OPCODE("fall_duration", radar_encode_fall_duration(f, sizeof(f), 0));
+    OPCODE("fall_breaking_height", radar_encode_fall_breaking_height(f, sizeof(f), 0));
+    OPCODE("sitting_still_distance", radar_encode_sitting_still_distance(f, sizeof(f), 0));
+    OPCODE("moving_distance", radar_encode_moving_distance(f, sizeof(f), 0));
+    OPCODE("stay_still_switch", radar_encode_stay_still_switch(f, sizeof(f), true));
+    OPCODE("stay_still_duration", radar_encode_stay_still_duration(f, sizeof(f), 0));
+    OPCODE("height_accumulation_time", radar_encode_height_accumulation_time(f, sizeof(f), 0));
+    OPCODE("non_presence_time", radar_encode_non_presence_time(f, sizeof(f), 0));
+#undef OPCODE
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            CHECK(ops[i].control != ops[j].control || ops[i].command != ops[j].command,
+                  "%s and %s share opcode %02X/%02X", ops[i].name, ops[j].name,
+                  ops[i].control, ops[i].command);
+        }
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Encode every command iterations times and report the cost per frame
+static void bench(unsigned long iterations)
+{
+    uint8_t f[RADAR_FRAME_MAX_LEN];
+    volatile uint32_t sink = 0;     // keeps the loop from being optimised away
+
+    double start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++) {
+        uint32_t v = (uint32_t)i;
+        sink += radar_encode_query(f, sizeof(f), 0x83, 0x0E, 0x0F);
+        sink += radar_encode_presence_detection(f, sizeof(f), v & 1);
+        sink += radar_encode_installation_angles(f, sizeof(f), (int16_t)v, (int16_t)(v >> 1), (int16_t)(v >> 2));
+        sink += radar_encode_installation_height(f, sizeof(f), (uint16_t)v);
+        sink += radar_encode_fall_switch(f, sizeof(f), v & 1);
+        sink += radar_encode_fall_sensitivity(f, sizeof(f), v & 3);
+        sink += radar_encode_fall_duration(f, sizeof(f), v);
+        sink += radar_encode_fall_breaking_height(f, sizeof(f), (uint16_t)v);
+        sink += radar_encode_sitting_still_distance(f, sizeof(f), (uint16_t)v);
+        sink += radar_encode_moving_distance(f, sizeof(f), (uint16_t)v);
+        sink += radar_encode_stay_still_switch(f, sizeof(f), v & 1);
+        sink += radar_encode_stay_still_duration(f, sizeof(f), v);
+        sink += radar_encode_height_accumulation_time(f, sizeof(f), v);
+        sink += radar_encode_non_presence_time(f, sizeof(f), v);
+        sink += f[7];
+    }
+    double elapsed = now_ns() - start;
+    printf("Encoded %lu x 14 frames in %.1f ms: %.1f ns per frame\n",
+           iterations, elapsed / 1e6, elapsed / ((double)iterations * 14));
+}
+
+int main(int argc, char **argv)
+{
+    test_commands();
+    test_field_byte_order();
+    test_buffer_too_small();
+    test_replies_round_trip();
+    test_unique_setting_opcodes();
+
+    if (s_failures > 0) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("All encoder checks passed\n");
+
+    bench(argc > 1 ? strtoul(argv[1], NULL, 10) : 100000);
+    return 0;
+}
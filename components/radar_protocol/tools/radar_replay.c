@@ -0,0 +1,290 @@
+// Replay a recorded R60AFD1 byte stream through the frame decoder and report
+// throughput, decoder error counters and per-opcode statistics.
+//
+// Input is either raw UART bytes or a text log. In a text log every line whose
+// text after the last ':' is a run of hex byte pairs contributes those bytes,
+// so "Raw frame: 53 59 ..." lines from the firmware console replay as-is.
+// Payload-only dumps (the "Unknown Frame Data" lines in DOCS.md) can be wrapped
+// into frames with -w.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+#include <inttypes.h>
+#include "radar_frame.h"
+#include "radar_reports.h"
+
+typedef struct {
+    uint32_t frames;
+    uint32_t decoded;
+    radar_report_id_t id;
+} opcode_stats_t;
+
+typedef struct {
+    bool counting;              // per-opcode stats are only gathered on the first pass
+    opcode_stats_t opcodes[256 * 256];
+} replay_ctx_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} byte_buf_t;
+
+static void buf_append(byte_buf_t *b, const uint8_t *data, size_t len)
+{
+    if (b->len + len > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + len) {
+            cap *= 2;
+        }
+        b->data = realloc(b->data, cap);
+        if (b->data == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-b|-x] [-w CC:DD] [-c chunk] [-n loops] [-q] file...\n"
+            "  -b        input is raw UART bytes\n"
+            "  -x        input is a text log with hex byte lines (default: auto-detect)\n"
+            "  -w CC:DD  wrap each hex line as the payload of a CC/DD frame\n"
+            "  -c N      feed the decoder N bytes at a time (default 64)\n"
+            "  -n N      replay the input N times for timing (default 1)\n"
+            "  -q        skip the per-opcode table\n",
+            prog);
+}
+
+// Text if the first few KB contain no control bytes other than whitespace
+static bool looks_like_text(const uint8_t *data, size_t len)
+{
+    if (len > 4096) {
+        len = 4096;
+    }
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (c < 0x20 && c != '\n' && c != '\r' && c != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Parse "... : 53 59 80 01" into bytes. Returns the count, or 0 if the text
+// after the last ':' is not purely hex pairs (at least two of them).
+static size_t parse_hex_line(const char *line, uint8_t *out, size_t cap)
+{
+    const char *p = strrchr(line, ':');
+    p = p ? p + 1 : line;
+
+    size_t n = 0;
+    while (*p) {
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        int hi = hex_nibble(p[0]);
+        int lo = hi < 0 ? -1 : hex_nibble(p[1]);
+        if (lo < 0 || (p[2] != '\0' && !isspace((unsigned char)p[2])) || n == cap) {
+            return 0;
+        }
+        out[n++] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+    return n >= 2 ? n : 0;
+}
+
+static size_t load_text(const uint8_t *data, size_t len, bool wrap, uint8_t wrap_ctl, uint8_t wrap_cmd,
+                        byte_buf_t *out)
+{
+    size_t lines = 0;
+    const char *p = (const char *)data;
+    const char *end = p + len;
+    char line[1024];
+    uint8_t bytes[512];
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        if (n >= sizeof(line)) {
+            n = sizeof(line) - 1;
+        }
+        memcpy(line, p, n);
+        line[n] = '\0';
+        p = nl ? nl + 1 : end;
+
+        size_t count = parse_hex_line(line, bytes, sizeof(bytes));
+        if (count == 0) {
+            continue;
+        }
+        lines++;
+        if (!wrap) {
+            buf_append(out, bytes, count);
+            continue;
+        }
+        if (count > RADAR_FRAME_MAX_PAYLOAD) {
+            fprintf(stderr, "skipping %zu-byte payload (max %d)\n", count, RADAR_FRAME_MAX_PAYLOAD);
+            continue;
+        }
+        radar_field_t fields[RADAR_FRAME_MAX_PAYLOAD];
+        for (size_t i = 0; i < count; i++) {
+            fields[i] = RADAR_U8(bytes[i]);
+        }
+        uint8_t frame[RADAR_FRAME_MAX_LEN];
+        size_t frame_len = radar_frame_encode(frame, sizeof(frame), wrap_ctl, wrap_cmd, fields, count);
+        buf_append(out, frame, frame_len);
+    }
+    return lines;
+}
+
+static void on_frame(const radar_frame_t *frame, void *arg)
+{
+    replay_ctx_t *ctx = arg;
+    radar_report_t report;
+    bool ok = radar_report_decode(frame, &report);
+    if (!ctx->counting) {
+        return;
+    }
+    opcode_stats_t *s = &ctx->opcodes[((uint16_t)frame->control << 8) | frame->command];
+    s->frames++;
+    if (ok) {
+        s->decoded++;
+        s->id = report.id;
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    int mode = 0;   // 0 = auto, 'b' = binary, 'x' = hex text
+    bool wrap = false, quiet = false;
+    unsigned wrap_ctl = 0, wrap_cmd = 0;
+    size_t chunk = 64;
+    long loops = 1;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        const char *opt = argv[i];
+        if (strcmp(opt, "-b") == 0 || strcmp(opt, "-x") == 0) {
+            mode = opt[1];
+        } else if (strcmp(opt, "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(opt, "-w") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%x:%x", &wrap_ctl, &wrap_cmd) != 2 || wrap_ctl > 0xFF || wrap_cmd > 0xFF) {
+                usage(argv[0]);
+                return 2;
+            }
+            wrap = true;
+        } else if (strcmp(opt, "-c") == 0 && i + 1 < argc) {
+            chunk = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(opt, "-n") == 0 && i + 1 < argc) {
+            loops = strtol(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (i >= argc || chunk == 0 || loops < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    byte_buf_t stream = { 0 };
+    for (; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        byte_buf_t raw = { 0 };
+        uint8_t tmp[4096];
+        size_t n;
+        while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0) {
+            buf_append(&raw, tmp, n);
+        }
+        fclose(f);
+
+        bool text = mode == 'x' || (mode == 0 && looks_like_text(raw.data, raw.len));
+        if (text) {
+            size_t lines = load_text(raw.data, raw.len, wrap, wrap_ctl, wrap_cmd, &stream);
+            printf("%s: %zu hex lines\n", argv[i], lines);
+        } else {
+            buf_append(&stream, raw.data, raw.len);
+            printf("%s: %zu raw bytes\n", argv[i], raw.len);
+        }
+        free(raw.data);
+    }
+    if (stream.len == 0) {
+        fprintf(stderr, "no input bytes\n");
+        return 1;
+    }
+
+    static replay_ctx_t ctx;
+    static radar_decoder_t dec;
+    radar_decoder_init(&dec, on_frame, &ctx);
+
+    double start = now_seconds();
+    for (long loop = 0; loop < loops; loop++) {
+        ctx.counting = (loop == 0);
+        for (size_t off = 0; off < stream.len; off += chunk) {
+            size_t n = stream.len - off < chunk ? stream.len - off : chunk;
+            radar_decoder_feed(&dec, stream.data + off, n);
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    const radar_decoder_stats_t *st = &dec.stats;
+    double total_bytes = (double)stream.len * loops;
+    printf("\n%zu bytes x %ld pass(es), %zu-byte chunks\n", stream.len, loops, chunk);
+    printf("frames:          %" PRIu32 " (%.1f per pass)\n", st->frames, (double)st->frames / loops);
+    printf("time:            %.3f ms\n", elapsed * 1e3);
+    if (elapsed > 0) {
+        printf("throughput:      %.0f frames/s, %.2f MB/s\n", st->frames / elapsed, total_bytes / elapsed / 1e6);
+    }
+    printf("checksum errors: %" PRIu32 "\n", st->checksum_errors);
+    printf("tail errors:     %" PRIu32 "\n", st->tail_errors);
+    printf("length errors:   %" PRIu32 "\n", st->length_errors);
+    printf("resyncs:         %" PRIu32 "\n", st->resyncs);
+    printf("bytes discarded: %" PRIu32 "\n", st->bytes_discarded);
+
+    if (!quiet) {
+        printf("\nopcode   frames  decoded  report\n");
+        for (size_t op = 0; op < 256 * 256; op++) {
+            const opcode_stats_t *s = &ctx.opcodes[op];
+            if (s->frames == 0) {
+                continue;
+            }
+            printf("%02X/%02X  %7" PRIu32 "  %7" PRIu32 "  %s\n", (unsigned)(op >> 8), (unsigned)(op & 0xFF),
+                   s->frames, s->decoded, s->decoded ? radar_report_name(s->id) : "(unknown)");
+        }
+    }
+
+    free(stream.data);
+    return 0;
+}
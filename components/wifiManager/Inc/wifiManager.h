@@ -10,8 +10,37 @@
 #ifndef WIFI_MANAGER_H_
 #define WIFI_MANAGER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
+/*!
+* @brief Station connection timing
+*
+* Filled when the station gets an IP address. A "fast" connection went
+* straight to the access point cached from the previous session (BSSID and
+* channel, no scan); "static_ip" means the cached lease was reused without
+* a DHCP exchange.
+*/
+typedef struct {
+	bool connected;         /*!< At least one connection since boot */
+	bool fast;              /*!< Last connection used the cached BSSID/channel */
+	bool static_ip;         /*!< Last connection reused the cached IP lease */
+	uint32_t boot_ms;       /*!< Boot to first IP address */
+	uint32_t connect_ms;    /*!< Connect request (or link loss) to IP address, last connection */
+	uint16_t reconnects;    /*!< Connections after the first one */
+	uint16_t fallbacks;     /*!< Cached AP attempts that fell back to a full scan */
+} wm_connect_stats_t;
+
+/*!
+* @brief Status endpoint renderer
+*
+* Writes a JSON document into buf and returns its length, or 0 if it does
+* not fit.
+*/
+typedef size_t (*wm_status_fn_t)(char *buf, size_t len);
+
 /*!
 * @brief Wifi Manager Init function
 */
@@ -22,4 +51,24 @@ esp_err_t wifiManager_init();
 */
 esp_err_t wifiManager_deinit();
 
+/*!
+* @brief Wifi Manager connection timing
+*
+* @param stats Filled with a copy of the current statistics
+*/
+void wifiManager_get_connect_stats(wm_connect_stats_t *stats);
+
+/*!
+* @brief Wifi Manager Status Endpoint function
+*
+* Serves the output of render as application/json on GET uri, on the portal
+* while it is open and on a small status server once the station is connected
+* (CONFIG_WM_STATUS_SERVER). Call before wifiManager_init.
+*
+* @param uri Path, e.g. "/metrics"; must stay valid
+* @param render Renderer
+* @return ESP_OK, or ESP_ERR_NO_MEM if all endpoint slots are used
+*/
+esp_err_t wifiManager_add_status_endpoint(const char *uri, wm_status_fn_t render);
+
 #endif /* WIFI_MANAGER_H_ */
@@ -40,6 +40,11 @@
 #define HTTP_SERVER_TASK_STACK_SIZE		CONFIG_HTTP_SERVER_TASK_STACK_SIZE // 8192 is default
 #define HTTP_SERVER_TASK_CORE_ID			CONFIG_HTTP_SERVER_TASK_CORE_ID // 0 is default
 
+//HTTP Status endpoints
+#define WM_STATUS_ENDPOINTS_MAX				4
+#define WM_STATUS_BUF_SIZE						CONFIG_WM_STATUS_BUF_SIZE // 2048 is default
+#define WM_STATUS_SERVER_STACK_SIZE		CONFIG_WM_STATUS_SERVER_STACK_SIZE // 4096 is default
+
 #ifdef CONFIG_USE_BUTTON_INT 
 #define USE_BUTTON_INT
 
@@ -108,6 +113,7 @@ typedef enum
 	WM_EVENTG_NVS_DONE = 1 << 4, /*!< Flag for NVS Task Finished */
 	WM_EVENTG_NVS_CLEAR_CREDS = 1 << 5, /*!< Flag for NVS Clear Creds */
 	WM_EVENTG_NVS_FAIL = 1 << 6, /*!< Flag for NVS Task Fail */
+	WM_EVENTG_NVS_WRITE_LINK = 1 << 7, /*!< Flag for NVS Write Cached Link (BSSID, channel, lease) */
 } wm_nvs_event_group_e; /*!< Wifi Manager NVS Event Group Enum */
 
 /*!
@@ -11,6 +11,7 @@
 #define WM_HTTPSERVER_H_
 
 #include "esp_http_server.h"
+#include "wifiManager.h"
 
 /*!
 * @brief HTTP Wifi Request Handler Semaphore
@@ -38,4 +39,18 @@ BaseType_t http_server_init(void);
 */
 BaseType_t http_server_stop(void);
 
+/*!
+* @brief HTTP Status Endpoint Add Function
+*
+* This function adds a JSON status endpoint, served by the portal and the status server.
+*/
+esp_err_t http_server_add_status_endpoint(const char *uri, wm_status_fn_t render);
+
+/*!
+* @brief HTTP Status Server Start Function
+*
+* This function starts the status server (status endpoints only) once the portal is closed.
+*/
+void http_server_status_start(void);
+
 #endif /* WM_HTTPSERVER_H_ */
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "esp_netif.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
+#include "wifiManager.h"
 
 #define REF_COUNT_FIELD int ref_count;
 
@@ -35,6 +36,14 @@
 #define MAX_CONNECTION_RETRIES	CONFIG_MAX_CONNECTION_RETRIES	// 5 is default
 
 #define MAX_SCAN_LIST_SIZE	CONFIG_MAX_SCAN_LIST_SIZE	// 10 is default
+#ifdef CONFIG_WM_FAST_CONNECT
+#define WM_FAST_CONNECT_RETRIES	CONFIG_WM_FAST_CONNECT_RETRIES	// 1 is default
+#else
+#define WM_FAST_CONNECT_RETRIES	0
+#endif
+#ifdef CONFIG_WM_FAST_CONNECT_STATIC_IP
+#define WM_FAST_CONNECT_LEASE_REUSE	CONFIG_WM_FAST_CONNECT_LEASE_REUSE	// 8 is default
+#endif
 #define WIFI_SCAN_SSID		CONFIG_WIFI_SCAN_SSID		// 0 is default, otherwise specify the SSID
 #define WIFI_SCAN_BSSID		CONFIG_WIFI_SCAN_BSSID		// 0 is default, otherwise specify the BSSID
 #define WIFI_SCAN_CHANNEL	CONFIG_WIFI_SCAN_CHANNEL		// 0 is default, 1-13 is valid
@@ -63,6 +72,20 @@ typedef struct {
 	wifi_config_t wifi_config;
 }wm_queue_wifi_config_t;
 
+/*!
+* @brief Cached link of the last successful station connection
+*
+* Stored in NVS next to the credentials and used on the next connect to skip
+* the scan (BSSID and channel) and, if enabled, the DHCP exchange (lease).
+*/
+typedef struct {
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t lease_uses; /*!< Connections that reused this lease without DHCP */
+	esp_netif_ip_info_t ip_info;
+	esp_ip4_addr_t dns;
+}wm_link_cache_t;
+
 /*!
 * @brief Wifi Manager Wifi Config Queue Handler
 *
@@ -99,6 +122,24 @@ void wm_wifi_connect_task(void *pvParameters);
 */
 void wm_wifi_scan_task(void *pvParameters);
 
+/*!
+ * @brief Set the cached link to try on the next station connect
+ * 
+ */
+void wm_wifi_set_link_cache(const wm_link_cache_t *link);
+
+/*!
+ * @brief Get the link of the current connection, for storing in NVS
+ * 
+ */
+BaseType_t wm_wifi_get_link_cache(wm_link_cache_t *link);
+
+/*!
+ * @brief Get the station connection timing
+ * 
+ */
+void wm_wifi_get_connect_stats(wm_connect_stats_t *stats);
+
 /*!
  * @brief Send Message to Wifi Config Queue
  * 
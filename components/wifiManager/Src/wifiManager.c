@@ -201,6 +201,7 @@ static void wm_init_task(void *pvParameters)
 			xEventGroupWaitBits(wm_main_event_group, WM_EVENTG_MAIN_HTTP_CLOSED, pdFALSE, pdFALSE, portMAX_DELAY);
 			wm_scan_task_stop();
 			xEventGroupWaitBits(wm_main_event_group, WM_EVENTG_MAIN_SCAN_TASK_CLOSED, pdFALSE, pdFALSE, portMAX_DELAY);
+			http_server_status_start();
 			xEventGroupSetBits(wm_task_event_group, WM_EVENTG_TASK_DEINIT_DONE);
 			xEventGroupClearBits(wm_task_event_group, WM_EVENTG_TASK_DEINIT);
 			ESP_LOGI(TAG, "Deinit Completed");
@@ -285,3 +286,23 @@ static void wm_scan_task_stop(void)
 	xEventGroupSetBits(wm_main_event_group, WM_EVENTG_MAIN_SCAN_TASK_CLOSED);
 }
 
+
+/*!
+* @brief Wifi Manager Connection Timing Function
+*
+* This function copies the station connection timing.
+*/
+void wifiManager_get_connect_stats(wm_connect_stats_t *stats)
+{
+	wm_wifi_get_connect_stats(stats);
+}
+
+/*!
+* @brief Wifi Manager Status Endpoint Function
+*
+* This function adds a JSON status endpoint to the HTTP servers.
+*/
+esp_err_t wifiManager_add_status_endpoint(const char *uri, wm_status_fn_t render)
+{
+	return http_server_add_status_endpoint(uri, render);
+}
@@ -29,6 +29,19 @@ SemaphoreHandle_t wm_http_wifi_request_semaphore;
 */
 httpd_handle_t wm_http_server_task_handle;
 
+/*!
+* @brief HTTP Status Server Handler
+* @note Runs the status endpoints after the portal is closed
+*/
+static httpd_handle_t wm_http_status_server_handle;
+
+/*!
+* @brief HTTP Status Endpoints
+*
+*/
+static httpd_uri_t wm_http_status_endpoints[WM_STATUS_ENDPOINTS_MAX];
+static uint8_t wm_http_status_endpoint_count = 0;
+
 ///> Declare the 503 response function
 static void httpd_resp_send_503(httpd_req_t *req);
 
@@ -319,6 +332,47 @@ static esp_err_t http_server_wifi_scan_result_list_json_handler(httpd_req_t *req
 }
 
 
+/*!
+* @brief HTTP Server Status JSON Handler
+* @note Responses with the JSON rendered by the endpoint's wm_status_fn_t
+*	@param req HTTP request
+* @return ESP_OK
+*/
+static esp_err_t http_server_status_json_handler(httpd_req_t *req)
+{
+	wm_status_fn_t render = (wm_status_fn_t)req->user_ctx;
+	char *statusJSON = malloc(WM_STATUS_BUF_SIZE);
+	if(statusJSON == NULL)
+	{
+		httpd_resp_send_503(req);
+		return ESP_OK;
+	}
+	size_t len = render(statusJSON, WM_STATUS_BUF_SIZE);
+	if(len == 0)
+	{
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Status does not fit the buffer");
+	}else
+	{
+		httpd_resp_set_type(req, "application/json");
+		httpd_resp_send(req, statusJSON, len);
+	}
+	free(statusJSON);
+	return ESP_OK;
+}
+
+/*!
+* @brief HTTP Server Status Endpoints Register
+* @note Registers the status endpoints on the given server
+*
+*/
+static void http_server_register_status_endpoints(httpd_handle_t server)
+{
+	for(uint8_t i = 0; i < wm_http_status_endpoint_count; i++)
+	{
+		httpd_register_uri_handler(server, &wm_http_status_endpoints[i]);
+	}
+}
+
 /*!
  * @brief HTTP Server Configuration
  * @note Sets up the default HTTP Server configuration
@@ -446,6 +500,8 @@ static httpd_handle_t http_server_configure(void)
 		httpd_register_uri_handler(wm_http_server_task_handle, &wifi_connect_status_json);
 		///> Register the URI handlers for Wifi Scan
 		httpd_register_uri_handler(wm_http_server_task_handle, &wifi_scan_result_list_json);
+		///> Register the URI handlers for the status endpoints
+		http_server_register_status_endpoints(wm_http_server_task_handle);
 
 		return wm_http_server_task_handle;
 	}
@@ -474,6 +530,12 @@ static void httpd_resp_send_503(httpd_req_t *req)
  */
 BaseType_t http_server_init(void)	
 {
+	if(wm_http_status_server_handle != NULL)
+	{
+		///> The portal takes over the port and serves the status endpoints too
+		httpd_stop(wm_http_status_server_handle);
+		wm_http_status_server_handle = NULL;
+	}
 	if(wm_http_server_task_handle == NULL)
 	{
 		wm_http_server_task_handle = http_server_configure();
@@ -525,4 +587,58 @@ BaseType_t http_server_stop(void)
 		return pdTRUE;
 	}
 	return pdFALSE;
-}
\ No newline at end of file
+}
+/*!
+* @brief Adds a Status Endpoint
+* @note Must be called before the servers start
+*
+* @return ESP_OK if added, ESP_ERR_NO_MEM if all slots are used
+*/
+esp_err_t http_server_add_status_endpoint(const char *uri, wm_status_fn_t render)
+{
+	if(wm_http_status_endpoint_count >= WM_STATUS_ENDPOINTS_MAX)
+	{
+		ESP_LOGE(TAG, "No free status endpoint for %s", uri);
+		return ESP_ERR_NO_MEM;
+	}
+	wm_http_status_endpoints[wm_http_status_endpoint_count++] = (httpd_uri_t){
+		.uri = uri,
+		.method = HTTP_GET,
+		.handler = http_server_status_json_handler,
+		.user_ctx = (void *)render
+	};
+	return ESP_OK;
+}
+
+/*!
+* @brief Starts the Status Server
+* @note Serves only the status endpoints while the station is connected and the portal is closed
+*
+*/
+void http_server_status_start(void)
+{
+#ifdef CONFIG_WM_STATUS_SERVER
+	if(wm_http_status_endpoint_count == 0 || wm_http_status_server_handle != NULL || wm_http_server_task_handle != NULL)
+	{
+		return;
+	}
+
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	config.core_id = HTTP_SERVER_TASK_CORE_ID;
+	config.task_priority = HTTP_SERVER_TASK_PRIORITY;
+	config.stack_size = WM_STATUS_SERVER_STACK_SIZE;
+	config.max_uri_handlers = WM_STATUS_ENDPOINTS_MAX;
+	config.max_open_sockets = 2;
+	config.lru_purge_enable = true;
+
+	if(httpd_start(&wm_http_status_server_handle, &config) == ESP_OK)
+	{
+		http_server_register_status_endpoints(wm_http_status_server_handle);
+		ESP_LOGI(TAG, "Status Server started on port: '%d'", config.server_port);
+	}else
+	{
+		wm_http_status_server_handle = NULL;
+		ESP_LOGE(TAG, "Failed to start Status Server");
+	}
+#endif
+}
@@ -11,6 +11,7 @@
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "nvs_flash.h"
 
 #include "wifiManager_private.h"
@@ -26,6 +27,30 @@ const char wm_nvs_namespace[] = "wifi_manager";
 */
 TaskHandle_t wm_nvs_task_handle;
 
+/*!
+* @brief NVS Read Link Function
+*
+* This function reads the cached link (BSSID, channel, IP lease) of the last
+* connection and hands it to the wifi task. A missing or old-format entry
+* just means the next connect scans as usual.
+*
+* @param nvs_handle Open handle of the wifi manager namespace
+*/
+static void wm_nvs_read_link(nvs_handle_t nvs_handle)
+{
+	wm_link_cache_t link;
+	size_t link_len = sizeof(link);
+
+	if(nvs_get_blob(nvs_handle, "link", &link, &link_len) == ESP_OK && link_len == sizeof(link) 
+			&& link.channel >= 1 && link.channel <= 14)
+	{
+		ESP_LOGI(TAG, "Cached AP: " MACSTR " channel %d", MAC2STR(link.bssid), link.channel);
+		wm_wifi_set_link_cache(&link);
+	}else {
+		ESP_LOGI(TAG, "No Cached AP");
+	}
+}
+
 /*!
 * @brief NVS Read Function
 *
@@ -67,6 +92,7 @@ static esp_err_t wm_nvs_read ()
 			return ESP_OK;
 		}
 
+		wm_nvs_read_link(nvs_handle);
 		nvs_close(nvs_handle);
 		wm_wifi_send_message(wifi_config);
 	
@@ -115,6 +141,48 @@ static void wm_nvs_write()
 	}
 }
 
+/*!
+* @brief NVS Write Link Function
+*
+* This function stores the link of the current connection. The entry is only
+* rewritten when it changed, so a reconnect to the same AP costs no flash write.
+*
+*/
+static void wm_nvs_write_link()
+{
+	wm_link_cache_t link;
+	wm_link_cache_t stored;
+	size_t stored_len = sizeof(stored);
+
+	if(wm_wifi_get_link_cache(&link) != pdPASS)
+	{
+		return;
+	}
+
+	nvs_handle_t nvs_handle;
+
+	if(nvs_open(wm_nvs_namespace, NVS_READWRITE, &nvs_handle) == ESP_OK)
+	{
+		if(nvs_get_blob(nvs_handle, "link", &stored, &stored_len) == ESP_OK && stored_len == sizeof(stored) 
+				&& memcmp(&stored, &link, sizeof(link)) == 0)
+		{
+			nvs_close(nvs_handle);
+			return;
+		}
+
+		if(nvs_set_blob(nvs_handle, "link", &link, sizeof(link)) == ESP_OK && nvs_commit(nvs_handle) == ESP_OK)
+		{
+			ESP_LOGI(TAG, "Cached AP: " MACSTR " channel %d", MAC2STR(link.bssid), link.channel);
+		}else {
+			ESP_LOGE(TAG, "Link Write Failed");
+		}
+
+		nvs_close(nvs_handle);
+	}else {
+		ESP_LOGE(TAG, "NVS Open Failed");
+	}
+}
+
 /*!
 * @brief NVS Clear Function
 *
@@ -141,6 +209,9 @@ static void wm_nvs_clear()
 			ESP_LOGE(TAG, "Password Clear Failed");
 		}
 
+		// The cached AP belongs to the cleared network
+		nvs_erase_key(nvs_handle, "link");
+
 		nvs_close(nvs_handle);
 		xEventGroupClearBits(wm_http_event_group, WM_EVENTG_HTTP_BLOCK_REQ);
 		xEventGroupSetBits(wm_nvs_event_group, WM_EVENTG_NVS_DONE);
@@ -153,8 +224,8 @@ void wm_nvs_task(void *pvParameters)
 {
 	while (1)
 	{
-		EventBits_t uxBits = xEventGroupWaitBits(wm_nvs_event_group, WM_EVENTG_NVS_READ_CREDS | WM_EVENTG_NVS_WRITE_CREDS | WM_EVENTG_NVS_CLEAR_CREDS, \
-																			pdTRUE, pdFALSE, portMAX_DELAY);
+		EventBits_t uxBits = xEventGroupWaitBits(wm_nvs_event_group, WM_EVENTG_NVS_READ_CREDS | WM_EVENTG_NVS_WRITE_CREDS | WM_EVENTG_NVS_CLEAR_CREDS \
+																			| WM_EVENTG_NVS_WRITE_LINK, pdTRUE, pdFALSE, portMAX_DELAY);
 		if ((uxBits & WM_EVENTG_NVS_WRITE_CREDS) != 0)
 		{
 			xEventGroupSetBits(wm_http_event_group, WM_EVENTG_HTTP_BLOCK_REQ);
@@ -184,6 +255,12 @@ void wm_nvs_task(void *pvParameters)
 			ESP_LOGI(TAG, "NVS Clear Event Triggered");
 			wm_nvs_clear();
 		}
+
+		// Independent of the credential events above, which may arrive together with it
+		if ((uxBits & WM_EVENTG_NVS_WRITE_LINK) != 0)
+		{
+			wm_nvs_write_link();
+		}
 	}
 }
 
@@ -9,16 +9,16 @@
 */
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_netif.h"
 #include "esp_wifi_netif.h"
 #include "lwip/netdb.h"
-#ifdef CONFIG_USE_DYNAMIC_AP_NAME
 #include "esp_mac.h"
-#endif
 
 #include "wifiManager_private.h"
 #include "wm_generalMacros.h"
 #include "wm_wifi.h"
+#include "wm_httpServer.h"
 
 static const char *TAG = "WM_WIFI";
 
@@ -27,6 +27,26 @@ esp_netif_t *esp_sta_netif;
 /// @brief Wifi Access Point Netif
 esp_netif_t *esp_ap_netif;
 
+/// @brief Link of the last connection, from NVS at boot and refreshed on every connection
+static wm_link_cache_t wm_link;
+/// @brief wm_link holds a usable BSSID/channel
+static bool wm_link_valid = false;
+/// @brief Station config is pinned to the cached BSSID/channel
+static bool wm_link_pinned = false;
+/// @brief Attempts on the pinned AP since the last connection
+static uint8_t wm_link_pinned_retry = 0;
+/// @brief Cached lease is applied instead of DHCP
+static bool wm_link_static_ip = false;
+/// @brief Station has an IP since the last disconnect
+static bool wm_link_up = false;
+/// @brief Guards wm_link between the event loop and the NVS task
+static portMUX_TYPE wm_link_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/// @brief Connection timing, see wifiManager_get_connect_stats
+static wm_connect_stats_t wm_connect_stats;
+/// @brief Start of the current connect attempt or outage, 0 while connected
+static int64_t wm_connect_start_us = 0;
+
 /*!
 * @brief Wifi Manager Wifi Config Queue Handler
 *
@@ -67,6 +87,14 @@ static BaseType_t wm_wifi_ap_close(void);
 static void wm_wifi_scan(wifi_app_wifi_scan_t *wifi_scan_list);
 /// @brief Wifi Connect from HTTP function declaration
 static esp_err_t wm_wifi_connect_from_http(wifi_config_t *wifi_config);
+/// @brief Wifi Cached Link Fallback function declaration
+static void wm_wifi_link_fallback(void);
+/// @brief Wifi Cached Link Release function declaration
+static void wm_wifi_link_release(void);
+/// @brief Wifi Cached Lease Apply function declaration
+static void wm_wifi_link_apply_lease(void);
+/// @brief Wifi Connected Bookkeeping function declaration
+static void wm_wifi_link_got_ip(const ip_event_got_ip_t *event);
 
 /*!
 * @brief Struct initialization, deinitialization, retain and release functions
@@ -99,9 +127,42 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
 				break;
 			case WIFI_EVENT_STA_CONNECTED:
 				ESP_LOGI(TAG, "WIFI_EVENT_STA_CONNECTED");
+				{
+					wifi_event_sta_connected_t *connected = (wifi_event_sta_connected_t *)event_data;
+					taskENTER_CRITICAL(&wm_link_lock);
+					memcpy(wm_link.bssid, connected->bssid, sizeof(wm_link.bssid));
+					wm_link.channel = connected->channel;
+					taskEXIT_CRITICAL(&wm_link_lock);
+				}
+				if(wm_link_static_ip)
+				{
+					wm_wifi_link_apply_lease();
+				}
 				break;
 			case WIFI_EVENT_STA_DISCONNECTED:
 				ESP_LOGI(TAG, "WIFI_EVENT_STA_DISCONNECTED");
+				if(wm_connect_start_us == 0)
+				{
+					wm_connect_start_us = esp_timer_get_time();
+				}
+				if(wm_link_up)
+				{
+					// Link lost at runtime: the cached AP and lease only serve the boot-time connect
+					wm_link_up = false;
+					wm_wifi_link_release();
+				}
+				if(wm_link_pinned)
+				{
+					// The cached AP may have moved channel or gone away: give it a retry, then scan for the SSID
+					if(wm_link_pinned_retry++ < WM_FAST_CONNECT_RETRIES)
+					{
+						ESP_LOGI(TAG, "Retrying Cached AP");
+						esp_wifi_connect();
+					}else {
+						wm_wifi_link_fallback();
+					}
+					break;
+				}
 
 				wifi_event_sta_disconnected_t *wifi_event_sta_disconnected = (wifi_event_sta_disconnected_t *)malloc(sizeof(wifi_event_sta_disconnected_t));
 				*wifi_event_sta_disconnected = *((wifi_event_sta_disconnected_t *)event_data);
@@ -202,6 +263,7 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
 			case IP_EVENT_STA_GOT_IP:
 				ESP_LOGI(TAG, "IP_EVENT_STA_GOT_IP");
 				wifi_connect_retry = 0;
+				wm_wifi_link_got_ip((ip_event_got_ip_t *)event_data);
 				xEventGroupSetBits(wm_wifi_event_group, WM_EVENTG_WIFI_CONNECTED);
 				break;
 			default:
@@ -282,7 +344,10 @@ void wm_wifi_connect_task(void *pvParameters)
 					xEventGroupSetBits(wm_main_event_group, WM_EVENTG_MAIN_AP_CLOSED);
 					xEventGroupSetBits(wm_task_event_group, WM_EVENTG_TASK_DEINIT);
 				}
-			}	
+			}else {
+				///> Connected with stored credentials, the portal never opened
+				http_server_status_start();
+			}
 		}
 		else if ((uxBits & WM_EVENTG_WIFI_CONNECT_FAIL) == WM_EVENTG_WIFI_CONNECT_FAIL)
 		{
@@ -364,6 +429,7 @@ static void wm_wifi_default_wifi_init(void)
 static esp_err_t wm_wifi_connect_from_http(wifi_config_t *wifi_config_params)
 {
 	ESP_LOGI(TAG, "Connecting to Wifi from HTTP %s", wifi_config_params->sta.password);
+	wm_connect_start_us = esp_timer_get_time();
 	if(strcmp((char *)wifi_config_params->sta.password, "\0") == 0)
 	{
 		ESP_LOGI(TAG, "Connecting to Open Network");
@@ -424,6 +490,30 @@ static esp_err_t wm_wifi_connect_sta(wifi_config_t *wifi_config_params)
 
     ESP_LOGI(TAG, "Connecting to SSID:%s with password:%s", wifi_config_params->sta.ssid, wifi_config_params->sta.password);
 
+		wm_connect_start_us = esp_timer_get_time();
+#ifdef CONFIG_WM_FAST_CONNECT
+		if(wm_link_valid)
+		{
+			// Join the AP of the last session directly instead of scanning every channel for the SSID
+			wifi_config.sta.bssid_set = true;
+			memcpy(wifi_config.sta.bssid, wm_link.bssid, sizeof(wifi_config.sta.bssid));
+			wifi_config.sta.channel = wm_link.channel;
+			wm_link_pinned = true;
+			wm_link_pinned_retry = 0;
+			ESP_LOGI(TAG, "Connecting to Cached AP " MACSTR " on channel %d", MAC2STR(wm_link.bssid), wm_link.channel);
+
+#ifdef CONFIG_WM_FAST_CONNECT_STATIC_IP
+			// Reuse the lease for a bounded number of boots, then let DHCP confirm it again
+			if(wm_link.ip_info.ip.addr != 0 && wm_link.lease_uses < WM_FAST_CONNECT_LEASE_REUSE)
+			{
+				wm_link_static_ip = true;
+				ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_stop(esp_sta_netif));
+				ESP_LOGI(TAG, "Reusing Lease " IPSTR " (%d/%d)", IP2STR(&wm_link.ip_info.ip), wm_link.lease_uses + 1, WM_FAST_CONNECT_LEASE_REUSE);
+			}
+#endif
+		}
+#endif
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -432,6 +522,166 @@ static esp_err_t wm_wifi_connect_sta(wifi_config_t *wifi_config_params)
 		return ESP_OK;
 }
 
+/*!
+* @brief Wifi Cached Lease Apply function
+* @note This function sets the cached IP lease on the station interface, which
+*				raises IP_EVENT_STA_GOT_IP without a DHCP exchange.
+*
+*/
+static void wm_wifi_link_apply_lease(void)
+{
+	esp_err_t ret = esp_netif_set_ip_info(esp_sta_netif, &wm_link.ip_info);
+	if(ret != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Cached Lease Rejected: %s, using DHCP", esp_err_to_name(ret));
+		wm_link_static_ip = false;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_start(esp_sta_netif));
+		return;
+	}
+	if(wm_link.dns.addr != 0)
+	{
+		esp_netif_dns_info_t dns = { 0 };
+		dns.ip.type = ESP_IPADDR_TYPE_V4;
+		dns.ip.u_addr.ip4 = wm_link.dns;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_dns_info(esp_sta_netif, ESP_NETIF_DNS_MAIN, &dns));
+	}
+}
+
+/*!
+* @brief Wifi Cached Link Release function
+* @note This function unpins the cached BSSID/channel and hands the address
+*				back to DHCP, so the next connection scans for the SSID and
+*				requests a fresh lease.
+*
+*/
+static void wm_wifi_link_release(void)
+{
+	if(wm_link_pinned)
+	{
+		wifi_config_t wifi_config;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+		wifi_config.sta.bssid_set = false;
+		wifi_config.sta.channel = 0;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+		wm_link_pinned = false;
+	}
+
+	if(wm_link_static_ip)
+	{
+		esp_netif_ip_info_t no_ip = { 0 };
+		wm_link_static_ip = false;
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_ip_info(esp_sta_netif, &no_ip));
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_start(esp_sta_netif));
+	}
+}
+
+/*!
+* @brief Wifi Cached Link Fallback function
+* @note This function drops the cached BSSID/channel and lease and reconnects
+*				the standard way: full scan for the SSID and DHCP.
+*
+*/
+static void wm_wifi_link_fallback(void)
+{
+	ESP_LOGW(TAG, "Cached AP Failed, Falling Back to Full Scan");
+	wm_wifi_link_release();
+	wm_link_valid = false;
+	wm_connect_stats.fallbacks++;
+	esp_wifi_connect();
+}
+
+/*!
+* @brief Wifi Connected Bookkeeping function
+* @note This function records the connection timing and refreshes the cached
+*				link, which the NVS task stores for the next boot.
+*
+* @param event IP_EVENT_STA_GOT_IP data
+*/
+static void wm_wifi_link_got_ip(const ip_event_got_ip_t *event)
+{
+	int64_t now = esp_timer_get_time();
+
+	wm_connect_stats.fast = wm_link_pinned;
+	wm_connect_stats.static_ip = wm_link_static_ip;
+	wm_connect_stats.connect_ms = wm_connect_start_us ? (uint32_t)((now - wm_connect_start_us) / 1000) : 0;
+	if(wm_connect_stats.connected)
+	{
+		wm_connect_stats.reconnects++;
+	}else {
+		wm_connect_stats.connected = true;
+		wm_connect_stats.boot_ms = (uint32_t)(now / 1000);
+	}
+	wm_connect_start_us = 0;
+	wm_link_pinned_retry = 0;
+	ESP_LOGI(TAG, "Connected in %lu ms (%s, %s), %lu ms since boot", (unsigned long)wm_connect_stats.connect_ms, 
+					wm_connect_stats.fast ? "cached AP" : "scan", wm_connect_stats.static_ip ? "cached lease" : "DHCP", 
+					(unsigned long)(now / 1000));
+
+	esp_netif_dns_info_t dns = { 0 };
+	if(!wm_link_static_ip)
+	{
+		ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_get_dns_info(esp_sta_netif, ESP_NETIF_DNS_MAIN, &dns));
+	}
+
+	taskENTER_CRITICAL(&wm_link_lock);
+	if(wm_link_static_ip)
+	{
+		wm_link.lease_uses++;
+	}else {
+		wm_link.ip_info = event->ip_info;
+		wm_link.dns.addr = (dns.ip.type == ESP_IPADDR_TYPE_V4) ? dns.ip.u_addr.ip4.addr : 0;
+		wm_link.lease_uses = 0;
+	}
+	taskEXIT_CRITICAL(&wm_link_lock);
+	wm_link_valid = true;
+	wm_link_up = true;
+
+	xEventGroupSetBits(wm_nvs_event_group, WM_EVENTG_NVS_WRITE_LINK);
+}
+
+/*!
+* @brief Set Cached Link function
+* @note Called by the NVS task with the link stored by the previous session,
+*				before the connect request is queued.
+*
+* @param link Cached link
+*/
+void wm_wifi_set_link_cache(const wm_link_cache_t *link)
+{
+	taskENTER_CRITICAL(&wm_link_lock);
+	wm_link = *link;
+	taskEXIT_CRITICAL(&wm_link_lock);
+	wm_link_valid = true;
+}
+
+/*!
+* @brief Get Cached Link function
+*
+* @param link Filled with the link of the current connection
+* @return BaseType_t Returns pdPASS if there is a link to store otherwise pdFAIL
+*/
+BaseType_t wm_wifi_get_link_cache(wm_link_cache_t *link)
+{
+	if(!wm_link_valid)
+	{
+		return pdFAIL;
+	}
+	taskENTER_CRITICAL(&wm_link_lock);
+	*link = wm_link;
+	taskEXIT_CRITICAL(&wm_link_lock);
+	return pdPASS;
+}
+
+/*!
+* @brief Get Connection Timing function
+*
+* @param stats Filled with a copy of the connection timing
+*/
+void wm_wifi_get_connect_stats(wm_connect_stats_t *stats)
+{
+	*stats = wm_connect_stats;
+}
+
 /*!
 * @brief Wifi APSTA Init function
 * 
@@ -0,0 +1,260 @@
+#include <string.h>
+#include "delta_patch.h"
+
+enum {
+    ST_HEADER,
+    ST_OPCODE,
+    ST_ADD_SEEK,
+    ST_ADD_LEN,
+    ST_ADD_RUN,
+    ST_ADD_COUNT,
+    ST_ADD_BYTES,
+    ST_INSERT_LEN,
+    ST_INSERT_BYTES,
+    ST_DONE,
+    ST_ERROR,
+};
+
+static int fail(delta_patch_t *p, const char *why)
+{
+    p->error = why;
+    p->state = ST_ERROR;
+    return -1;
+}
+
+static uint32_t get_u32(const uint8_t *b)
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+void delta_patch_init(delta_patch_t *patch, delta_read_fn_t read_source, delta_write_fn_t write_target,
+                      delta_header_fn_t on_header, void *ctx)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->read_source = read_source;
+    patch->write_target = write_target;
+    patch->on_header = on_header;
+    patch->ctx = ctx;
+    patch->state = ST_HEADER;
+}
+
+bool delta_patch_done(const delta_patch_t *patch)
+{
+    return patch->state == ST_DONE;
+}
+
+static int flush(delta_patch_t *p)
+{
+    if (p->out_len == 0) {
+        return 0;
+    }
+    if (p->write_target(p->out, p->out_len, p->ctx) != 0) {
+        return fail(p, "target write failed");
+    }
+    p->out_len = 0;
+    return 0;
+}
+
+static int emit(delta_patch_t *p, uint8_t b)
+{
+    p->out[p->out_len++] = b;
+    p->written++;
+    return p->out_len == DELTA_OUT_BUF ? flush(p) : 0;
+}
+
+// Source byte at the current position, through a small read cache
+static int source_byte(delta_patch_t *p)
+{
+    uint32_t off = p->src_pos++;
+    if (off < p->cache_base || off >= p->cache_base + p->cache_len) {
+        uint32_t n = p->source_size - off;
+        p->cache_base = off;
+        p->cache_len = n < DELTA_SRC_CACHE ? n : DELTA_SRC_CACHE;
+        if (p->read_source(off, p->cache, p->cache_len, p->ctx) != 0) {
+            p->cache_len = 0;
+            return fail(p, "source read failed");
+        }
+    }
+    return p->cache[off - p->cache_base];
+}
+
+// Accumulate one LEB128 byte; returns 1 with *value set when it is complete
+static int varint_step(delta_patch_t *p, uint8_t b, uint32_t *value)
+{
+    if (p->varint_shift > 28 || (p->varint_shift == 28 && (b & 0x70))) {
+        return fail(p, "varint overflow");
+    }
+    p->varint |= (uint32_t)(b & 0x7F) << p->varint_shift;
+    p->varint_shift += 7;
+    if (b & 0x80) {
+        return 0;
+    }
+    *value = p->varint;
+    p->varint = 0;
+    p->varint_shift = 0;
+    return 1;
+}
+
+static int parse_header(delta_patch_t *p)
+{
+    if (memcmp(p->hdr, "R6DP", 4) != 0) {
+        return fail(p, "not a delta patch");
+    }
+    if (p->hdr[4] != DELTA_PATCH_VERSION) {
+        return fail(p, "unsupported patch version");
+    }
+    p->source_size = get_u32(p->hdr + 8);
+    p->target_size = get_u32(p->hdr + 12);
+    memcpy(p->source_sha256, p->hdr + 16, 32);
+    memcpy(p->target_sha256, p->hdr + 48, 32);
+    if (p->on_header && p->on_header(p, p->ctx) != 0) {
+        return fail(p, "patch refused");
+    }
+    p->state = ST_OPCODE;
+    return 0;
+}
+
+// Operation length is known: check it fits the target (and the source for ADD)
+static int start_op(delta_patch_t *p, uint32_t len)
+{
+    if (len > p->target_size - p->written) {
+        return fail(p, "target overrun");
+    }
+    if (p->op == DELTA_OP_ADD && len > p->source_size - p->src_pos) {
+        return fail(p, "source overrun");
+    }
+    p->remaining = len;
+    if (len == 0) {
+        p->state = ST_OPCODE;
+    } else {
+        p->state = (p->op == DELTA_OP_ADD) ? ST_ADD_RUN : ST_INSERT_BYTES;
+    }
+    return 0;
+}
+
+// A zero run copies source bytes unchanged without consuming patch input
+static int copy_run(delta_patch_t *p, uint32_t run)
+{
+    if (run > p->remaining) {
+        return fail(p, "run past end of operation");
+    }
+    for (uint32_t i = 0; i < run; i++) {
+        int s = source_byte(p);
+        if (s < 0 || emit(p, (uint8_t)s) != 0) {
+            return -1;
+        }
+    }
+    p->remaining -= run;
+    p->state = p->remaining ? ST_ADD_COUNT : ST_OPCODE;
+    return 0;
+}
+
+static int finish(delta_patch_t *p)
+{
+    if (flush(p) != 0) {
+        return -1;
+    }
+    if (p->written != p->target_size) {
+        return fail(p, "target size mismatch");
+    }
+    p->state = ST_DONE;
+    return 0;
+}
+
+static int step(delta_patch_t *p, uint8_t b)
+{
+    int r;
+    uint32_t v;
+    switch (p->state) {
+        case ST_HEADER:
+            p->hdr[p->hdr_len++] = b;
+            return p->hdr_len == DELTA_PATCH_HDR_LEN ? parse_header(p) : 0;
+
+        case ST_OPCODE:
+            p->op = b;
+            switch (b) {
+                case DELTA_OP_END:    return finish(p);
+                case DELTA_OP_ADD:    p->state = ST_ADD_SEEK; return 0;
+                case DELTA_OP_INSERT: p->state = ST_INSERT_LEN; return 0;
+                default:              return fail(p, "unknown operation");
+            }
+
+        case ST_ADD_SEEK:
+            if ((r = varint_step(p, b, &v)) <= 0) {
+                return r;
+            }
+            {
+                // zigzag: 0, -1, 1, -2, ...
+                int64_t seek = (v & 1) ? -(int64_t)(v >> 1) - 1 : (int64_t)(v >> 1);
+                int64_t pos = (int64_t)p->src_pos + seek;
+                if (pos < 0 || pos > p->source_size) {
+                    return fail(p, "seek outside source");
+                }
+                p->src_pos = (uint32_t)pos;
+            }
+            p->state = ST_ADD_LEN;
+            return 0;
+
+        case ST_ADD_LEN:
+        case ST_INSERT_LEN:
+            if ((r = varint_step(p, b, &v)) <= 0) {
+                return r;
+            }
+            return start_op(p, v);
+
+        case ST_ADD_RUN:
+            if ((r = varint_step(p, b, &v)) <= 0) {
+                return r;
+            }
+            return copy_run(p, v);
+
+        case ST_ADD_COUNT:
+            if ((r = varint_step(p, b, &v)) <= 0) {
+                return r;
+            }
+            if (v == 0 || v > p->remaining) {
+                return fail(p, "bad diff count");
+            }
+            p->group = v;
+            p->state = ST_ADD_BYTES;
+            return 0;
+
+        case ST_ADD_BYTES:
+            if ((r = source_byte(p)) < 0 || emit(p, (uint8_t)(r + b)) != 0) {
+                return -1;
+            }
+            p->remaining--;
+            if (--p->group == 0) {
+                p->state = p->remaining ? ST_ADD_RUN : ST_OPCODE;
+            }
+            return 0;
+
+        case ST_INSERT_BYTES:
+            if (emit(p, b) != 0) {
+                return -1;
+            }
+            if (--p->remaining == 0) {
+                p->state = ST_OPCODE;
+            }
+            return 0;
+
+        case ST_DONE:
+            return fail(p, "data after end of patch");
+
+        default:
+            return -1;
+    }
+}
+
+int delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    if (patch->state == ST_ERROR) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (step(patch, data[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Streaming decoder for delta firmware patches made by ota_delta.py. The
+// patch rebuilds the new image from the running one (the source) and is
+// applied as it arrives: fed in chunks of any size, it reads the source at
+// random offsets and writes the target strictly sequentially, so the output
+// can go straight into the passive OTA slot.
+//
+// Patch layout (integers little-endian, varints unsigned LEB128, seeks
+// zigzag-encoded):
+//
+// offset size  field
+//   0     4    magic "R6DP"
+//   4     1    format version (DELTA_PATCH_VERSION)
+//   5     3    reserved
+//   8     4    source image size
+//  12     4    target image size
+//  16    32    SHA-256 of the source image
+//  48    32    SHA-256 of the target image
+//  80     -    operations, ending with DELTA_OP_END
+//
+// DELTA_OP_ADD    seek, len, then (zero run, count, count bytes) groups
+//                 covering len bytes: target = source + diff (mod 256),
+//                 source read from the current position after the seek
+// DELTA_OP_INSERT len, len literal bytes
+#define DELTA_PATCH_VERSION     1
+#define DELTA_PATCH_HDR_LEN     80
+
+#define DELTA_OP_END            0x00
+#define DELTA_OP_ADD            0x01
+#define DELTA_OP_INSERT         0x02
+
+#define DELTA_SRC_CACHE         256
+#define DELTA_OUT_BUF           1024
+
+// Callbacks return 0 on success; anything else aborts the patch
+typedef int (*delta_read_fn_t)(uint32_t offset, uint8_t *buf, size_t len, void *ctx);
+typedef int (*delta_write_fn_t)(const uint8_t *buf, size_t len, void *ctx);
+
+typedef struct delta_patch delta_patch_t;
+typedef int (*delta_header_fn_t)(const delta_patch_t *patch, void *ctx);
+
+struct delta_patch {
+    // Header, valid once on_header has been called
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t source_sha256[32];
+    uint8_t target_sha256[32];
+
+    uint32_t written;           // target bytes produced
+    const char *error;          // set when delta_patch_feed fails
+
+    // Internal
+    delta_read_fn_t read_source;
+    delta_write_fn_t write_target;
+    delta_header_fn_t on_header;
+    void *ctx;
+    uint8_t state;
+    uint8_t hdr[DELTA_PATCH_HDR_LEN];
+    uint32_t hdr_len;
+    uint32_t varint;
+    uint8_t varint_shift;
+    uint8_t op;
+    uint32_t src_pos;
+    uint32_t remaining;         // bytes left in the current operation
+    uint32_t group;             // bytes left in the current run or count
+    uint32_t cache_base;
+    uint32_t cache_len;
+    uint8_t cache[DELTA_SRC_CACHE];
+    uint32_t out_len;
+    uint8_t out[DELTA_OUT_BUF];
+};
+
+// on_header may be NULL; it runs before any target byte is written, so it
+// can check source_sha256 against the running image and refuse the patch.
+void delta_patch_init(delta_patch_t *patch, delta_read_fn_t read_source, delta_write_fn_t write_target,
+                      delta_header_fn_t on_header, void *ctx);
+
+// Returns 0, or -1 with patch->error set. Data after the end marker is an error.
+int delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len);
+
+// The end marker has been read and the whole target written
+bool delta_patch_done(const delta_patch_t *patch);
+
+#endif // DELTA_PATCH_H
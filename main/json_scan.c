@@ -0,0 +1,234 @@
+#include <string.h>
+#include "json_scan.h"
+
+typedef struct {
+    const char *p;
+    const char *end;
+} scanner_t;
+
+static void skip_ws(scanner_t *s)
+{
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r')) {
+        s->p++;
+    }
+}
+
+// At the opening quote; leaves p after the closing quote
+static bool scan_string(scanner_t *s, json_value_t *v)
+{
+    s->p++;
+    v->type = JSON_STRING;
+    v->start = s->p;
+    v->escaped = false;
+    while (s->p < s->end) {
+        char c = *s->p;
+        if (c == '"') {
+            v->len = (size_t)(s->p - v->start);
+            s->p++;
+            return true;
+        }
+        if ((unsigned char)c < 0x20) {
+            return false;
+        }
+        if (c == '\\') {
+            v->escaped = true;
+            s->p++;
+            if (s->p == s->end) {
+                return false;
+            }
+        }
+        s->p++;
+    }
+    return false;
+}
+
+static bool scan_number(scanner_t *s, json_value_t *v)
+{
+    const char *p = s->p;
+    v->type = JSON_NUMBER;
+    v->start = p;
+    if (p < s->end && *p == '-') {
+        p++;
+    }
+    const char *digits = p;
+    while (p < s->end && *p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (p == digits) {
+        return false;
+    }
+    if (p < s->end && *p == '.') {
+        p++;
+        digits = p;
+        while (p < s->end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == digits) {
+            return false;
+        }
+    }
+    if (p < s->end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < s->end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        digits = p;
+        while (p < s->end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p == digits) {
+            return false;
+        }
+    }
+    v->len = (size_t)(p - v->start);
+    s->p = p;
+    return true;
+}
+
+static bool scan_literal(scanner_t *s, json_value_t *v, const char *word, json_type_t type)
+{
+    size_t n = strlen(word);
+    if ((size_t)(s->end - s->p) < n || memcmp(s->p, word, n) != 0) {
+        return false;
+    }
+    v->type = type;
+    v->start = s->p;
+    v->len = n;
+    s->p += n;
+    return true;
+}
+
+// Skip a nested object or array by bracket depth, stepping over strings
+static bool scan_container(scanner_t *s, json_value_t *v)
+{
+    v->type = (*s->p == '{') ? JSON_OBJECT : JSON_ARRAY;
+    v->start = s->p;
+    int depth = 0;
+    while (s->p < s->end) {
+        char c = *s->p;
+        if (c == '"') {
+            json_value_t str;
+            if (!scan_string(s, &str)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                s->p++;
+                v->len = (size_t)(s->p - v->start);
+                return true;
+            }
+        }
+        s->p++;
+    }
+    return false;
+}
+
+static bool scan_value(scanner_t *s, json_value_t *v)
+{
+    if (s->p == s->end) {
+        return false;
+    }
+    switch (*s->p) {
+        case '"': return scan_string(s, v);
+        case '{':
+        case '[': return scan_container(s, v);
+        case 't': return scan_literal(s, v, "true", JSON_TRUE);
+        case 'f': return scan_literal(s, v, "false", JSON_FALSE);
+        case 'n': return scan_literal(s, v, "null", JSON_NULL);
+        default:  return scan_number(s, v);
+    }
+}
+
+esp_err_t json_scan_object(const char *json, size_t len, json_member_fn_t fn, void *ctx)
+{
+    scanner_t s = { json, json + len };
+
+    skip_ws(&s);
+    if (s.p == s.end || *s.p != '{') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s.p++;
+    skip_ws(&s);
+    if (s.p < s.end && *s.p == '}') {
+        s.p++;
+    } else {
+        for (;;) {
+            json_value_t key, value;
+            skip_ws(&s);
+            if (s.p == s.end || *s.p != '"' || !scan_string(&s, &key)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            skip_ws(&s);
+            if (s.p == s.end || *s.p != ':') {
+                return ESP_ERR_INVALID_ARG;
+            }
+            s.p++;
+            skip_ws(&s);
+            if (!scan_value(&s, &value)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (!fn(key.start, key.len, &value, ctx)) {
+                return ESP_ERR_INVALID_STATE;
+            }
+            skip_ws(&s);
+            if (s.p < s.end && *s.p == ',') {
+                s.p++;
+                continue;
+            }
+            if (s.p < s.end && *s.p == '}') {
+                s.p++;
+                break;
+            }
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // Nothing but whitespace (or a C string terminator) may follow
+    skip_ws(&s);
+    if (s.p < s.end && *s.p != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+bool json_value_int(const json_value_t *value, int32_t *out)
+{
+    if (value->type != JSON_NUMBER) {
+        return false;
+    }
+    const char *p = value->start;
+    const char *end = p + value->len;
+    bool negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+    int64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        v = v * 10 + (*p - '0');
+        if (v > (int64_t)INT32_MAX + 1) {
+            return false;
+        }
+    }
+    // A fraction is truncated (as cJSON's valueint did); an exponent is refused
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+    if (negative) {
+        v = -v;
+    }
+    if (v > INT32_MAX || v < INT32_MIN) {
+        return false;
+    }
+    *out = (int32_t)v;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Single-pass scanner for flat JSON objects, in the spirit of jsmn: it never
+// allocates or builds a tree, it reports each top-level member as spans into
+// the input. Nested objects and arrays are skipped over as one value.
+
+typedef enum {
+    JSON_STRING,    // span excludes the quotes; escapes are left as written
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    JSON_OBJECT,    // span includes the braces
+    JSON_ARRAY,
+} json_type_t;
+
+typedef struct {
+    json_type_t type;
+    const char *start;
+    size_t len;
+    bool escaped;   // JSON_STRING contains a backslash escape
+} json_value_t;
+
+// Called for each member in document order; return false to stop the scan
+typedef bool (*json_member_fn_t)(const char *key, size_t key_len, const json_value_t *value, void *ctx);
+
+// Walk the members of the object in json[0..len). Returns ESP_ERR_INVALID_ARG
+// if the input is not a single well-formed object (members before the error
+// have already been reported), ESP_ERR_INVALID_STATE if fn stopped the scan.
+esp_err_t json_scan_object(const char *json, size_t len, json_member_fn_t fn, void *ctx);
+
+// Integer value of a JSON_NUMBER, truncating any fraction. False for other
+// types, exponents and values outside int32_t.
+bool json_value_int(const json_value_t *value, int32_t *out);
+
+#endif // JSON_SCAN_H
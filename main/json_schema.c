@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "json_scan.h"
+#include "json_schema.h"
+
+typedef struct {
+    const schema_field_t *fields;
+    size_t count;
+    schema_value_t values[JSON_SCHEMA_MAX_FIELDS];
+    uint32_t present;
+    schema_result_t *result;
+} schema_scan_t;
+
+static const schema_field_t *find_field(const schema_scan_t *sc, const char *key, size_t key_len, size_t *index)
+{
+    for (size_t i = 0; i < sc->count; i++) {
+        const char *k = sc->fields[i].key;
+        if (strncmp(k, key, key_len) == 0 && k[key_len] == '\0') {
+            *index = i;
+            return &sc->fields[i];
+        }
+    }
+    return NULL;
+}
+
+static bool convert(const schema_field_t *f, const json_value_t *v, schema_value_t *out)
+{
+    switch (f->type) {
+        case SCHEMA_INT:
+            return json_value_int(v, &out->i) && out->i >= f->min && out->i <= f->max;
+        case SCHEMA_BOOL:
+            if (v->type != JSON_TRUE && v->type != JSON_FALSE) {
+                return false;
+            }
+            out->b = (v->type == JSON_TRUE);
+            return true;
+        case SCHEMA_STRING:
+            if (v->type != JSON_STRING || v->escaped ||
+                v->len < (size_t)f->min || v->len > (size_t)f->max) {
+                return false;
+            }
+            out->s = v->start;
+            out->s_len = v->len;
+            return true;
+    }
+    return false;
+}
+
+static bool on_member(const char *key, size_t key_len, const json_value_t *value, void *ctx)
+{
+    schema_scan_t *sc = ctx;
+    size_t i;
+    const schema_field_t *f = find_field(sc, key, key_len, &i);
+    if (f == NULL) {
+        sc->result->unknown++;
+        return true;
+    }
+    if (!convert(f, value, &sc->values[i])) {
+        printf("Setting %s: invalid value %.*s (expected %s %" PRId32 "..%" PRId32 ")\n",
+               f->key, (int)value->len, value->start,
+               f->type == SCHEMA_INT ? "integer" : f->type == SCHEMA_BOOL ? "true/false" : "string of length",
+               f->min, f->max);
+        sc->result->rejected++;
+        sc->present &= ~(1u << i);
+        return true;
+    }
+    // A repeated key overrides the earlier one
+    sc->present |= 1u << i;
+    return true;
+}
+
+esp_err_t json_schema_apply(const schema_field_t *fields, size_t count,
+                            const char *json, size_t len, void *ctx, schema_result_t *result)
+{
+    schema_scan_t sc = { .fields = fields, .count = count, .result = result };
+    memset(result, 0, sizeof(*result));
+    if (count > JSON_SCHEMA_MAX_FIELDS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = json_scan_object(json, len, on_member, &sc);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (sc.present & (1u << i)) {
+            fields[i].set(&sc.values[i], ctx);
+            result->applied |= 1u << i;
+        }
+    }
+    return ESP_OK;
+}
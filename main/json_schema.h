@@ -0,0 +1,50 @@
+#ifndef JSON_SCHEMA_H
+#define JSON_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Declarative handling of a flat JSON command object. Each field names a key,
+// its type and accepted range, and the setter to run. The payload is scanned
+// once (json_scan); only the fields present and valid are applied, in table
+// order, and only if the whole payload is well-formed.
+
+#define JSON_SCHEMA_MAX_FIELDS  32
+
+typedef enum {
+    SCHEMA_INT,     // JSON number, min..max
+    SCHEMA_BOOL,    // true / false
+    SCHEMA_STRING,  // JSON string without escapes, min..max characters
+} schema_type_t;
+
+typedef struct {
+    int32_t i;
+    bool b;
+    const char *s;  // points into the payload, not NUL-terminated
+    size_t s_len;
+} schema_value_t;
+
+typedef void (*schema_setter_t)(const schema_value_t *value, void *ctx);
+
+typedef struct {
+    const char *key;
+    schema_type_t type;
+    int32_t min;
+    int32_t max;
+    schema_setter_t set;
+} schema_field_t;
+
+typedef struct {
+    uint32_t applied;       // bit i: fields[i] was present and applied
+    uint8_t rejected;       // known keys with a wrong type or out of range
+    uint8_t unknown;        // keys not in the schema
+} schema_result_t;
+
+// Scan json[0..len) against fields[0..count) and run the setters. Returns
+// ESP_ERR_INVALID_ARG (and applies nothing) for a malformed payload.
+esp_err_t json_schema_apply(const schema_field_t *fields, size_t count,
+                            const char *json, size_t len, void *ctx, schema_result_t *result);
+
+#endif // JSON_SCHEMA_H
@@ -0,0 +1,154 @@
+#include <string.h>
+#include "json_writer.h"
+
+static void put(json_writer_t *w, const char *s, size_t n)
+{
+    if (w->overflow) {
+        return;
+    }
+    // Keep one byte for the NUL written by json_writer_finish()
+    if (n >= w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_quoted(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        put(w, run, (size_t)(s - run));
+        run = s + 1;
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', (char)c };
+            put(w, esc, sizeof(esc));
+        } else {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            put(w, esc, sizeof(esc));
+        }
+    }
+    put(w, run, (size_t)(s - run));
+    put_char(w, '"');
+}
+
+// Separator and key before a value
+static void member(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1u << w->depth;
+    if (w->has_members & bit) {
+        put_char(w, ',');
+    }
+    w->has_members |= bit;
+    if (key != NULL) {
+        put_quoted(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void begin(json_writer_t *w, const char *key, char open)
+{
+    member(w, key);
+    put_char(w, open);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    w->depth++;
+    w->has_members &= ~(1u << w->depth);
+}
+
+static void end(json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        w->overflow = true;     // unbalanced
+        return;
+    }
+    w->depth--;
+    put_char(w, close);
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = cap == 0;
+    w->depth = 0;
+    w->has_members = 0;
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key) { begin(w, key, '{'); }
+void json_writer_end_object(json_writer_t *w) { end(w, '}'); }
+void json_writer_begin_array(json_writer_t *w, const char *key) { begin(w, key, '['); }
+void json_writer_end_array(json_writer_t *w) { end(w, ']'); }
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    member(w, key);
+    put_quoted(w, value);
+}
+
+void json_writer_uint(json_writer_t *w, const char *key, uint32_t value)
+{
+    char digits[10];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    member(w, key);
+    put(w, &digits[sizeof(digits) - n], n);
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int32_t value)
+{
+    if (value >= 0) {
+        json_writer_uint(w, key, (uint32_t)value);
+        return;
+    }
+    char digits[11];
+    uint32_t mag = 0u - (uint32_t)value;
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag);
+    digits[sizeof(digits) - 1 - n++] = '-';
+    member(w, key);
+    put(w, &digits[sizeof(digits) - n], n);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    member(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+size_t json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow || w->depth != 0) {
+        if (w->cap > 0) {
+            w->buf[0] = '\0';
+        }
+        return 0;
+    }
+    w->buf[w->len] = '\0';
+    return w->len;
+}
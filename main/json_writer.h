@@ -0,0 +1,43 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Streaming writer for compact JSON into a caller-supplied buffer: no tree,
+// no allocation. Members are written in call order; key is the member name
+// inside an object and NULL at the top level or inside an array. Once the
+// buffer is full every later call is a no-op and json_writer_finish()
+// returns 0, so callers only check the result once.
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    uint8_t depth;
+    uint32_t has_members;   // bit d: the container at depth d already has a member
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+// Quotes, backslashes and control characters are escaped; other bytes
+// (UTF-8) are copied as they are
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_int(json_writer_t *w, const char *key, int32_t value);
+void json_writer_uint(json_writer_t *w, const char *key, uint32_t value);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+
+// NUL-terminate the output. Returns its length (excluding the NUL), or 0 if
+// it did not fit or the containers are unbalanced.
+size_t json_writer_finish(json_writer_t *w);
+
+#endif // JSON_WRITER_H
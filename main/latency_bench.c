@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "live_publisher.h"
+#include "latency_bench.h"
+#include "task_priorities.h"
+
+#define LOAD_PERIOD_TICKS   (pdMS_TO_TICKS(10) > 0 ? pdMS_TO_TICKS(10) : 1)
+
+static const char *TAG = "latency_bench";
+
+static atomic_bool s_running;
+static latency_bench_params_t s_params;
+static latency_bench_done_fn_t s_done;
+
+// Busy for load_pct of every period, asleep for the rest
+static void load_task(void *arg)
+{
+    int64_t busy_us = (int64_t)LOAD_PERIOD_TICKS * portTICK_PERIOD_MS * 1000 * s_params.load_pct / 100;
+    TickType_t last = xTaskGetTickCount();
+    for (;;) {
+        int64_t start = esp_timer_get_time();
+        while (esp_timer_get_time() - start < busy_us) {
+        }
+        xTaskDelayUntil(&last, LOAD_PERIOD_TICKS);
+    }
+}
+
+static void bench_task(void *arg)
+{
+    live_latency_t lat;
+    TaskHandle_t load = NULL;
+
+    ESP_LOGI(TAG, "%u s, %u%% load at priority %u", s_params.seconds, s_params.load_pct, s_params.priority);
+    live_publisher_get_latency(&lat, true);
+    if (s_params.load_pct > 0) {
+        xTaskCreate(load_task, "bench_load", 2048, NULL, s_params.priority, &load);
+    }
+    vTaskDelay(pdMS_TO_TICKS((uint32_t)s_params.seconds * 1000));
+    if (load != NULL) {
+        vTaskDelete(load);      // holds nothing but its own stack
+    }
+    live_publisher_get_latency(&lat, false);
+
+    char json[192];
+    int len = snprintf(json, sizeof(json),
+                       "{\"seconds\":%u,\"load_pct\":%u,\"priority\":%u,"
+                       "\"event\":{\"n\":%lu,\"avg_us\":%lu,\"max_us\":%lu},"
+                       "\"alarm\":{\"n\":%lu,\"avg_us\":%lu,\"max_us\":%lu}}",
+                       s_params.seconds, s_params.load_pct, s_params.priority,
+                       (unsigned long)lat.event.count,
+                       (unsigned long)(lat.event.count ? lat.event.sum_us / lat.event.count : 0),
+                       (unsigned long)lat.event.max_us,
+                       (unsigned long)lat.alarm.count,
+                       (unsigned long)(lat.alarm.count ? lat.alarm.sum_us / lat.alarm.count : 0),
+                       (unsigned long)lat.alarm.max_us);
+    ESP_LOGI(TAG, "%s", json);
+    if (len > 0 && (size_t)len < sizeof(json)) {
+        s_done(json, (size_t)len);
+    }
+
+    atomic_store(&s_running, false);
+    vTaskDelete(NULL);
+}
+
+esp_err_t latency_bench_start(const latency_bench_params_t *params, latency_bench_done_fn_t done)
+{
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&s_running, &idle, true)) {
+        ESP_LOGW(TAG, "A bench is already running");
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_params = *params;
+    if (s_params.load_pct > LATENCY_BENCH_MAX_LOAD_PCT) {
+        s_params.load_pct = LATENCY_BENCH_MAX_LOAD_PCT;
+    }
+    s_done = done;
+    if (xTaskCreate(bench_task, "latency_bench", 3072, NULL, TASK_PRIO_LATENCY_BENCH, NULL) != pdPASS) {
+        atomic_store(&s_running, false);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
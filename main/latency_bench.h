@@ -0,0 +1,31 @@
+#ifndef LATENCY_BENCH_H
+#define LATENCY_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Alarm pipeline latency under load. For the given time a load task burns
+// load_pct of the CPU at the given priority while the normal radar traffic
+// flows; the live publisher's latency totals (live_publisher.h) are
+// restarted at the start and reported at the end:
+//   {"seconds":s,"load_pct":p,"priority":n,
+//    "event":{"n":count,"avg_us":a,"max_us":m},"alarm":{...}}
+// "event" is radar bytes read -> change picked up by the live publisher,
+// "alarm" is radar bytes read -> alarm/presence publish enqueued.
+
+#define LATENCY_BENCH_MAX_LOAD_PCT  90  // the idle task must still run
+
+typedef struct {
+    uint16_t seconds;
+    uint8_t load_pct;
+    uint8_t priority;           // of the load task
+} latency_bench_params_t;
+
+typedef void (*latency_bench_done_fn_t)(const char *json, size_t len);
+
+// Run a bench in the background; done is called from the bench task.
+// Returns ESP_ERR_INVALID_STATE while another bench is running.
+esp_err_t latency_bench_start(const latency_bench_params_t *params, latency_bench_done_fn_t done);
+
+#endif // LATENCY_BENCH_H
@@ -0,0 +1,64 @@
+#include <string.h>
+#include "live_binary.h"
+
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    return p + 2;
+}
+
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+    return p + 4;
+}
+
+size_t live_binary_encode(uint8_t *buf, const live_sample_t *sample, uint16_t seq, const char *device_id)
+{
+    uint8_t *p = buf;
+    uint8_t flags = 0;
+    if (sample->presence)         flags |= LIVE_FLAG_PRESENCE;
+    if (sample->fall_alarm)       flags |= LIVE_FLAG_FALL_ALARM;
+    if (sample->stay_still_alarm) flags |= LIVE_FLAG_STAY_STILL_ALARM;
+
+    *p++ = LIVE_BINARY_VERSION;
+    *p++ = flags;
+    p = put_u16(p, seq);
+    *p++ = sample->movement_state;
+    *p++ = sample->body_movement_param;
+    *p++ = sample->heartbeat;
+    p = put_u16(p, (uint16_t)sample->traj_x);
+    p = put_u16(p, (uint16_t)sample->traj_y);
+    p = put_u16(p, sample->total_height_count);
+    memcpy(p, sample->height_prop, 4);
+    p += 4;
+    p = put_u32(p, sample->non_presence_time);
+
+    size_t id_len = strnlen(device_id, LIVE_BINARY_MAX_ID_LEN);
+    *p++ = (uint8_t)id_len;
+    memcpy(p, device_id, id_len);
+    p += id_len;
+
+    return (size_t)(p - buf);
+}
+
+uint8_t live_format_from_str(const char *name)
+{
+    if (strcmp(name, "json") == 0)   return LIVE_FORMAT_JSON;
+    if (strcmp(name, "binary") == 0) return LIVE_FORMAT_BINARY;
+    if (strcmp(name, "both") == 0)   return LIVE_FORMAT_BOTH;
+    return 0;
+}
+
+const char *live_format_to_str(uint8_t format)
+{
+    switch (format) {
+        case LIVE_FORMAT_BINARY: return "binary";
+        case LIVE_FORMAT_BOTH:   return "both";
+        default:                 return "json";
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef LIVE_BINARY_H
+#define LIVE_BINARY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compact fixed-layout encoding of the live snapshot, published next to (or
+// instead of) the JSON payload. All multi-byte fields are little-endian.
+//
+// offset size  field
+//   0     1    format version (LIVE_BINARY_VERSION)
+//   1     1    flags: bit0 presence, bit1 fall_alarm, bit2 stay_still_alarm
+//   2     2    sequence number (wraps)
+//   4     1    movement_state
+//   5     1    body_movement_param
+//   6     1    heartbeat
+//   7     2    trajectory_x (int16)
+//   9     2    trajectory_y (int16)
+//  11     2    total_height_count
+//  13     4    height proportions 0-0.5 / 0.5-1 / 1-1.5 / 1.5-2 m
+//  17     4    non_presence_time (seconds)
+//  21     1    device_id length (n)
+//  22     n    device_id (not NUL-terminated)
+#define LIVE_BINARY_VERSION      1
+#define LIVE_BINARY_FIXED_LEN    22
+#define LIVE_BINARY_MAX_ID_LEN   31
+#define LIVE_BINARY_MAX_LEN      (LIVE_BINARY_FIXED_LEN + LIVE_BINARY_MAX_ID_LEN)
+
+#define LIVE_FLAG_PRESENCE          (1 << 0)
+#define LIVE_FLAG_FALL_ALARM        (1 << 1)
+#define LIVE_FLAG_STAY_STILL_ALARM  (1 << 2)
+
+// Which live encodings a device publishes (bitmask, selectable per device)
+#define LIVE_FORMAT_JSON    (1 << 0)
+#define LIVE_FORMAT_BINARY  (1 << 1)
+#define LIVE_FORMAT_BOTH    (LIVE_FORMAT_JSON | LIVE_FORMAT_BINARY)
+
+typedef struct {
+    bool presence;
+    bool fall_alarm;
+    bool stay_still_alarm;
+    uint8_t movement_state;
+    uint8_t body_movement_param;
+    uint8_t heartbeat;
+    int16_t traj_x;
+    int16_t traj_y;
+    uint16_t total_height_count;
+    uint8_t height_prop[4];
+    uint32_t non_presence_time;
+} live_sample_t;
+
+// Encode into buf (at least LIVE_BINARY_MAX_LEN bytes). Returns bytes written.
+size_t live_binary_encode(uint8_t *buf, const live_sample_t *sample, uint16_t seq, const char *device_id);
+
+// "json" / "binary" / "both" <-> LIVE_FORMAT_* (returns 0 for unknown names)
+uint8_t live_format_from_str(const char *name);
+const char *live_format_to_str(uint8_t format);
+
+#endif // LIVE_BINARY_H
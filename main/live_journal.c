@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "live_journal.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_LIVE_JOURNAL_BATCH_RECORDS
+#define CONFIG_LIVE_JOURNAL_BATCH_RECORDS 32
+#endif
+#ifndef CONFIG_LIVE_JOURNAL_DRAIN_INTERVAL_MS
+#define CONFIG_LIVE_JOURNAL_DRAIN_INTERVAL_MS 200
+#endif
+
+#define JOURNAL_PARTITION   "journal"
+#define SECTOR_SIZE         4096
+#define MAX_SECTORS         64
+#define SECTOR_MAGIC        0x314C4A52  // "RJL1"
+#define SECTOR_HDR_LEN      8
+#define REC_HDR_LEN         10
+#define REC_PENDING         0xFE
+#define REC_DRAINED         0x00
+#define BATCH_HDR_LEN       8
+#define BATCH_MAX_LEN       (BATCH_HDR_LEN + CONFIG_LIVE_JOURNAL_BATCH_RECORDS * (REC_HDR_LEN - 2 + LIVE_JOURNAL_MAX_PAYLOAD))
+#define ACK_RING            8
+
+#define ACK_TIMEOUT         pdMS_TO_TICKS(10000)
+#define RETRY_DELAY         pdMS_TO_TICKS(5000)
+#define DRAIN_INTERVAL      pdMS_TO_TICKS(CONFIG_LIVE_JOURNAL_DRAIN_INTERVAL_MS)
+
+typedef struct {
+    uint16_t sector;
+    uint16_t off;
+} journal_pos_t;
+
+typedef enum {
+    SLOT_FREE,          // erased space: end of the sector's records
+    SLOT_CORRUPT,       // torn or garbled write: nothing after it can be trusted
+    SLOT_PENDING,
+    SLOT_DRAINED,
+} journal_slot_t;
+
+// A record in the batch in flight. The sector sequence detects the ring
+// recycling the sector while the batch waits for its acknowledgement.
+typedef struct {
+    journal_pos_t pos;
+    uint32_t sector_seq;
+} batch_entry_t;
+
+static const esp_partition_t *s_part;
+static const uint8_t *s_map;                    // read-only mapping of the partition
+static esp_partition_mmap_handle_t s_map_handle;
+static uint16_t s_sectors;
+static uint32_t s_sector_seq[MAX_SECTORS];      // 0 = no valid header
+static uint32_t s_next_seq;
+static journal_pos_t s_head;                    // next write position
+static journal_pos_t s_tail;                    // no pending records before this
+static uint16_t s_boot;
+static live_journal_stats_t s_stats;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static live_journal_publish_fn_t s_publish;
+static volatile bool s_online;
+
+// Recently acknowledged msg_ids (written by the MQTT task)
+static volatile int s_acked[ACK_RING];
+static volatile uint32_t s_acked_next;
+
+static uint8_t s_batch[BATCH_MAX_LEN];
+static batch_entry_t s_batch_entries[CONFIG_LIVE_JOURNAL_BATCH_RECORDS];
+
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    return p + 2;
+}
+
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+    return p + 4;
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-8, polynomial 0x07
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline const uint8_t *map_at(journal_pos_t pos)
+{
+    return s_map + (size_t)pos.sector * SECTOR_SIZE + pos.off;
+}
+
+static inline size_t flash_offset(journal_pos_t pos)
+{
+    return (size_t)pos.sector * SECTOR_SIZE + pos.off;
+}
+
+static uint32_t sector_seq_on_flash(uint16_t sector)
+{
+    const uint8_t *hdr = s_map + (size_t)sector * SECTOR_SIZE;
+    uint32_t seq = get_u32(hdr + 4);
+    return (get_u32(hdr) == SECTOR_MAGIC && seq != UINT32_MAX) ? seq : 0;
+}
+
+// Classify the record at pos; *len is its total size for pending/drained slots
+static journal_slot_t read_slot(journal_pos_t pos, size_t *len)
+{
+    if (pos.off + REC_HDR_LEN > SECTOR_SIZE) {
+        return SLOT_FREE;
+    }
+    const uint8_t *r = map_at(pos);
+    bool erased = true;
+    for (int i = 0; i < REC_HDR_LEN; i++) {
+        erased &= (r[i] == 0xFF);
+    }
+    if (erased) {
+        return SLOT_FREE;
+    }
+    size_t n = REC_HDR_LEN + r[3];
+    if (r[3] > LIVE_JOURNAL_MAX_PAYLOAD || pos.off + n > SECTOR_SIZE || crc8(r + 2, n - 2) != r[1]) {
+        return SLOT_CORRUPT;
+    }
+    *len = n;
+    return r[0] == REC_PENDING ? SLOT_PENDING : SLOT_DRAINED;
+}
+
+// Pending records from pos to the end of its sector
+static uint32_t count_pending(journal_pos_t pos)
+{
+    uint32_t count = 0;
+    size_t len;
+    journal_slot_t slot;
+    while ((slot = read_slot(pos, &len)) == SLOT_PENDING || slot == SLOT_DRAINED) {
+        if (slot == SLOT_PENDING) {
+            count++;
+        }
+        pos.off += len;
+    }
+    return count;
+}
+
+// Erase the oldest sector and continue writing there. Called with s_lock held.
+static esp_err_t open_next_sector(void)
+{
+    uint16_t next = (s_head.sector + 1) % s_sectors;
+
+    if (s_stats.pending > 0 && s_tail.sector == next) {
+        // Ring full: the oldest sector still holds records that were never drained
+        uint32_t lost = s_sector_seq[next] != 0 ? count_pending(s_tail) : 0;
+        s_stats.pending -= lost;
+        s_stats.dropped += lost;
+        s_tail = (journal_pos_t){ (next + 1) % s_sectors, SECTOR_HDR_LEN };
+    }
+
+    s_sector_seq[next] = 0;
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)next * SECTOR_SIZE, SECTOR_SIZE);
+    if (err == ESP_OK) {
+        s_stats.sector_erases++;
+        uint8_t hdr[SECTOR_HDR_LEN];
+        put_u32(put_u32(hdr, SECTOR_MAGIC), s_next_seq);
+        err = esp_partition_write(s_part, (size_t)next * SECTOR_SIZE, hdr, sizeof(hdr));
+    }
+    if (err != ESP_OK) {
+        // Skip this sector on the next append rather than writing headerless records
+        s_head = (journal_pos_t){ next, SECTOR_SIZE };
+        return err;
+    }
+
+    s_sector_seq[next] = s_next_seq++;
+    s_head = (journal_pos_t){ next, SECTOR_HDR_LEN };
+    if (s_stats.pending == 0) {
+        s_tail = s_head;
+    }
+    return ESP_OK;
+}
+
+// Rebuild head, tail, pending count and boot number from the flash contents
+static void mount(void)
+{
+    uint32_t max_seq = 0;
+    int head = -1;
+    for (uint16_t s = 0; s < s_sectors; s++) {
+        s_sector_seq[s] = sector_seq_on_flash(s);
+        if (s_sector_seq[s] > max_seq) {
+            max_seq = s_sector_seq[s];
+            head = s;
+        }
+    }
+    s_next_seq = max_seq + 1;
+
+    if (head < 0) {
+        // Empty journal: the first append opens sector 0
+        s_head = (journal_pos_t){ s_sectors - 1, SECTOR_SIZE };
+        s_tail = (journal_pos_t){ 0, SECTOR_HDR_LEN };
+        s_boot = 0;
+        return;
+    }
+
+    bool tail_found = false;
+    bool any = false;
+    uint16_t last_boot = 0;
+    s_head = (journal_pos_t){ head, SECTOR_SIZE };
+
+    // Walk the ring from the oldest sector to the newest
+    for (uint16_t i = 1; i <= s_sectors; i++) {
+        uint16_t sector = (head + i) % s_sectors;
+        if (s_sector_seq[sector] == 0) {
+            continue;
+        }
+        journal_pos_t pos = { sector, SECTOR_HDR_LEN };
+        size_t len;
+        journal_slot_t slot;
+        while ((slot = read_slot(pos, &len)) == SLOT_PENDING || slot == SLOT_DRAINED) {
+            const uint8_t *r = map_at(pos);
+            last_boot = r[4] | (r[5] << 8);     // the walk is oldest first
+            any = true;
+            if (slot == SLOT_PENDING) {
+                if (!tail_found) {
+                    s_tail = pos;
+                    tail_found = true;
+                }
+                s_stats.pending++;
+            }
+            pos.off += len;
+        }
+        if (sector == head && slot == SLOT_FREE) {
+            s_head = pos;
+        }
+    }
+
+    if (!tail_found) {
+        s_tail = s_head;
+    }
+    s_boot = any ? last_boot + 1 : 0;
+}
+
+esp_err_t live_journal_append(live_journal_type_t type, const uint8_t *payload, size_t len)
+{
+    if (s_part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (len > LIVE_JOURNAL_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t rec[REC_HDR_LEN + LIVE_JOURNAL_MAX_PAYLOAD];
+    uint8_t *p = rec;
+    *p++ = REC_PENDING;
+    *p++ = 0;                                   // CRC, filled in below
+    *p++ = (uint8_t)type;
+    *p++ = (uint8_t)len;
+    p = put_u16(p, s_boot);
+    p = put_u32(p, (uint32_t)(esp_timer_get_time() / 1000000));
+    memcpy(p, payload, len);
+    size_t rec_len = REC_HDR_LEN + len;
+    rec[1] = crc8(rec + 2, rec_len - 2);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_head.off + rec_len > SECTOR_SIZE) {
+        err = open_next_sector();
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(s_part, flash_offset(s_head), rec, rec_len);
+        if (err == ESP_OK) {
+            s_head.off += rec_len;
+            s_stats.appended++;
+            s_stats.pending++;
+        } else {
+            // Never append after a half-programmed record
+            s_head.off = SECTOR_SIZE;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+// Copy up to CONFIG_LIVE_JOURNAL_BATCH_RECORDS pending records, oldest first,
+// into s_batch. Returns the batch length (0 if nothing is pending).
+// Called with s_lock held.
+static size_t build_batch(size_t *count)
+{
+    uint8_t *p = s_batch + BATCH_HDR_LEN;
+    journal_pos_t pos = s_tail;
+    size_t n = 0;
+
+    while (n < CONFIG_LIVE_JOURNAL_BATCH_RECORDS) {
+        size_t len = 0;
+        journal_slot_t slot = s_sector_seq[pos.sector] != 0 ? read_slot(pos, &len) : SLOT_CORRUPT;
+        if (slot == SLOT_FREE || slot == SLOT_CORRUPT) {
+            if (pos.sector == s_head.sector) {
+                break;  // caught up with the writer
+            }
+            pos = (journal_pos_t){ (pos.sector + 1) % s_sectors, SECTOR_HDR_LEN };
+        } else {
+            if (slot == SLOT_PENDING) {
+                memcpy(p, map_at(pos) + 2, len - 2);
+                p += len - 2;
+                s_batch_entries[n++] = (batch_entry_t){ pos, s_sector_seq[pos.sector] };
+            }
+            pos.off += len;
+        }
+        if (n == 0) {
+            s_tail = pos;   // everything before here is drained
+        }
+    }
+
+    *count = n;
+    if (n == 0) {
+        s_stats.pending = 0;
+        return 0;
+    }
+    uint8_t *h = s_batch;
+    *h++ = LIVE_JOURNAL_BATCH_VERSION;
+    *h++ = (uint8_t)n;
+    h = put_u16(h, s_boot);
+    put_u32(h, (uint32_t)(esp_timer_get_time() / 1000000));
+    return (size_t)(p - s_batch);
+}
+
+// Flip the state byte of every record in the acknowledged batch. Called with s_lock held.
+static void mark_drained(size_t count)
+{
+    static const uint8_t drained = REC_DRAINED;
+    for (size_t i = 0; i < count; i++) {
+        const batch_entry_t *e = &s_batch_entries[i];
+        if (s_sector_seq[e->pos.sector] != e->sector_seq) {
+            continue;   // recycled meanwhile; already counted as dropped
+        }
+        if (esp_partition_write(s_part, flash_offset(e->pos), &drained, 1) == ESP_OK) {
+            s_stats.pending--;
+            s_stats.drained++;
+        }
+    }
+}
+
+static bool was_acked(int msg_id)
+{
+    for (int i = 0; i < ACK_RING; i++) {
+        if (s_acked[i] == msg_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool wait_acked(int msg_id)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (!was_acked(msg_id)) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (!s_online || waited >= ACK_TIMEOUT) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, ACK_TIMEOUT - waited);
+    }
+    return true;
+}
+
+// Publish the backlog one batch at a time, each only after the previous one
+// was acknowledged, with DRAIN_INTERVAL in between so the live path keeps
+// most of the link. Delivery is at-least-once: a batch whose acknowledgement
+// is lost is sent again.
+static void drain_backlog(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    uint32_t records = 0;
+
+    while (s_online) {
+        size_t count;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        size_t len = build_batch(&count);
+        xSemaphoreGive(s_lock);
+
+        if (count == 0) {
+            uint32_t ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stats.last_drain_records = records;
+            s_stats.last_drain_ms = ms;
+            xSemaphoreGive(s_lock);
+            if (records > 0) {
+                printf("Journal drained %" PRIu32 " records in %" PRIu32 " ms (%" PRIu32 " records/s)\n",
+                       records, ms, ms ? records * 1000 / ms : records);
+            }
+            return;
+        }
+
+        int msg_id = s_publish(s_batch, len);
+        if (msg_id < 0 || !wait_acked(msg_id)) {
+            // Broker busy or gone; the records stay pending
+            if (s_online) {
+                vTaskDelay(RETRY_DELAY);
+            }
+            continue;
+        }
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        mark_drained(count);
+        s_stats.batches++;
+        xSemaphoreGive(s_lock);
+        records += count;
+
+        vTaskDelay(DRAIN_INTERVAL);
+    }
+}
+
+static void live_journal_task(void *arg)
+{
+    while (1) {
+        if (!s_online || s_stats.pending == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        drain_backlog();
+    }
+}
+
+void live_journal_set_online(bool online)
+{
+    s_online = online;
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void live_journal_on_published(int msg_id)
+{
+    s_acked[s_acked_next++ % ACK_RING] = msg_id;
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void live_journal_get_stats(live_journal_stats_t *out)
+{
+    if (s_lock == NULL) {
+        *out = s_stats;
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t live_journal_init(live_journal_publish_fn_t publish)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           JOURNAL_PARTITION);
+    if (part == NULL) {
+        printf("Journal partition '%s' not found; offline live data will be dropped\n", JOURNAL_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_sectors = part->size / SECTOR_SIZE;
+    if (s_sectors > MAX_SECTORS) {
+        s_sectors = MAX_SECTORS;
+    }
+    if (s_sectors < 2) {
+        printf("Journal partition too small\n");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const void *map;
+    esp_err_t err = esp_partition_mmap(part, 0, (size_t)s_sectors * SECTOR_SIZE, ESP_PARTITION_MMAP_DATA,
+                                       &map, &s_map_handle);
+    if (err != ESP_OK) {
+        printf("Journal mmap failed: %s\n", esp_err_to_name(err));
+        return err;
+    }
+    s_map = map;
+    s_part = part;
+    s_publish = publish;
+    s_lock = xSemaphoreCreateMutex();
+    for (int i = 0; i < ACK_RING; i++) {
+        s_acked[i] = -1;
+    }
+
+    mount();
+    printf("Journal: %u sectors, %" PRIu32 " pending records, boot %u\n",
+           (unsigned)s_sectors, s_stats.pending, (unsigned)s_boot);
+
+    xTaskCreate(live_journal_task, "live_journal", 3072, NULL, TASK_PRIO_LIVE_JOURNAL, &s_task);
+    return ESP_OK;
+}
@@ -0,0 +1,72 @@
+#ifndef LIVE_JOURNAL_H
+#define LIVE_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Store-and-forward journal for live data while the broker is unreachable.
+// Records are appended to the "journal" data partition and published in
+// batches once MQTT is connected again.
+//
+// The partition is a ring of 4 KB sectors, each erased only when the ring
+// wraps onto it. A sector starts with an 8-byte header (magic, u32 sector
+// sequence) followed by records, all little-endian:
+//
+// offset size  field
+//   0     1    state: 0xFF free, 0xFE pending, 0x00 drained
+//   1     1    CRC-8 over bytes 2..end
+//   2     1    type (live_journal_type_t)
+//   3     1    payload length (n)
+//   4     2    boot number
+//   6     4    uptime when recorded (seconds)
+//  10     n    payload (live_binary frame with an empty device_id)
+//
+// A published batch is an 8-byte header followed by the records exactly as
+// stored from offset 2 on:
+//
+// offset size  field
+//   0     1    format version (LIVE_JOURNAL_BATCH_VERSION)
+//   1     1    record count
+//   2     2    current boot number
+//   4     4    current uptime (seconds), to date records from this boot
+#define LIVE_JOURNAL_BATCH_VERSION  1
+#define LIVE_JOURNAL_MAX_PAYLOAD    64
+
+typedef enum {
+    LIVE_JOURNAL_ALARM = 1,     // presence, fall or stay-still alarm changed
+    LIVE_JOURNAL_SNAPSHOT,      // periodic sample
+} live_journal_type_t;
+
+// Publish one batch; returns the MQTT msg_id (QoS 1) or -1 on failure
+typedef int (*live_journal_publish_fn_t)(const uint8_t *batch, size_t len);
+
+typedef struct {
+    uint32_t appended;
+    uint32_t pending;           // appended but not yet drained
+    uint32_t dropped;           // overwritten by the ring before they were drained
+    uint32_t drained;
+    uint32_t batches;
+    uint32_t sector_erases;
+    uint32_t last_drain_records;    // last complete drain (backlog emptied)
+    uint32_t last_drain_ms;
+} live_journal_stats_t;
+
+// Mount the partition, recover the write and drain positions and start the
+// drain task. Appends fail with ESP_ERR_NOT_FOUND if the partition is missing.
+esp_err_t live_journal_init(live_journal_publish_fn_t publish);
+
+// Append a record. Blocks for the flash write (and a sector erase when the
+// ring moves on), so call it from a task, never from the UART parser.
+esp_err_t live_journal_append(live_journal_type_t type, const uint8_t *payload, size_t len);
+
+// Broker connection state; going online starts draining the backlog
+void live_journal_set_online(bool online);
+
+// Forward MQTT_EVENT_PUBLISHED so batches are only marked drained once acknowledged
+void live_journal_on_published(int msg_id);
+
+void live_journal_get_stats(live_journal_stats_t *out);
+
+#endif // LIVE_JOURNAL_H
@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "live_publisher.h"
+#include "metrics.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_LIVE_COALESCE_WINDOW_MS
+#define CONFIG_LIVE_COALESCE_WINDOW_MS 1000
+#endif
+#ifndef CONFIG_LIVE_KEEPALIVE_S
+#define CONFIG_LIVE_KEEPALIVE_S 300
+#endif
+
+#define LIVE_COALESCE_TICKS  pdMS_TO_TICKS(CONFIG_LIVE_COALESCE_WINDOW_MS)
+#define LIVE_KEEPALIVE_TICKS pdMS_TO_TICKS(CONFIG_LIVE_KEEPALIVE_S * 1000)
+
+static TaskHandle_t s_publisher_task = NULL;
+static live_publish_fn_t s_publish = NULL;
+
+// Stamp of the oldest change not yet picked up / not yet published; 0 = none
+static atomic_uint_least32_t s_event_us;
+static atomic_uint_least32_t s_alarm_us;
+static live_latency_t s_latency;
+static portMUX_TYPE s_latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void live_publisher_notify(uint32_t fields, uint32_t event_us)
+{
+    if (s_publisher_task != NULL && fields != 0) {
+        // Stamps are set before the notification so the publisher never sees bits without one
+        uint32_t stamp = event_us | 1;
+        uint_least32_t none = 0;
+        atomic_compare_exchange_strong(&s_event_us, &none, stamp);
+        if (fields & LIVE_FIELDS_CRITICAL) {
+            none = 0;
+            atomic_compare_exchange_strong(&s_alarm_us, &none, stamp);
+        }
+        xTaskNotify(s_publisher_task, fields, eSetBits);
+    }
+}
+
+static void record_latency(atomic_uint_least32_t *stamp, live_latency_stat_t *stat, metric_hist_id_t hist)
+{
+    uint32_t since = atomic_exchange(stamp, 0);
+    if (since == 0) {
+        return;
+    }
+    uint32_t us = (uint32_t)esp_timer_get_time() - since;
+    metrics_observe(hist, us);
+    taskENTER_CRITICAL(&s_latency_lock);
+    stat->count++;
+    stat->sum_us += us;
+    if (us > stat->max_us) {
+        stat->max_us = us;
+    }
+    taskEXIT_CRITICAL(&s_latency_lock);
+}
+
+void live_publisher_get_latency(live_latency_t *out, bool reset)
+{
+    taskENTER_CRITICAL(&s_latency_lock);
+    *out = s_latency;
+    if (reset) {
+        memset(&s_latency, 0, sizeof(s_latency));
+    }
+    taskEXIT_CRITICAL(&s_latency_lock);
+}
+
+static void live_publisher_task(void *arg)
+{
+    uint32_t pending = 0;
+    // Backdate the last publish so the first snapshot goes out right away
+    TickType_t last_publish = xTaskGetTickCount() - LIVE_KEEPALIVE_TICKS;
+    TickType_t coalesce_start = 0;
+
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+
+        // Sleep until the earliest of: coalescing window end, keepalive due
+        TickType_t wait = LIVE_KEEPALIVE_TICKS - (now - last_publish);
+        if ((now - last_publish) >= LIVE_KEEPALIVE_TICKS) {
+            wait = 0;
+        }
+        if (pending != 0) {
+            TickType_t elapsed = now - coalesce_start;
+            TickType_t left = elapsed >= LIVE_COALESCE_TICKS ? 0 : LIVE_COALESCE_TICKS - elapsed;
+            if (left < wait) {
+                wait = left;
+            }
+        }
+
+        uint32_t bits = 0;
+        if (wait > 0 && xTaskNotifyWait(0, UINT32_MAX, &bits, wait) == pdTRUE) {
+            if (pending == 0 && bits != 0) {
+                coalesce_start = xTaskGetTickCount();
+            }
+            pending |= bits;
+            record_latency(&s_event_us, &s_latency.event, METRIC_HIST_LIVE_EVENT_US);
+        }
+
+        now = xTaskGetTickCount();
+        bool critical = (pending & LIVE_FIELDS_CRITICAL) != 0;
+        bool window_done = pending != 0 && (now - coalesce_start) >= LIVE_COALESCE_TICKS;
+        bool keepalive_due = (now - last_publish) >= LIVE_KEEPALIVE_TICKS;
+
+        if (critical || window_done || keepalive_due) {
+            s_publish(pending);
+            if (critical) {
+                record_latency(&s_alarm_us, &s_latency.alarm, METRIC_HIST_LIVE_ALARM_US);
+            }
+            pending = 0;
+            last_publish = now;
+        }
+    }
+}
+
+void live_publisher_start(live_publish_fn_t publish)
+{
+    s_publish = publish;
+    xTaskCreate(live_publisher_task, "live_publisher", 4096, NULL, TASK_PRIO_LIVE_PUBLISHER, &s_publisher_task);
+}
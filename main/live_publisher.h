@@ -0,0 +1,50 @@
+#ifndef LIVE_PUBLISHER_H
+#define LIVE_PUBLISHER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Live fields the parser reports as changed
+#define LIVE_FIELD_PRESENCE          (1 << 0)
+#define LIVE_FIELD_FALL_ALARM        (1 << 1)
+#define LIVE_FIELD_STAY_STILL_ALARM  (1 << 2)
+#define LIVE_FIELD_MOVEMENT_STATE    (1 << 3)
+#define LIVE_FIELD_BODY_MOVEMENT     (1 << 4)
+#define LIVE_FIELD_HEARTBEAT         (1 << 5)
+#define LIVE_FIELD_TRAJECTORY        (1 << 6)
+#define LIVE_FIELD_HEIGHT            (1 << 7)
+#define LIVE_FIELD_NON_PRESENCE_TIME (1 << 8)
+
+// Published as soon as they change; everything else is coalesced
+#define LIVE_FIELDS_CRITICAL (LIVE_FIELD_PRESENCE | LIVE_FIELD_FALL_ALARM | LIVE_FIELD_STAY_STILL_ALARM)
+
+typedef void (*live_publish_fn_t)(uint32_t changed_fields);
+
+// Start the publisher task. publish() is called from that task with the set of
+// fields that changed since the last publish (0 for a keepalive snapshot).
+void live_publisher_start(live_publish_fn_t publish);
+
+// Mark fields as changed. event_us (esp_timer_get_time(), truncated) is when
+// the radar bytes behind the change were read; the publisher measures its
+// latency from there. Cheap and non-blocking; safe to call from the UART parser.
+void live_publisher_notify(uint32_t fields, uint32_t event_us);
+
+// Pipeline latency from the event_us stamps:
+//   event  until the publisher task picked the change up (any field)
+//   alarm  until the publish of a critical change returned (message enqueued)
+// Also recorded in the live.event_us / live.alarm_us histograms.
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} live_latency_stat_t;
+
+typedef struct {
+    live_latency_stat_t event;
+    live_latency_stat_t alarm;
+} live_latency_t;
+
+// Copy the totals since boot (or the last reset) and optionally restart them
+void live_publisher_get_latency(live_latency_t *out, bool reset);
+
+#endif // LIVE_PUBLISHER_H
@@ -8,9 +8,13 @@ char g_device_id[32] = DEVICE_ID; // Default Device ID (สามารถ overr
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/uart.h"
 #include "esp_system.h"
+#include "esp_random.h"
 #include "cJSON.h"
+#include "payload_json.h"
 #include <inttypes.h>
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
@@ -23,6 +27,25 @@ char g_device_id[32] = DEVICE_ID; // Default Device ID (สามารถ overr
 #include "ota_update.h" // เพิ่ม include OTA
 #include <time.h>       // <-- เพิ่มบรรทัดนี้
 #include "driver/gpio.h" // เพิ่มสำหรับใช้งาน GPIO
+#include "radar_frame.h"
+#include "radar_reports.h"
+#include "radar_encode.h"
+#include "live_binary.h"
+#include "live_publisher.h"
+#include "live_journal.h"
+#include "track_buffer.h"
+#include "settings_store.h"
+#include "mqtt_inbox.h"
+#include "topic_router.h"
+#include "json_schema.h"
+#include "radar_cmd.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include "radar_state.h"
+#include "radar_log.h"
+#include "task_profile.h"
+#include "latency_bench.h"
+#include "task_priorities.h"
 
 // เพิ่ม extern สำหรับ certificate
 extern const uint8_t server1_crt_start[] asm("_binary_dev_crt_start");
@@ -42,8 +65,8 @@ void enable_human_presence_detection(bool enable);
 void wifi_reset_button_task(void *arg);
 
 // Add these function prototypes after the other prototypes
-void save_settings_to_nvs(void);
-void load_settings_from_nvs(void);
+bool load_settings_from_nvs(void);
+void apply_settings_to_radar(void);
 
 // Add this function prototype with the other prototypes at the top of the file
 void reboot_device(void);
@@ -52,7 +75,7 @@ void reboot_device(void);
 void send_query(uint8_t control, uint8_t command, uint8_t data_payload);
 
 // Add forward declaration for mqtt_publish_settings
-void mqtt_publish_settings(void);
+void mqtt_publish_settings(bool full);
 
 // Function prototypes for MQTT publishing functions
 void mqtt_publish_product_info(void);
@@ -71,114 +94,214 @@ void load_device_id_from_nvs(void);
 // ---------------------- UART and Frame Definitions ----------------------
 #define UART_PORT_NUM      UART_NUM_1
 #define BUF_SIZE           1024
+#define UART_EVENT_QUEUE_LEN   20
+// RX timeout in UART symbol times (~87 us each at 115200). The driver posts a
+// UART_DATA event this long after the line goes idle, i.e. right after a frame.
+#define UART_RX_TIMEOUT_SYMBOLS 3
+// Also post UART_DATA when this many bytes sit in the hardware FIFO during a burst
+#define UART_RX_FULL_THRESHOLD  64
 
-#define FRAME_HEADER0      0x53
-#define FRAME_HEADER1      0x59
-#define FRAME_TAIL0        0x54
-#define FRAME_TAIL1        0x43
-
-// ---------------------- Device Identification ----------------------
-#define DEVICE_TYPE     "R60AFD1"
 
 // ---------------------- Global Variables ----------------------
 
-// Live Data (change frequently)
-volatile bool    g_presence         = false;   // Human presence
-volatile bool    g_fall_alarm       = false;   // Fall detection
-volatile bool    g_stay_still_alarm = false;   // Stay-still alarm
-volatile uint8_t g_movement_state   = 0;       // 0: No movement, 1: Static, 2: Active
-volatile uint8_t g_body_movement_param = 0;     // Body movement parameter
-volatile uint8_t g_heartbeat        = 0;       // Heartbeat value
-
-// Trajectory points (each coordinate is 2 bytes)
-volatile int16_t g_traj_x = 0;
-volatile int16_t g_traj_y = 0;
-
-// Height Proportion Report values (live measurement)
-volatile uint16_t g_total_height_count = 0;     
-volatile uint8_t  g_height_prop_0_0_5  = 0;
-volatile uint8_t  g_height_prop_0_5_1  = 0;
-volatile uint8_t  g_height_prop_1_1_5  = 0;
-volatile uint8_t  g_height_prop_1_5_2  = 0;
-
-// Non-presence time (in seconds)
-volatile uint32_t g_non_presence_time = 0;
-
-// Settings (configuration parameters, change infrequently)
-// Working status report (spontaneous or query reply)
-volatile uint8_t g_working_status   = 0;
-// Scenario Report
-volatile uint8_t g_scenario         = 0;
-// Installation configuration reports:
-volatile int16_t g_installation_angle_x = 0;
-volatile int16_t g_installation_angle_y = 0;
-volatile int16_t g_installation_angle_z = 0;
-volatile uint16_t g_installation_height   = 0;
-
-// Fall detection parameters
-volatile uint8_t g_fall_detection_sensitivity = 0;
-volatile uint32_t g_fall_duration = 0;
-volatile uint16_t g_fall_breaking_height = 0;
-
-// ---------------------- New: Distance Settings ----------------------
-// Sitting-still and Moving Horizontal Distance (both in cm)
-volatile uint16_t g_sitting_still_distance = 0;
-volatile uint16_t g_moving_distance        = 0;
-
-// ---------------------- New: Operating Time ----------------------
-volatile uint32_t g_operating_time = 0; // Operating time in seconds (queried from device)
-
-// ---------------------- Product Information ----------------------
-// Global arrays to store queried product info (filled in by the device)
-#define PRODUCT_STR_LEN 32
-char g_product_model[PRODUCT_STR_LEN]    = {0};
-char g_product_id[PRODUCT_STR_LEN]       = {0};
-char g_hardware_model[PRODUCT_STR_LEN]   = {0};
-char g_firmware_version[PRODUCT_STR_LEN] = {0};
-
-// Add this with the other global variables in the "Settings" section
-volatile bool g_stay_still_switch = true;
-volatile uint32_t g_stay_still_duration = 0;
-
-// Add this with the other global variables in the "Live Data" section
-volatile uint32_t g_height_accumulation_time = 0;  // Default value
-
-// Add this with the other global variables in the "Settings" section
-volatile bool g_fall_detection_switch = true;  // Default to enabled
+// Radar readings, settings and product info live in radar_state (radar_state.h)
+
+// Live payload encodings published by this device (LIVE_FORMAT_JSON / _BINARY / _BOTH)
+volatile uint8_t g_live_format = LIVE_FORMAT_JSON;
+
+// Created by mqtt_init() once Wi-Fi is up
+esp_mqtt_client_handle_t mqtt_client = NULL;
+
+// ---------------------- Confirmed Settings ----------------------
+// Configuration writes are tracked by the command scheduler until the radar
+// answers them. The settings in radar_state only change once that reply
+// arrives, so settings_state reflects what the radar actually accepted.
+typedef enum {
+    SETTING_PRESENCE_DETECTION = 0,
+    SETTING_INSTALLATION_ANGLES,
+    SETTING_INSTALLATION_HEIGHT,
+    SETTING_FALL_SENSITIVITY,
+    SETTING_FALL_DURATION,
+    SETTING_FALL_BREAKING_HEIGHT,
+    SETTING_SITTING_STILL_DISTANCE,
+    SETTING_MOVING_DISTANCE,
+    SETTING_STAY_STILL_SWITCH,
+    SETTING_STAY_STILL_DURATION,
+    SETTING_FALL_SWITCH,
+    SETTING_HEIGHT_ACCUMULATION_TIME,
+    SETTING_NON_PRESENCE_TIME,
+    SETTING_COUNT
+} setting_id_t;
+
+typedef union {
+    bool flag;
+    uint32_t u32;
+    struct { int16_t x, y, z; } angles;
+} setting_value_t;
+
+// Latest write per setting. A newer write cancels an older one still in flight.
+typedef struct {
+    radar_cmd_handle_t handle;
+    setting_value_t value;
+    uint8_t payload[RADAR_CMD_MAX_FRAME];   // payload sent; the radar echoes it when it accepts the write
+    uint8_t payload_len;
+} setting_write_t;
+
+static const char *const s_setting_names[SETTING_COUNT] = {
+    "presence_detection", "installation_angles", "installation_height",
+    "fall_detection_sensitivity", "fall_duration", "fall_breaking_height",
+    "sitting_still_distance", "moving_distance", "stay_still_switch",
+    "stay_still_duration", "fall_detection_switch", "height_accumulation_time",
+    "non_presence_time",
+};
+
+// Dirty bit for the settings store; the others are 1 << setting_id_t
+#define SETTINGS_DIRTY_LIVE_FORMAT (1u << SETTING_COUNT)
+
+static setting_write_t s_setting_writes[SETTING_COUNT];
+static SemaphoreHandle_t s_settings_lock;
+static volatile uint32_t s_settings_inflight = 0;   // tracked writes not yet completed
+static volatile bool s_settings_commit_requested = false;
+static TaskHandle_t s_settings_commit_task = NULL;
+
+// Copy an acknowledged value into the radar state
+static void apply_confirmed_setting(setting_id_t id, const setting_value_t *v)
+{
+    radar_state_t *st = radar_state_edit();
+    switch (id) {
+        case SETTING_INSTALLATION_ANGLES:
+            st->installation_angle_x = v->angles.x;
+            st->installation_angle_y = v->angles.y;
+            st->installation_angle_z = v->angles.z;
+            break;
+        case SETTING_INSTALLATION_HEIGHT:       st->installation_height = v->u32; break;
+        case SETTING_FALL_SENSITIVITY:          st->fall_detection_sensitivity = v->u32; break;
+        case SETTING_FALL_DURATION:             st->fall_duration = v->u32; break;
+        case SETTING_FALL_BREAKING_HEIGHT:      st->fall_breaking_height = v->u32; break;
+        case SETTING_SITTING_STILL_DISTANCE:    st->sitting_still_distance = v->u32; break;
+        case SETTING_MOVING_DISTANCE:           st->moving_distance = v->u32; break;
+        case SETTING_STAY_STILL_SWITCH:         st->stay_still_switch = v->flag; break;
+        case SETTING_STAY_STILL_DURATION:       st->stay_still_duration = v->u32; break;
+        case SETTING_FALL_SWITCH:               st->fall_detection_switch = v->flag; break;
+        case SETTING_HEIGHT_ACCUMULATION_TIME:  st->height_accumulation_time = v->u32; break;
+        case SETTING_NON_PRESENCE_TIME:         st->non_presence_time = v->u32; break;
+        default:
+            break;  // presence detection has no stored state
+    }
+    radar_state_publish();
+    if (id != SETTING_PRESENCE_DETECTION) {
+        settings_store_mark_dirty(1u << id);
+    }
+}
+
+// Is this frame the radar's answer to the pending write? Its opcode is shared
+// with spontaneous reports (non-presence time arrives on 0x80/0x12 every few
+// seconds) and with late replies to superseded writes, so the echoed payload
+// has to match what was sent.
+static bool setting_write_matches(const radar_frame_t *reply, void *ctx)
+{
+    setting_id_t id = (setting_id_t)(uintptr_t)ctx;
+
+    xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+    const setting_write_t *w = &s_setting_writes[id];
+    bool match = reply->payload_len == w->payload_len &&
+                 memcmp(reply->payload, w->payload, w->payload_len) == 0;
+    xSemaphoreGive(s_settings_lock);
+    return match;
+}
+
+// Completion of a tracked settings write (runs on the UART reader or scheduler task)
+static void setting_write_done(radar_cmd_handle_t handle, radar_cmd_result_t result,
+                               const radar_frame_t *reply, void *ctx)
+{
+    setting_id_t id = (setting_id_t)(uintptr_t)ctx;
+
+    xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+    setting_write_t *w = &s_setting_writes[id];
+    if (w->handle == handle) {
+        if (result == RADAR_CMD_OK) {
+            apply_confirmed_setting(id, &w->value);
+        }
+        w->handle = 0;
+    }
+    xSemaphoreGive(s_settings_lock);
+
+    if (result == RADAR_CMD_TIMEOUT) {
+        printf("Radar did not confirm %s; keeping previous value\n", s_setting_names[id]);
+    }
+    if (__atomic_sub_fetch(&s_settings_inflight, 1, __ATOMIC_SEQ_CST) == 0 &&
+        s_settings_commit_requested && s_settings_commit_task != NULL) {
+        xTaskNotifyGive(s_settings_commit_task);
+    }
+}
+
+// Send a configuration frame as a tracked request for the given setting
+static void request_setting(setting_id_t id, const uint8_t *frame, size_t len, setting_value_t value)
+{
+    if (len < RADAR_FRAME_OVERHEAD) {
+        return;     // the encoder rejected the buffer; nothing to send
+    }
+    radar_cmd_opts_t opts = RADAR_CMD_OPTS_DEFAULT;
+    opts.cb = setting_write_done;
+    opts.match = setting_write_matches;
+    opts.ctx = (void *)(uintptr_t)id;
+
+    __atomic_add_fetch(&s_settings_inflight, 1, __ATOMIC_SEQ_CST);
+    xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+    radar_cmd_handle_t previous = s_setting_writes[id].handle;
+    s_setting_writes[id].value = value;
+    s_setting_writes[id].payload_len = len - RADAR_FRAME_OVERHEAD;
+    memcpy(s_setting_writes[id].payload, frame + RADAR_FRAME_PREFIX_LEN, len - RADAR_FRAME_OVERHEAD);
+    s_setting_writes[id].handle = radar_cmd_request(frame, len, &opts);
+    bool queued = s_setting_writes[id].handle != 0;
+    xSemaphoreGive(s_settings_lock);
+
+    if (previous != 0) {
+        radar_cmd_cancel(previous);     // superseded; only the newest value counts
+    }
+    if (!queued) {
+        printf("Command queue full, %s not sent\n", s_setting_names[id]);
+        __atomic_sub_fetch(&s_settings_inflight, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// Publish the settings once every write queued before this call has completed
+static void request_settings_commit(void)
+{
+    s_settings_commit_requested = true;
+    if (s_settings_inflight == 0 && s_settings_commit_task != NULL) {
+        xTaskNotifyGive(s_settings_commit_task);
+    }
+}
+
+static void settings_commit_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        s_settings_commit_requested = false;
+        // Boot-time writes can settle before MQTT is started; app_main
+        // publishes the full snapshot then
+        if (mqtt_client != NULL) {
+            mqtt_publish_settings(false);
+        }
+    }
+}
+
+static void settings_commit_init(void)
+{
+    s_settings_lock = xSemaphoreCreateMutex();
+    xTaskCreate(settings_commit_task, "settings_commit", 4096, NULL, TASK_PRIO_SETTINGS_COMMIT, &s_settings_commit_task);
+}
 
 // Add this function prototype with the other prototypes at the top
 void update_fall_detection_switch(bool enable);
 
 // Add this function implementation with the other command functions
 void update_fall_detection_switch(bool enable) {
-    // Frame structure (10 bytes total):
-    // Header (2) + Control (1) + Command (1) + Length (2) + Payload (1) + Check (1) + Tail (2)
-    uint8_t frame[10];
-    frame[0] = FRAME_HEADER0;   // 0x53
-    frame[1] = FRAME_HEADER1;   // 0x59
-    frame[2] = 0x83;            // Control for fall detection settings
-    frame[3] = 0x01;            // Command for fall detection switch
-    frame[4] = 0x00;            // Length high byte
-    frame[5] = 0x01;            // Length low byte (1 byte payload)
-    frame[6] = enable ? 0x01 : 0x00; // Payload: 0x01 to enable, 0x00 to disable
-
-    // Calculate checksum
-    uint32_t sum = 0;
-    for (int i = 0; i < 7; i++) {
-        sum += frame[i];
-    }
-    frame[7] = sum & 0xFF;
-
-    // Append tail
-    frame[8] = FRAME_TAIL0;    // 0x54
-    frame[9] = FRAME_TAIL1;    // 0x43
-
-    // Send frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_fall_switch(frame, sizeof(frame), enable);
+    request_setting(SETTING_FALL_SWITCH, frame, len, (setting_value_t){ .flag = enable });
     printf("Fall Detection %s\n", enable ? "ENABLED" : "DISABLED");
-
-    // Update global variable
-    g_fall_detection_switch = enable;
 }
 
 // Helper function to convert movement state to a readable string
@@ -197,6 +320,13 @@ const char* movement_state_str(uint8_t state) {
 #define MQTT_PASSWORD        "Apollo1999!"
 // send reading live data
 char mqtt_topic_live[64];
+// send reading live data (compact binary, see live_binary.h)
+char mqtt_topic_live_bin[64];
+// send live data recorded while the broker was unreachable (see live_journal.h)
+char mqtt_topic_journal[64];
+// request / send the decimated trajectory track (see track_buffer.h)
+char mqtt_topic_track_request[64];
+char mqtt_topic_track[64];
 // request reading product info
 char mqtt_topic_info_device_id[64];
 // send reading product info
@@ -204,6 +334,18 @@ char mqtt_topic_info_device_id[64];
 
 // OTA update topic
 char mqtt_topic_ota_update[64];
+// OTA progress and result
+char mqtt_topic_ota_status[64];
+// runtime counters, gauges and histograms (see metrics.h)
+char mqtt_topic_metrics[64];
+// console log level of the radar frame log, or of an ESP-IDF log tag (see radar_log.h)
+char mqtt_topic_log_level[64];
+// request / send per-task stack, CPU and heap report (see task_profile.h)
+char mqtt_topic_tasks_request[64];
+char mqtt_topic_tasks[64];
+// run a pipeline latency bench / its result (see latency_bench.h)
+char mqtt_topic_bench_request[64];
+char mqtt_topic_bench[64];
 
 // update settings
 char mqtt_topic_settings_update[64];
@@ -211,12 +353,495 @@ char mqtt_topic_settings_update[64];
 char mqtt_topic_settings_state_device_id[64];
 // send reading settings
 #define MQTT_TOPIC_SETTINGS_STATE "R60AFD1/settings_state"
+// fleet-wide commands: R60AFD1/all/<command>
+#define MQTT_TOPIC_FLEET_PREFIX "R60AFD1/all/"
 
 static const char *MQTT_TAG = "mqtt_client";
-esp_mqtt_client_handle_t mqtt_client = NULL;
+static volatile bool s_mqtt_connected = false;
+
+// Publish and record the outcome and how long the client blocked the caller
+static int mqtt_publish(const char *topic, const char *data, int len, int qos)
+{
+    int64_t start = esp_timer_get_time();
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, len, qos, 0);
+    metrics_observe(METRIC_HIST_MQTT_PUBLISH_US, (uint32_t)(esp_timer_get_time() - start));
+    metrics_inc(msg_id < 0 ? METRIC_MQTT_PUBLISH_FAILURES : METRIC_MQTT_PUBLISHED);
+    return msg_id;
+}
+
+#ifndef CONFIG_TRACK_WINDOW_S
+#define CONFIG_TRACK_WINDOW_S 60
+#endif
+#ifndef CONFIG_TRACK_EPSILON_CM
+#define CONFIG_TRACK_EPSILON_CM 10
+#endif
+
+static SemaphoreHandle_t s_track_lock;
+
+// Publish the decimated trajectory of the last `seconds` seconds
+static void mqtt_publish_track(track_reason_t reason, uint16_t seconds, uint16_t epsilon_cm)
+{
+    static uint8_t buf[TRACK_EXPORT_MAX_LEN];
+
+    xSemaphoreTake(s_track_lock, portMAX_DELAY);
+    size_t len = track_buffer_export(buf, reason, seconds, epsilon_cm);
+    int msg_id = mqtt_publish(mqtt_topic_track, (const char *)buf, len, 1);
+    xSemaphoreGive(s_track_lock);
+
+    if (msg_id != -1) {
+        printf("Published track (%u bytes) to %s\n", (unsigned)len, mqtt_topic_track);
+    } else {
+        printf("Failed to publish track\n");
+    }
+}
+
+// Handlers for inbound MQTT messages. They run on the MQTT inbox worker, so
+// they may block on UART writes, NVS or delays without stalling the client.
+
+// ---------------------- settings_update schema ----------------------
+// Angles are sent to the radar as one command, so the three fields are
+// gathered here and merged with the confirmed values of any that are missing.
+typedef struct {
+    bool fleet;         // arrived on the fleet-wide topic
+    bool angles_set;
+    int16_t angles[3];
+} settings_update_t;
+
+static void set_device_id(const schema_value_t *v, void *ctx)
+{
+    if (((settings_update_t *)ctx)->fleet) {
+        // Renaming every device at once would make them indistinguishable
+        printf("Ignoring set_device_id in fleet-wide settings update\n");
+        return;
+    }
+    size_t len = v->s_len < sizeof(g_device_id) - 1 ? v->s_len : sizeof(g_device_id) - 1;
+    memcpy(g_device_id, v->s, len);
+    g_device_id[len] = '\0';
+    printf("Received new device ID: %s\n", g_device_id);
+    save_device_id_to_nvs();
+    printf("New device ID saved. Rebooting in 3 seconds...\n");
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    esp_restart();
+}
+
+static void set_reboot(const schema_value_t *v, void *ctx)
+{
+    if (v->b) {
+        printf("Reboot command received\n");
+        reboot_device();
+    }
+}
+
+static void set_angle(settings_update_t *u, int axis, int32_t value)
+{
+    u->angles[axis] = (int16_t)value;
+    u->angles_set = true;
+}
+
+static void set_angle_x(const schema_value_t *v, void *ctx) { set_angle(ctx, 0, v->i); }
+static void set_angle_y(const schema_value_t *v, void *ctx) { set_angle(ctx, 1, v->i); }
+static void set_angle_z(const schema_value_t *v, void *ctx) { set_angle(ctx, 2, v->i); }
+
+static void set_installation_height(const schema_value_t *v, void *ctx) { update_installation_height((uint16_t)v->i); }
+static void set_fall_sensitivity(const schema_value_t *v, void *ctx) { update_fall_detection_sensitivity((uint8_t)v->i); }
+static void set_fall_duration(const schema_value_t *v, void *ctx) { update_fall_duration((uint32_t)v->i); }
+static void set_fall_breaking_height(const schema_value_t *v, void *ctx) { update_fall_breaking_height((uint16_t)v->i); }
+static void set_sitting_still_distance(const schema_value_t *v, void *ctx) { update_sitting_still_distance((uint16_t)v->i); }
+static void set_moving_distance(const schema_value_t *v, void *ctx) { update_moving_distance((uint16_t)v->i); }
+static void set_stay_still_switch(const schema_value_t *v, void *ctx) { update_stay_still_switch(v->b); }
+static void set_stay_still_duration(const schema_value_t *v, void *ctx) { update_stay_still_duration((uint32_t)v->i); }
+static void set_fall_detection_switch(const schema_value_t *v, void *ctx) { update_fall_detection_switch(v->b); }
+static void set_height_accumulation_time(const schema_value_t *v, void *ctx) { update_height_accumulation_time((uint32_t)v->i); }
+static void set_non_presence_time(const schema_value_t *v, void *ctx) { update_non_presence_time((uint32_t)v->i); }
+
+// Live payload encoding: "json", "binary" or "both"
+static void set_live_format(const schema_value_t *v, void *ctx)
+{
+    char name[8];
+    memcpy(name, v->s, v->s_len);
+    name[v->s_len] = '\0';
+    uint8_t format = live_format_from_str(name);
+    if (format != 0) {
+        g_live_format = format;
+        settings_store_mark_dirty(SETTINGS_DIRTY_LIVE_FORMAT);
+        printf("Live format set to: %s\n", live_format_to_str(format));
+    } else {
+        printf("Unknown live_format: %s\n", name);
+    }
+}
+
+// Applied in this order. Ranges are the radar's where it defines one (the
+// update_* functions clamp to the same limits) and the field width otherwise.
+static const schema_field_t s_settings_schema[] = {
+    { "set_device_id",              SCHEMA_STRING, 1, 31,         set_device_id },
+    { "reboot",                     SCHEMA_BOOL,   0, 1,          set_reboot },
+    { "installation_angle_x",       SCHEMA_INT,    INT16_MIN, INT16_MAX, set_angle_x },
+    { "installation_angle_y",       SCHEMA_INT,    INT16_MIN, INT16_MAX, set_angle_y },
+    { "installation_angle_z",       SCHEMA_INT,    INT16_MIN, INT16_MAX, set_angle_z },
+    { "installation_height",        SCHEMA_INT,    0, UINT16_MAX, set_installation_height },
+    { "fall_detection_sensitivity", SCHEMA_INT,    0, 3,          set_fall_sensitivity },
+    { "fall_duration",              SCHEMA_INT,    5, 180,        set_fall_duration },
+    { "fall_breaking_height",       SCHEMA_INT,    0, 150,        set_fall_breaking_height },
+    { "sitting_still_distance",     SCHEMA_INT,    0, 300,        set_sitting_still_distance },
+    { "moving_distance",            SCHEMA_INT,    0, 300,        set_moving_distance },
+    { "stay_still_switch",          SCHEMA_BOOL,   0, 1,          set_stay_still_switch },
+    { "stay_still_duration",        SCHEMA_INT,    60, 3600,      set_stay_still_duration },
+    { "fall_detection_switch",      SCHEMA_BOOL,   0, 1,          set_fall_detection_switch },
+    { "height_accumulation_time",   SCHEMA_INT,    0, INT32_MAX,  set_height_accumulation_time },
+    { "non_presence_time",          SCHEMA_INT,    0, INT32_MAX,  set_non_presence_time },
+    { "live_format",                SCHEMA_STRING, 1, 7,          set_live_format },
+};
+
+// Settings update (JSON): apply only the fields present, in one pass
+static void apply_settings_update(const char *data, size_t data_len, bool fleet)
+{
+    printf("Received settings update: %.*s\n", (int)data_len, data);
+
+    radar_state_t st;
+    radar_state_snapshot(&st);
+    settings_update_t update = {
+        .fleet = fleet,
+        .angles = { st.installation_angle_x, st.installation_angle_y, st.installation_angle_z },
+    };
+    schema_result_t result;
+    esp_err_t err = json_schema_apply(s_settings_schema, sizeof(s_settings_schema) / sizeof(s_settings_schema[0]),
+                                      data, data_len, &update, &result);
+    if (err != ESP_OK) {
+        ESP_LOGE(MQTT_TAG, "Error parsing settings JSON");
+        return;
+    }
+    if (update.angles_set) {
+        update_installation_angles(update.angles[0], update.angles[1], update.angles[2]);
+    }
+    if (result.rejected || result.unknown) {
+        printf("Settings update: %u invalid, %u unknown field(s) ignored\n", result.rejected, result.unknown);
+    }
+    // Published once the radar has answered every write above (the settings
+    // store saves the confirmed values in the background)
+    request_settings_commit();
+}
+
+static void on_settings_update(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    apply_settings_update(data, data_len, false);
+}
+
+static void on_settings_state_request(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    printf("Received request for settings state on device-specific topic\n");
+    mqtt_publish_settings(true);
+}
+
+static void on_info_request(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    printf("Received request for product info on device-specific topic\n");
+    mqtt_publish_product_info();
+}
+
+// Trajectory track on demand; optional {"seconds": N, "epsilon": cm}
+typedef struct {
+    uint16_t seconds;
+    uint16_t epsilon;
+} track_request_t;
+
+static void set_track_seconds(const schema_value_t *v, void *ctx) { ((track_request_t *)ctx)->seconds = (uint16_t)v->i; }
+static void set_track_epsilon(const schema_value_t *v, void *ctx) { ((track_request_t *)ctx)->epsilon = (uint16_t)v->i; }
+
+static const schema_field_t s_track_request_schema[] = {
+    { "seconds", SCHEMA_INT, 1, UINT16_MAX, set_track_seconds },
+    { "epsilon", SCHEMA_INT, 0, UINT16_MAX, set_track_epsilon },
+};
+
+static void on_track_request(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    track_request_t req = { CONFIG_TRACK_WINDOW_S, CONFIG_TRACK_EPSILON_CM };
+    schema_result_t result;
+    // An empty or malformed payload means the defaults
+    json_schema_apply(s_track_request_schema, sizeof(s_track_request_schema) / sizeof(s_track_request_schema[0]),
+                      data, data_len, &req, &result);
+    mqtt_publish_track(TRACK_REASON_REQUEST, req.seconds, req.epsilon);
+}
+
+static bool publish_tasks(const char *json, size_t len)
+{
+    if (mqtt_client == NULL || !s_mqtt_connected) {
+        return false;
+    }
+    return mqtt_publish(mqtt_topic_tasks, json, (int)len, 0) >= 0;
+}
+
+static void on_tasks_request(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    static char json[CONFIG_TASK_PROFILE_JSON_MAX];     // only the inbox worker gets here
+    size_t len = task_profile_to_json(json, sizeof(json));
+    if (len > 0) {
+        publish_tasks(json, len);
+    }
+}
+
+static void publish_bench_result(const char *json, size_t len)
+{
+    if (mqtt_client != NULL && s_mqtt_connected) {
+        mqtt_publish(mqtt_topic_bench, json, (int)len, 1);
+    }
+}
+
+static void set_bench_seconds(const schema_value_t *v, void *ctx) { ((latency_bench_params_t *)ctx)->seconds = (uint16_t)v->i; }
+static void set_bench_load(const schema_value_t *v, void *ctx) { ((latency_bench_params_t *)ctx)->load_pct = (uint8_t)v->i; }
+static void set_bench_priority(const schema_value_t *v, void *ctx) { ((latency_bench_params_t *)ctx)->priority = (uint8_t)v->i; }
+
+// {"seconds": 30, "load_pct": 50, "priority": 10}; the load task stays below the Wi-Fi task (23)
+static const schema_field_t s_bench_schema[] = {
+    { "seconds",  SCHEMA_INT, 1, 600,                              set_bench_seconds },
+    { "load_pct", SCHEMA_INT, 0, LATENCY_BENCH_MAX_LOAD_PCT,       set_bench_load },
+    { "priority", SCHEMA_INT, 1, 22,                               set_bench_priority },
+};
+
+static void on_bench_request(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    // Defaults: half the CPU taken at the priority every task used to share
+    latency_bench_params_t params = { 30, 50, 10 };
+    schema_result_t result;
+    json_schema_apply(s_bench_schema, sizeof(s_bench_schema) / sizeof(s_bench_schema[0]),
+                      data, data_len, &params, &result);
+    latency_bench_start(&params, publish_bench_result);
+}
+
+// OTA job fields: {"url": "...", "sha256": "<64 hex>", "version": "...", "force": false, "delta": false}
+typedef struct {
+    ota_job_t job;
+    bool bad_sha256;        // present but not 64 hex digits
+} ota_job_request_t;
+static void set_ota_url(const schema_value_t *v, void *ctx)
+{
+    ota_job_t *job = &((ota_job_request_t *)ctx)->job;
+    memcpy(job->url, v->s, v->s_len);
+    job->url[v->s_len] = '\0';
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void set_ota_sha256(const schema_value_t *v, void *ctx)
+{
+    ota_job_request_t *req = ctx;
+    for (int i = 0; i < 32; i++) {
+        int hi = hex_digit(v->s[2 * i]);
+        int lo = hex_digit(v->s[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            req->bad_sha256 = true;
+            return;
+        }
+        req->job.sha256[i] = (uint8_t)(hi << 4 | lo);
+    }
+    req->job.has_sha256 = true;
+}
+
+static void set_ota_version(const schema_value_t *v, void *ctx)
+{
+    ota_job_t *job = &((ota_job_request_t *)ctx)->job;
+    memcpy(job->version, v->s, v->s_len);
+    job->version[v->s_len] = '\0';
+}
+
+static void set_ota_force(const schema_value_t *v, void *ctx) { ((ota_job_request_t *)ctx)->job.force = v->b; }
+static void set_ota_delta(const schema_value_t *v, void *ctx) { ((ota_job_request_t *)ctx)->job.delta = v->b; }
+
+static const schema_field_t s_ota_schema[] = {
+    { "url",     SCHEMA_STRING, 1, OTA_URL_MAX - 1,     set_ota_url },
+    { "sha256",  SCHEMA_STRING, 64, 64,                 set_ota_sha256 },
+    { "version", SCHEMA_STRING, 1, OTA_VERSION_MAX - 1, set_ota_version },
+    { "force",   SCHEMA_BOOL,   0, 1,                   set_ota_force },
+    { "delta",   SCHEMA_BOOL,   0, 1,                   set_ota_delta },
+};
+
+static void publish_ota_status(const ota_status_t *status);
+
+// A job that cannot be run as asked (e.g. its hash or version check would be
+// skipped) is refused rather than started without it
+static void refuse_ota_job(const char *detail)
+{
+    printf("[OTA] Job refused: %s\n", detail);
+    metrics_inc(METRIC_OTA_FAILURES);
+    ota_status_t status = { .state = OTA_STATE_FAILED, .err = ESP_ERR_INVALID_ARG, .detail = detail };
+    publish_ota_status(&status);
+}
+
+// เพิ่ม trigger OTA ผ่าน MQTT topic
+// Payload: a bare URL, or a JSON job (see s_ota_schema)
+static void on_ota_update(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    static ota_job_request_t req;
+    memset(&req, 0, sizeof(req));
+    ota_job_t *job = &req.job;
+
+    // ตัด \n, \r, space ข้างหน้าและข้างหลังออก
+    while (data_len > 0 && (*data == '\n' || *data == '\r' || *data == ' ')) {
+        data++;
+        data_len--;
+    }
+    while (data_len > 0 && (data[data_len - 1] == '\n' || data[data_len - 1] == '\r' || data[data_len - 1] == ' ')) {
+        data_len--;
+    }
 
-// Forward declaration for the get_live_json_payload_str function
-char* get_live_json_payload_str(void);
+    if (data_len > 0 && data[0] == '{') {
+        schema_result_t result;
+        if (json_schema_apply(s_ota_schema, sizeof(s_ota_schema) / sizeof(s_ota_schema[0]),
+                              data, data_len, &req, &result) != ESP_OK) {
+            refuse_ota_job("invalid job JSON");
+            return;
+        }
+        if (result.rejected != 0) {
+            refuse_ota_job("invalid job field");
+            return;
+        }
+        if (req.bad_sha256) {
+            refuse_ota_job("sha256 is not 64 hex digits");
+            return;
+        }
+    } else if (data_len < sizeof(job->url)) {
+        memcpy(job->url, data, data_len);
+        job->url[data_len] = '\0';
+    }
+    if (job->url[0] == '\0') {
+        refuse_ota_job("missing or too long URL");
+        return;
+    }
+
+    printf("[OTA] Trigger OTA update from MQTT: %s\n", job->url);
+    ota_update_start(job);
+}
+
+// Progress and result of OTA jobs on <device_id>/ota_status
+static void publish_ota_status(const ota_status_t *status)
+{
+    if (mqtt_client == NULL || !s_mqtt_connected) {
+        return;
+    }
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL) {
+        return;
+    }
+    cJSON_AddStringToObject(json, "device_id", g_device_id);
+    cJSON_AddStringToObject(json, "state", ota_state_to_str(status->state));
+    cJSON_AddNumberToObject(json, "bytes", status->bytes);
+    if (status->total) {
+        cJSON_AddNumberToObject(json, "total", status->total);
+        cJSON_AddNumberToObject(json, "progress", (double)status->bytes * 100 / status->total);
+    }
+    if (status->attempt) {
+        cJSON_AddNumberToObject(json, "attempt", status->attempt);
+    }
+    if (status->err != ESP_OK) {
+        cJSON_AddStringToObject(json, "error", esp_err_to_name(status->err));
+    }
+    if (status->detail) {
+        cJSON_AddStringToObject(json, "detail", status->detail);
+    }
+    char *json_str = cJSON_PrintUnformatted(json);
+    if (json_str) {
+        mqtt_publish(mqtt_topic_ota_status, json_str, 0, 1);
+        free(json_str);
+    }
+    cJSON_Delete(json);
+}
+
+// Log level: a bare level name ("debug"), or {"level": "debug", "tag": "wifi_manager"}.
+// Without a tag it sets the radar frame log; with one it is passed to esp_log_level_set().
+// Not persisted: a reboot restores CONFIG_RADAR_LOG_DEFAULT_LEVEL.
+typedef struct {
+    bool has_level;
+    esp_log_level_t level;
+    char tag[32];
+} log_level_request_t;
+
+static void set_log_level(const schema_value_t *v, void *ctx)
+{
+    log_level_request_t *req = ctx;
+    req->has_level = radar_log_level_from_str(v->s, v->s_len, &req->level);
+}
+
+static void set_log_tag(const schema_value_t *v, void *ctx)
+{
+    log_level_request_t *req = ctx;
+    memcpy(req->tag, v->s, v->s_len);
+    req->tag[v->s_len] = '\0';
+}
+
+static const schema_field_t s_log_level_schema[] = {
+    { "level", SCHEMA_STRING, 1, 7,  set_log_level },
+    { "tag",   SCHEMA_STRING, 1, 31, set_log_tag },
+};
+
+static void on_log_level(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    log_level_request_t req = { 0 };
+    while (data_len > 0 && (data[data_len - 1] == '\n' || data[data_len - 1] == '\r' || data[data_len - 1] == ' ')) {
+        data_len--;
+    }
+    if (data_len > 0 && data[0] == '{') {
+        schema_result_t result;
+        json_schema_apply(s_log_level_schema, sizeof(s_log_level_schema) / sizeof(s_log_level_schema[0]),
+                          data, data_len, &req, &result);
+    } else {
+        req.has_level = radar_log_level_from_str(data, data_len, &req.level);
+    }
+    if (!req.has_level) {
+        printf("Invalid log level: %.*s\n", (int)data_len, data);
+        return;
+    }
+    if (req.tag[0] != '\0') {
+        esp_log_level_set(req.tag, req.level);
+        printf("Log level for %s set to %s\n", req.tag, radar_log_level_to_str(req.level));
+    } else {
+        radar_log_set_level(req.level);
+        printf("Radar frame log level set to %s\n", radar_log_level_to_str(req.level));
+    }
+}
+
+// Fleet-wide command R60AFD1/all/<command>: run it as if it had been sent to
+// <device_id>/<command>. A fleet-wide settings update applies every field
+// except set_device_id.
+static void on_fleet_command(const char *topic, const char *data, size_t data_len, void *ctx)
+{
+    const char *command = topic + strlen(MQTT_TOPIC_FLEET_PREFIX);
+    char local[64];
+    snprintf(local, sizeof(local), "%s/%s", g_device_id, command);
+    printf("Fleet command: %s\n", command);
+    if (strcmp(local, mqtt_topic_settings_update) == 0) {
+        apply_settings_update(data, data_len, true);
+        return;
+    }
+    topic_router_dispatch(local, data, data_len);
+}
+
+// Inbox worker entry: log and route one complete message
+static void handle_mqtt_message(const char *topic, const char *data, size_t data_len)
+{
+    ESP_LOGI(MQTT_TAG, "MQTT Data received:");
+    ESP_LOGI(MQTT_TAG, "Topic: %s", topic);
+    ESP_LOGI(MQTT_TAG, "Data: %.*s", (int)data_len, data);
+    topic_router_dispatch(topic, data, data_len);
+}
+
+// Inbound commands; the MQTT client subscribes to every pattern in the router
+static void register_mqtt_routes(void)
+{
+    topic_router_add(mqtt_topic_settings_update, on_settings_update, NULL);
+    topic_router_add(mqtt_topic_settings_state_device_id, on_settings_state_request, NULL);
+    topic_router_add(mqtt_topic_info_device_id, on_info_request, NULL);
+    topic_router_add(mqtt_topic_ota_update, on_ota_update, NULL);
+    topic_router_add(mqtt_topic_track_request, on_track_request, NULL);
+    topic_router_add(mqtt_topic_log_level, on_log_level, NULL);
+    topic_router_add(mqtt_topic_tasks_request, on_tasks_request, NULL);
+    topic_router_add(mqtt_topic_bench_request, on_bench_request, NULL);
+    topic_router_add(MQTT_TOPIC_FLEET_PREFIX "+", on_fleet_command, NULL);
+}
 
 // MQTT event handler
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
@@ -226,201 +851,33 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(MQTT_TAG, "MQTT Connected to broker");
-            // Subscribe to settings topic when connected
-            int msg_id = esp_mqtt_client_subscribe(mqtt_client, mqtt_topic_settings_update, 0);
-            ESP_LOGI(MQTT_TAG, "Subscribed to %s, msg_id=%d", mqtt_topic_settings_update, msg_id);
-            msg_id = esp_mqtt_client_subscribe(mqtt_client, mqtt_topic_info_device_id, 0);
-            ESP_LOGI(MQTT_TAG, "Subscribed to %s, msg_id=%d", mqtt_topic_info_device_id, msg_id);
-            msg_id = esp_mqtt_client_subscribe(mqtt_client, mqtt_topic_settings_state_device_id, 0);
-            ESP_LOGI(MQTT_TAG, "Subscribed to %s, msg_id=%d", mqtt_topic_settings_state_device_id, msg_id);
-            // Subscribe to the OTA topic
-            msg_id = esp_mqtt_client_subscribe(mqtt_client, mqtt_topic_ota_update, 0);
-            ESP_LOGI(MQTT_TAG, "Subscribed to %s, msg_id=%d", mqtt_topic_ota_update, msg_id);
-            
+            // Subscribe to every routed command topic
+            topic_route_info_t routes[TOPIC_ROUTER_MAX_ROUTES];
+            size_t route_count = topic_router_get_routes(routes, TOPIC_ROUTER_MAX_ROUTES);
+            for (size_t i = 0; i < route_count; i++) {
+                int msg_id = esp_mqtt_client_subscribe(mqtt_client, routes[i].pattern, 0);
+                ESP_LOGI(MQTT_TAG, "Subscribed to %s, msg_id=%d", routes[i].pattern, msg_id);
+            }
+
+            // Replay whatever was journaled while offline
+            s_mqtt_connected = true;
+            live_journal_set_online(true);
+            // Reaching the broker confirms a freshly updated image
+            ota_update_mark_healthy();
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(MQTT_TAG, "MQTT Disconnected from broker");
+            s_mqtt_connected = false;
+            metrics_inc(METRIC_MQTT_DISCONNECTS);
+            live_journal_set_online(false);
             break;
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(MQTT_TAG, "MQTT Message published successfully, msg_id=%d", event->msg_id);
+            live_journal_on_published(event->msg_id);
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(MQTT_TAG, "MQTT Data received:");
-            ESP_LOGI(MQTT_TAG, "Topic: %.*s", event->topic_len, event->topic);
-            ESP_LOGI(MQTT_TAG, "Data: %.*s", event->data_len, event->data);
-            
-            // If the message is on the settings topic, parse and update settings.
-            if (event->topic_len == strlen(mqtt_topic_settings_update) &&
-                strncmp(event->topic, mqtt_topic_settings_update, event->topic_len) == 0) {
-                
-                printf("Received settings update: %.*s\n", event->data_len, event->data);
-                cJSON *json = cJSON_Parse(event->data);
-                if(json == NULL) {
-                    ESP_LOGE(MQTT_TAG, "Error parsing settings JSON");
-                } else {
-                    cJSON *item = NULL;
-                    
-                    // Add ability to set a new device ID
-                    item = cJSON_GetObjectItem(json, "set_device_id");
-                    if(item && cJSON_IsString(item) && (item->valuestring != NULL)) {
-                        printf("Received new device ID: %s\n", item->valuestring);
-                        strncpy(g_device_id, item->valuestring, sizeof(g_device_id) - 1);
-                        g_device_id[sizeof(g_device_id) - 1] = '\0'; // Ensure null termination
-                        save_device_id_to_nvs();
-                        printf("New device ID saved. Rebooting in 3 seconds...\n");
-                        cJSON_Delete(json);
-                        vTaskDelay(pdMS_TO_TICKS(3000));
-                        esp_restart();
-                        return;
-                    }
-                    
-                    // Check for reboot command first
-                    item = cJSON_GetObjectItem(json, "reboot");
-                    if(item && cJSON_IsBool(item) && item->valueint) {
-                        printf("Reboot command received\n");
-                        cJSON_Delete(json);
-                        reboot_device();
-                        return;
-                    }
-                    
-                    // Remove the first duplicate non-presence time update here
-                    // item = cJSON_GetObjectItem(json, "non_presence_time");
-                    // if(item && cJSON_IsNumber(item)) {
-                    //     g_non_presence_time = (uint32_t)item->valueint;
-                    //     printf("Updated non-presence time to: %" PRIu32 " seconds\n", g_non_presence_time);
-                    // }
-                    
-                    // Update installation angles
-                    int16_t angle_x = 0, angle_y = 0, angle_z = 0;
-                    item = cJSON_GetObjectItem(json, "installation_angle_x");
-                    if(item && cJSON_IsNumber(item)) {
-                        angle_x = item->valueint;
-                    }
-                    item = cJSON_GetObjectItem(json, "installation_angle_y");
-                    if(item && cJSON_IsNumber(item)) {
-                        angle_y = item->valueint;
-                    }
-                    item = cJSON_GetObjectItem(json, "installation_angle_z");
-                    if(item && cJSON_IsNumber(item)) {
-                        angle_z = item->valueint;
-                    }
-                    update_installation_angles(angle_x, angle_y, angle_z);
-                    
-                    // Update installation height
-                    printf("Checking installation height update\n");
-                    item = cJSON_GetObjectItem(json, "installation_height");
-                    if(item && cJSON_IsNumber(item)) {
-                        uint16_t new_height = (uint16_t)item->valueint;
-                        printf("Updating installation height to: %d cm\n", new_height);
-                        update_installation_height(new_height);
-                    } else {
-                        printf("Installation height update skipped: invalid or missing value\n");
-                    }
-                    
-                    // Update fall detection sensitivity
-                    item = cJSON_GetObjectItem(json, "fall_detection_sensitivity");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_fall_detection_sensitivity((uint8_t)item->valueint);
-                    }
-                    
-                    // Update fall duration
-                    item = cJSON_GetObjectItem(json, "fall_duration");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_fall_duration((uint32_t)item->valueint);
-                    }
-                    
-                    // Update fall breaking height
-                    item = cJSON_GetObjectItem(json, "fall_breaking_height");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_fall_breaking_height((uint16_t)item->valueint);
-                    }
-                    
-                    // Update sitting-still horizontal distance
-                    item = cJSON_GetObjectItem(json, "sitting_still_distance");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_sitting_still_distance((uint16_t)item->valueint);
-                    }
-                    
-                    // Update moving horizontal distance
-                    item = cJSON_GetObjectItem(json, "moving_distance");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_moving_distance((uint16_t)item->valueint);
-                    }
-                    
-                    // Update stay-still alarm switch
-                    item = cJSON_GetObjectItem(json, "stay_still_switch");
-                    if(item && cJSON_IsBool(item)) {
-                        update_stay_still_switch(item->valueint ? true : false);
-                    }
-                    
-                    // Update stay-still duration
-                    item = cJSON_GetObjectItem(json, "stay_still_duration");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_stay_still_duration((uint32_t)item->valueint);
-                    }
-                    
-                    // Add fall detection switch update
-                    item = cJSON_GetObjectItem(json, "fall_detection_switch");
-                    if(item && cJSON_IsBool(item)) {
-                        update_fall_detection_switch(item->valueint ? true : false);
-                    }
-                    // height accumulation time
-                    item = cJSON_GetObjectItem(json, "height_accumulation_time");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_height_accumulation_time((uint32_t)item->valueint);
-                    }
-                    // non-presence time (keep this one, which is already further down in the function)
-                    item = cJSON_GetObjectItem(json, "non_presence_time");
-                    if(item && cJSON_IsNumber(item)) {
-                        update_non_presence_time((uint32_t)item->valueint);
-                    }
-                    cJSON_Delete(json);
-                    save_settings_to_nvs();
-                    mqtt_publish_settings();
-                }
-            }
-            // Check if the topic is MQTT_TOPIC_SETTINGS_STATE_DEVICE_ID
-            else if (event->topic_len == strlen(mqtt_topic_settings_state_device_id) &&
-                     strncmp(event->topic, mqtt_topic_settings_state_device_id, event->topic_len) == 0) {
-                
-                printf("Received request for settings state on device-specific topic\n");
-                mqtt_publish_settings();
-            }
-            // Check if the topic is MQTT_TOPIC_INFO_DEVICE_ID
-            else if (event->topic_len == strlen(mqtt_topic_info_device_id) &&
-                     strncmp(event->topic, mqtt_topic_info_device_id, event->topic_len) == 0) {
-                
-                printf("Received request for product info on device-specific topic\n");
-                mqtt_publish_product_info();
-            }
-            // เพิ่ม trigger OTA ผ่าน MQTT topic
-            else if (event->topic_len == strlen(mqtt_topic_ota_update) &&
-                     strncmp(event->topic, mqtt_topic_ota_update, event->topic_len) == 0) {
-                // รับ URL OTA จาก payload
-                char url[128] = {0};
-                int len = event->data_len < 127 ? event->data_len : 127;
-                strncpy(url, event->data, len);
-                url[len] = '\0';
-
-                // --- เพิ่มโค้ดนี้เพื่อตัด \n, \r, space ข้างหน้าและข้างหลังออก ---
-                char *start = url;
-                while (*start == '\n' || *start == '\r' || *start == ' ') start++;
-                char *end = start + strlen(start) - 1;
-                while (end > start && (*end == '\n' || *end == '\r' || *end == ' ')) {
-                    *end = '\0';
-                    end--;
-                }
-                memmove(url, start, strlen(start) + 1); // ขยับ string ไปต้น buffer
-                // -------------------------------------------------------------
-
-                printf("[OTA] Trigger OTA update from MQTT: %s\n", url);
-                printf("OTA URL raw: [%s]\n", url);
-                for (int i = 0; i < strlen(url); i++) {
-                    printf("%02X ", (unsigned char)url[i]);
-                }
-                printf("\n");
-                ota_update_start(url);
-            }
+            // Copy only; handle_mqtt_message() runs on the inbox worker
+            mqtt_inbox_post(event);
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGI(MQTT_TAG, "MQTT Error occurred");
@@ -451,205 +908,332 @@ void mqtt_init(void)
         },
     };
     
+    // Incoming messages are routed off the MQTT task
+    register_mqtt_routes();
+    mqtt_inbox_init(handle_mqtt_message);
+
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     esp_mqtt_client_start(mqtt_client);
 }
 
-// Publish live data to MQTT
+// Sequence number shared by binary live frames and journal records
+static uint16_t s_live_seq = 0;
+
+// Gather the live fields of one state snapshot for the binary encoder
+static void get_live_sample(live_sample_t *sample)
+{
+    radar_state_t st;
+    radar_state_snapshot(&st);
+    sample->presence = st.presence;
+    sample->fall_alarm = st.fall_alarm;
+    sample->stay_still_alarm = st.stay_still_alarm;
+    sample->movement_state = st.movement_state;
+    sample->body_movement_param = st.body_movement_param;
+    sample->heartbeat = st.heartbeat;
+    sample->traj_x = st.traj_x;
+    sample->traj_y = st.traj_y;
+    sample->total_height_count = st.total_height_count;
+    sample->height_prop[0] = st.height_prop_0_0_5;
+    sample->height_prop[1] = st.height_prop_0_5_1;
+    sample->height_prop[2] = st.height_prop_1_1_5;
+    sample->height_prop[3] = st.height_prop_1_5_2;
+    sample->non_presence_time = st.non_presence_time;
+}
+
+// Publish live data as compact binary from a static buffer (no heap use)
+static void mqtt_publish_live_binary(void)
+{
+    static uint8_t buf[LIVE_BINARY_MAX_LEN];
+
+    live_sample_t sample;
+    get_live_sample(&sample);
+    size_t len = live_binary_encode(buf, &sample, s_live_seq++, g_device_id);
+
+    int msg_id = mqtt_publish(mqtt_topic_live_bin, (const char *)buf, len, 1);
+    if (msg_id != -1) {
+        printf("Published live data (%u bytes) to %s\n", (unsigned)len, mqtt_topic_live_bin);
+    } else {
+        printf("Failed to publish binary live data\n");
+    }
+}
+
+// Write the live JSON payload into buf. Returns its length, or 0 if it does not fit.
+static size_t build_live_json(char *buf, size_t len)
+{
+    radar_state_t st;
+    radar_state_snapshot(&st);
+    return payload_live_json(buf, len, g_device_id, &st);
+}
+
+// Publish live data to MQTT in the formats selected by g_live_format
 void mqtt_publish_live_data(void)
 {
-    time_t now;
-    time(&now);
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-    // printf("[DEBUG] mqtt_publish_live_data() called at %04d-%02d-%02d %02d:%02d:%02d\n",
-    //        timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-    //        timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    char *json_str = get_live_json_payload_str();
-    if (json_str) {
-        int msg_id = esp_mqtt_client_publish(mqtt_client, mqtt_topic_live, json_str, 0, 1, 0);
+    uint8_t format = g_live_format;
+
+    if (format & LIVE_FORMAT_BINARY) {
+        mqtt_publish_live_binary();
+    }
+    if (!(format & LIVE_FORMAT_JSON)) {
+        return;
+    }
+
+    char json[LIVE_JSON_MAX];
+    size_t len = build_live_json(json, sizeof(json));
+    if (len > 0) {
+        int msg_id = mqtt_publish(mqtt_topic_live, json, len, 1);
         if (msg_id != -1) {
             printf("Published live data to %s\n", mqtt_topic_live);
         } else {
             printf("Failed to publish live data\n");
         }
-        free(json_str);
     }
 }
 
-// Get live JSON payload as a string (caller must free)
-char* get_live_json_payload_str(void)
+void print_live_json_payload(void)
 {
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        printf("Error creating live JSON object\n");
-        return NULL;
+    char json[LIVE_JSON_MAX];
+    if (build_live_json(json, sizeof(json)) > 0) {
+        printf("Live JSON Payload: %s\n", json);
     }
-
-    // Add device identification
-    cJSON_AddStringToObject(json, "device_id", g_device_id);
-    cJSON_AddStringToObject(json, "device_type", DEVICE_TYPE);
-
-    cJSON_AddBoolToObject(json, "presence", g_presence);
-    cJSON_AddBoolToObject(json, "fall_alarm", g_fall_alarm);
-    cJSON_AddBoolToObject(json, "stay_still_alarm", g_stay_still_alarm);
-    cJSON_AddNumberToObject(json, "movement_state", g_movement_state);
-    cJSON_AddNumberToObject(json, "body_movement_param", g_body_movement_param);
-    cJSON_AddNumberToObject(json, "heartbeat", g_heartbeat);
-    cJSON_AddNumberToObject(json, "trajectory_x", g_traj_x);
-    cJSON_AddNumberToObject(json, "trajectory_y", g_traj_y);
-    cJSON_AddNumberToObject(json, "total_height_count", g_total_height_count);
-    cJSON_AddNumberToObject(json, "height_prop_0_0_5", g_height_prop_0_0_5);
-    cJSON_AddNumberToObject(json, "height_prop_0_5_1", g_height_prop_0_5_1);
-    cJSON_AddNumberToObject(json, "height_prop_1_1_5", g_height_prop_1_1_5);
-    cJSON_AddNumberToObject(json, "height_prop_1_5_2", g_height_prop_1_5_2);
-    cJSON_AddNumberToObject(json, "non_presence_time", g_non_presence_time);
-
-    char *json_str = cJSON_Print(json);
-    cJSON_Delete(json);
-    return json_str;
 }
 
-// Modified print_live_json_payload to use the get_live_json_payload_str function
-void print_live_json_payload(void)
+#ifndef CONFIG_LIVE_JOURNAL_SAMPLE_S
+#define CONFIG_LIVE_JOURNAL_SAMPLE_S 60
+#endif
+
+// Broker unreachable: journal every alarm change and at most one other
+// snapshot per CONFIG_LIVE_JOURNAL_SAMPLE_S so they can be replayed later
+static void journal_live_snapshot(uint32_t changed_fields)
 {
-    char *json_str = get_live_json_payload_str();
-    if(json_str) {
-        printf("Live JSON Payload: %s\n", json_str);
-        free(json_str);
+    static TickType_t last_sample;
+    static bool sampled = false;
+
+    bool alarm = (changed_fields & LIVE_FIELDS_CRITICAL) != 0;
+    TickType_t now = xTaskGetTickCount();
+    if (!alarm && sampled && now - last_sample < pdMS_TO_TICKS(CONFIG_LIVE_JOURNAL_SAMPLE_S * 1000)) {
+        return;
+    }
+    last_sample = now;
+    sampled = true;
+
+    uint8_t buf[LIVE_BINARY_MAX_LEN];
+    live_sample_t sample;
+    get_live_sample(&sample);
+    size_t len = live_binary_encode(buf, &sample, s_live_seq++, "");
+    esp_err_t err = live_journal_append(alarm ? LIVE_JOURNAL_ALARM : LIVE_JOURNAL_SNAPSHOT, buf, len);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        printf("Failed to journal live data: %s\n", esp_err_to_name(err));
     }
 }
 
-// Task to publish MQTT messages periodically
-void mqtt_publish_task(void *arg)
+// Called by the live publisher on critical changes, after the coalescing
+// window for noisy changes, and as a periodic keepalive snapshot
+static void publish_live_snapshot(uint32_t changed_fields)
 {
-    while(1) {
-        if (mqtt_client != NULL) {
-            mqtt_publish_live_data();
+    if (mqtt_client != NULL && s_mqtt_connected) {
+        mqtt_publish_live_data();
+        if (changed_fields & LIVE_FIELD_FALL_ALARM) {
+            radar_state_t st;
+            radar_state_snapshot(&st);
+            if (st.fall_alarm) {
+                // Attach the path that led up to the fall
+                mqtt_publish_track(TRACK_REASON_FALL, CONFIG_TRACK_WINDOW_S, CONFIG_TRACK_EPSILON_CM);
+            }
         }
-        vTaskDelay(pdMS_TO_TICKS(60000)); // Publish every 60 seconds (1 นาที)
+    } else {
+        journal_live_snapshot(changed_fields);
     }
 }
 
-// Get settings JSON payload as a string (caller must free)
-char* get_settings_json_payload_str(void)
+// Publish one batch of journaled records (QoS 1, acknowledged via MQTT_EVENT_PUBLISHED)
+static int publish_journal_batch(const uint8_t *batch, size_t len)
 {
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        printf("Error creating settings JSON object\n");
-        return NULL;
+    return mqtt_publish(mqtt_topic_journal, (const char *)batch, len, 1);
+}
+
+#ifndef CONFIG_SETTINGS_DELTA
+#define CONFIG_SETTINGS_DELTA 1
+#endif
+
+// Settings as last published on settings_state, the base of the next delta.
+// version counts the publishes that changed something; boot is random per
+// boot, so the backend can tell a restart from a missed message.
+typedef struct {
+    bool synced;            // false: the next publish is a full snapshot
+    uint32_t boot;
+    uint32_t version;
+    radar_state_t st;
+    uint8_t live_format;
+    char device_id[sizeof(g_device_id)];
+} settings_published_t;
+
+static settings_published_t s_settings_pub;
+
+// Write the settings payload for version. base NULL: every setting (full
+// snapshot); otherwise only the settings that differ from base (delta).
+static size_t build_settings_json(char *buf, size_t len, const radar_state_t *st, uint8_t live_format,
+                                  uint32_t version, const settings_published_t *base)
+{
+    payload_settings_base_t from;
+    if (base != NULL) {
+        from = (payload_settings_base_t){ base->version, &base->st, base->live_format };
     }
-    
-    // Add device identification
-    cJSON_AddStringToObject(json, "device_id", g_device_id);
-    cJSON_AddStringToObject(json, "device_type", DEVICE_TYPE);
-    
-    cJSON_AddNumberToObject(json, "working_status", g_working_status);
-    cJSON_AddNumberToObject(json, "scenario", g_scenario);
-    cJSON_AddNumberToObject(json, "installation_angle_x", g_installation_angle_x);
-    cJSON_AddNumberToObject(json, "installation_angle_y", g_installation_angle_y);
-    cJSON_AddNumberToObject(json, "installation_angle_z", g_installation_angle_z);
-    cJSON_AddNumberToObject(json, "installation_height", g_installation_height);
-    
-    // Add fall detection parameters
-    cJSON_AddNumberToObject(json, "fall_detection_sensitivity", g_fall_detection_sensitivity);
-    cJSON_AddNumberToObject(json, "fall_duration", g_fall_duration);
-    cJSON_AddNumberToObject(json, "fall_breaking_height", g_fall_breaking_height);
-    
-    // Distance Settings
-    cJSON_AddNumberToObject(json, "sitting_still_distance", g_sitting_still_distance);
-    cJSON_AddNumberToObject(json, "moving_distance", g_moving_distance);
-    
-    // Add stay-still parameters
-    cJSON_AddBoolToObject(json, "stay_still_switch", g_stay_still_switch);
-    cJSON_AddNumberToObject(json, "stay_still_duration", g_stay_still_duration);
-    cJSON_AddNumberToObject(json, "height_accumulation_time", g_height_accumulation_time);
-    cJSON_AddBoolToObject(json, "fall_detection_switch", g_fall_detection_switch);
-    cJSON_AddNumberToObject(json, "non_presence_time", g_non_presence_time);
-    
-    char *json_str = cJSON_Print(json);
-    cJSON_Delete(json);
-    return json_str;
+    return payload_settings_json(buf, len, g_device_id, s_settings_pub.boot, version, st, live_format,
+                                 base != NULL ? &from : NULL);
 }
 
-// Function to publish settings to MQTT
-void mqtt_publish_settings(void)
+// Serialized full snapshot, rebuilt only when the settings (radar_state.h
+// section version), the live format, the device ID or the published version
+// changed, so a repeated settings_state request costs a copy instead of a rebuild
+typedef struct {
+    bool valid;
+    uint32_t state_version;
+    uint32_t version;
+    uint8_t live_format;
+    char device_id[sizeof(g_device_id)];
+    size_t len;
+    char json[SETTINGS_JSON_MAX];
+} settings_json_cache_t;
+
+static settings_json_cache_t s_settings_json;
+static SemaphoreHandle_t s_settings_json_lock;  // guards s_settings_json and s_settings_pub
+
+// Copy the full snapshot into buf. Returns its length, or 0 if it does not
+// fit. Call with s_settings_json_lock held.
+static size_t get_settings_json(char *buf, size_t len, const radar_state_t *st,
+                                const radar_state_versions_t *versions, uint8_t live_format, uint32_t version)
 {
-    char *json_str = get_settings_json_payload_str();
-    if (json_str) {
-        int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_SETTINGS_STATE, json_str, 0, 1, 0);
-        if (msg_id != -1) {
-            printf("Published settings to %s\n", MQTT_TOPIC_SETTINGS_STATE);
-        } else {
-            printf("Failed to publish settings\n");
-        }
-        free(json_str);
+    settings_json_cache_t *c = &s_settings_json;
+    if (!c->valid || c->state_version != versions->settings || c->version != version ||
+        c->live_format != live_format || memcmp(c->device_id, g_device_id, sizeof(c->device_id)) != 0) {
+        c->len = build_settings_json(c->json, sizeof(c->json), st, live_format, version, NULL);
+        c->valid = c->len > 0;
+        c->state_version = versions->settings;
+        c->version = version;
+        c->live_format = live_format;
+        memcpy(c->device_id, g_device_id, sizeof(c->device_id));
+    }
+    if (!c->valid || c->len >= len) {
+        return 0;
+    }
+    memcpy(buf, c->json, c->len + 1);
+    return c->len;
+}
+
+// Function to publish settings to MQTT. With CONFIG_SETTINGS_DELTA only the
+// settings changed since the last publish are sent, unless full is set or the
+// last publish failed; a delta with nothing in it is not sent. Publishing happens under the lock so versions go out in order.
+void mqtt_publish_settings(bool full)
+{
+    static char json[SETTINGS_JSON_MAX];    // guarded by s_settings_json_lock
+    radar_state_t st;
+    radar_state_versions_t versions;
+    radar_state_snapshot_versions(&st, &versions);
+    uint8_t live_format = g_live_format;
+
+    xSemaphoreTake(s_settings_json_lock, portMAX_DELAY);
+    settings_published_t *p = &s_settings_pub;
+    bool same_device = memcmp(p->device_id, g_device_id, sizeof(p->device_id)) == 0;
+    bool changed = p->version == 0 || !same_device || live_format != p->live_format || payload_settings_differ(&st, &p->st);
+    uint32_t version = p->version + changed;
+    bool delta = CONFIG_SETTINGS_DELTA && !full && p->synced && same_device;
+    if (delta && !changed) {
+        // The backend already has this version; an empty delta tells it nothing
+        xSemaphoreGive(s_settings_json_lock);
+        return;
+    }
+
+    size_t len;
+    if (delta) {
+        len = build_settings_json(json, sizeof(json), &st, live_format, version, p);
+    } else {
+        len = get_settings_json(json, sizeof(json), &st, &versions, live_format, version);
+    }
+    int msg_id = len > 0 ? mqtt_publish(MQTT_TOPIC_SETTINGS_STATE, json, len, 1) : -1;
+
+    // After a lost message only a full snapshot brings the backend up to date
+    p->synced = msg_id != -1;
+    p->version = version;
+    p->st = st;
+    p->live_format = live_format;
+    memcpy(p->device_id, g_device_id, sizeof(p->device_id));
+    xSemaphoreGive(s_settings_json_lock);
+
+    if (msg_id != -1) {
+        printf("Published settings %s v%" PRIu32 " to %s\n", delta ? "delta" : "snapshot", version,
+               MQTT_TOPIC_SETTINGS_STATE);
+    } else {
+        printf("Failed to publish settings\n");
     }
 }
 
-// Modified print_settings_json_payload to use the get_settings_json_payload_str function
 void print_settings_json_payload(void)
 {
-    char *json_str = get_settings_json_payload_str();
-    if(json_str) {
+    char json[SETTINGS_JSON_MAX];
+    radar_state_t st;
+    radar_state_versions_t versions;
+    radar_state_snapshot_versions(&st, &versions);
+
+    xSemaphoreTake(s_settings_json_lock, portMAX_DELAY);
+    size_t len = get_settings_json(json, sizeof(json), &st, &versions, g_live_format, s_settings_pub.version);
+    xSemaphoreGive(s_settings_json_lock);
+    if (len > 0) {
         printf("******************************************************** \n");
-        printf("Settings JSON Payload: %s\n", json_str);
-        free(json_str);
+        printf("Settings JSON Payload: %s\n", json);
         printf("********************************************************\n");
     }
 }
 
+// Product information; the MQTT payload (full) adds the operating time and
+// Wi-Fi connection statistics
+static size_t build_product_info_json(char *buf, size_t len, bool full)
+{
+    radar_state_t st;
+    radar_state_snapshot(&st);
+    if (!full) {
+        return payload_product_info_json(buf, len, g_device_id, &st, NULL);
+    }
+
+    wm_connect_stats_t stats;
+    wifiManager_get_connect_stats(&stats);
+    payload_wifi_t wifi = {
+        .boot_ms = stats.boot_ms,
+        .connect_ms = stats.connect_ms,
+        .fast = stats.fast,
+        .static_ip = stats.static_ip,
+        .reconnects = stats.reconnects,
+        .fallbacks = stats.fallbacks,
+    };
+    return payload_product_info_json(buf, len, g_device_id, &st, &wifi);
+}
+
 // Product Information JSON payload
 void print_product_info_payload(void)
 {
-    cJSON *json = cJSON_CreateObject();
-    if(json == NULL) {
-        printf("Error creating product info JSON object\n");
-        return;
-    }
-    
-    // Add device identification
-    cJSON_AddStringToObject(json, "device_id", g_device_id);
-    cJSON_AddStringToObject(json, "device_type", DEVICE_TYPE);
-    
-    cJSON_AddStringToObject(json, "product_model", g_product_model);
-    cJSON_AddStringToObject(json, "product_id", g_product_id);
-    cJSON_AddStringToObject(json, "hardware_model", g_hardware_model);
-    cJSON_AddStringToObject(json, "firmware_version", g_firmware_version);
-
-    char *json_str = cJSON_Print(json);
-    if(json_str) {
+    char json[PRODUCT_INFO_JSON_MAX];
+    if (build_product_info_json(json, sizeof(json), false) > 0) {
         printf("========================================================\n");
-        printf("Product Information JSON Payload: %s\n", json_str);
+        printf("Product Information JSON Payload: %s\n", json);
         printf("========================================================\n");
-        free(json_str);
     }
-    cJSON_Delete(json);
 }
 
 // Usage/Operating Time JSON payload: usage or operating time of the device.
 void print_usage_json_payload(void)
 {
-    cJSON *json = cJSON_CreateObject();
-    if(json == NULL) {
-        printf("Error creating usage JSON object\n");
-        return;
-    }
-    
-    // Add device identification
-    cJSON_AddStringToObject(json, "device_id", g_device_id);
-    cJSON_AddStringToObject(json, "device_type", DEVICE_TYPE);
-    
-    cJSON_AddNumberToObject(json, "operating_time", g_operating_time);
-    char *json_str = cJSON_Print(json);
-    if(json_str) {
-        printf("Usage/Operating Time JSON Payload: %s\n", json_str);
-        free(json_str);
+    radar_state_t st;
+    radar_state_snapshot(&st);
+
+    char json[USAGE_JSON_MAX];
+    if (payload_usage_json(json, sizeof(json), g_device_id, &st) > 0) {
+        printf("Usage/Operating Time JSON Payload: %s\n", json);
     }
-    cJSON_Delete(json);
 }
 
+// UART driver event queue (RX data, FIFO overflow, ...)
+static QueueHandle_t s_uart_event_queue = NULL;
+
 // Initialize UART (update GPIO numbers as needed)
 void init_uart(void)
 {
@@ -663,401 +1247,255 @@ void init_uart(void)
     uart_param_config(UART_PORT_NUM, &uart_config);
     // Set TX and RX pins (adjust these GPIO numbers for your hardware)
     uart_set_pin(UART_PORT_NUM, 17, 16, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, 0, 0, NULL, 0);
+    // Install with an event queue so uart_read_task wakes on RX activity instead of polling
+    uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, 0, UART_EVENT_QUEUE_LEN, &s_uart_event_queue, 0);
+    uart_set_rx_timeout(UART_PORT_NUM, UART_RX_TIMEOUT_SYMBOLS);
+    uart_set_rx_full_threshold(UART_PORT_NUM, UART_RX_FULL_THRESHOLD);
 }
 
-// This task continuously reads UART data and parses incoming frames
-void uart_read_task(void *arg)
+// Streaming decoder for the radar link. It keeps partial frames between
+// uart_read_bytes() calls, so a frame split across two reads is not lost.
+static radar_decoder_t s_radar_decoder;
+// When the bytes being decoded were read (esp_timer_get_time(), truncated); start of the alarm pipeline
+static uint32_t s_frame_rx_us;
+
+// Copy a decoded report into the global state and tell the live publisher what changed
+static void apply_radar_report(const radar_report_t *r)
 {
-    uint8_t data[BUF_SIZE];
-    uint32_t last_height_prop_request = 0; // Time (in ms) when we last requested height proportion data
+    radar_state_t *st = radar_state_edit();
+    uint32_t changed = 0;
 
-    while(1) {
-        int len = uart_read_bytes(UART_PORT_NUM, data, BUF_SIZE, pdMS_TO_TICKS(100));
-        if(len > 0) {
-            int i = 0;
-            while(i < len) {
-                // Look for the frame header
-                if(data[i] == FRAME_HEADER0 && (i + 1) < len && data[i+1] == FRAME_HEADER1) {
-                    // Ensure at least 6 bytes are available (header + control + command + length)
-                    if(i + 6 > len) {
-                        break;  // Incomplete header; wait for more data
-                    }
-                    uint8_t control = data[i+2];
-                    uint8_t command = data[i+3];
-                    // Length is 2 bytes (big-endian)
-                    uint16_t payload_len = ((uint16_t)data[i+4] << 8) | data[i+5];
-                    // Total frame length = header(2) + control(1) + command(1) + length(2) + payload + check(1) + tail(2)
-                    int frame_total_length = payload_len + 9;
-                    if(i + frame_total_length > len) {
-                        break;  // Incomplete frame; wait for more data
-                    }
-                    // Verify tail bytes
-                    if(data[i + frame_total_length - 2] != FRAME_TAIL0 ||
-                       data[i + frame_total_length - 1] != FRAME_TAIL1) {
-                        // Invalid tail, skip one byte and continue searching
-                        i++;
-                        continue;
-                    }
-                    
-                    // Print raw frame data for debugging
-                    printf("Raw frame: ");
-                    for (int k = i; k < i + frame_total_length; k++) {
-                        printf("%02X ", data[k]);
-                    }
-                    printf("\n");
-                    
-                    // Calculate check digit: sum of header, control, command, length, and payload bytes
-                    uint32_t sum = 0;
-                    for (int j = 0; j < 6 + payload_len; j++) {
-                        sum += data[i + j];
-                    }
-                    uint8_t calc_check = sum & 0xFF;
-                    // The check digit is immediately after the payload
-                    uint8_t recv_check = data[i + 6 + payload_len];
-                    if(calc_check != recv_check) {
-                        printf("Checksum mismatch: calc 0x%02X, recv 0x%02X\n", calc_check, recv_check);
-                        i += frame_total_length;
-                        continue;
-                    }
-                    
-                    // Process the frame based on control and command values
-                    if(control == 0x80 && command == 0x01 && payload_len == 1) {
-                        // Human presence report
-                        g_presence = (data[i+6] == 0x01);
-                        printf("Parsed Presence: %d\n", g_presence);
-                    }
-                    else if(control == 0x05 && command == 0x01 && payload_len == 1) {
-                        // Working status report
-                        g_working_status = data[i + 6];
-                        printf("Parsed Working Status: 0x%02X\n", g_working_status);
-                    }
-                    else if(control == 0x05 && command == 0x81 && payload_len == 1) {
-                        // Working status query acknowledgement
-                        uint8_t ack = data[i + 6];
-                        g_working_status = ack;  // Optionally update the global variable if it carries working status info
-                        printf("Parsed Working Status Query Ack: 0x%02X\n", ack);
-                    }
-                    else if(control == 0x80 && command == 0x02 && payload_len == 1) {
-                        // Movement information report
-                        uint8_t movement_value = data[i + 6];
-                        g_movement_state = movement_value; // 0: No movement, 1: Static, 2: Active
-                        printf("Parsed Movement State: %d\n", g_movement_state);
-                    }
-                    else if(control == 0x80 && command == 0x03 && payload_len == 1) {
-                        // Body movement parameter report
-                        uint8_t body_movement_value = data[i + 6];
-                        g_body_movement_param = body_movement_value;
-                        printf("Parsed Body Movement Param: %d\n", g_body_movement_param);
-                    }
-                    else if(control == 0x83 && command == 0x01 && payload_len == 1) {
-                        uint8_t fall_value = data[i + 6];
-                        g_fall_alarm = (fall_value == 0x01);
-                        printf("Parsed Fall Alarm: %d\n", g_fall_alarm);
-                    }
-                    else if(control == 0x83 && command == 0x05 && payload_len == 1) {
-                        uint8_t still_value = data[i + 6];
-                        g_stay_still_alarm = (still_value == 0x01);
-                        printf("Parsed Stay-still Alarm: %d\n", g_stay_still_alarm);
-                    }
-                    else if(control == 0x80 && command == 0x04 && payload_len == 1) {
-                        // Heartbeat report
-                        uint8_t heartbeat_value = data[i + 6];
-                        g_heartbeat = heartbeat_value;
-                        printf("Parsed Heartbeat: %d\n", g_heartbeat);
-                    }
-                    else if(control == 0x01 && command == 0x01 && payload_len == 1) {
-                        // Heartbeat packet: payload contains the heartbeat value.
-                        g_heartbeat = data[i+6];
-                        printf("Parsed Heartbeat: %d\n", g_heartbeat);
-                    }
-                    else if(control == 0x80 && command == 0x10 && payload_len == 4) {
-                        // Trajectory point report (4 bytes: 2 for X, 2 for Y)
-                        // Extract X coordinate (first 2 bytes, little-endian)
-                        g_traj_x = (int16_t)((data[i + 7] << 8) | data[i + 6]);
-                        // Extract Y coordinate (next 2 bytes, little-endian)
-                        g_traj_y = (int16_t)((data[i + 9] << 8) | data[i + 8]);
-                        printf("Parsed Trajectory: X=%d, Y=%d\n", g_traj_x, g_traj_y);
-                    }
-                    else if(control == 0x83 && command == 0x12 && payload_len == 4) {
-                        // Trajectory point report: 2 bytes X, 2 bytes Y (big-endian)
-                        g_traj_x = (int16_t)((data[i+6] << 8) | data[i+7]);
-                        g_traj_y = (int16_t)((data[i+8] << 8) | data[i+9]);
-                        printf("Parsed Trajectory: X=%d, Y=%d\n", g_traj_x, g_traj_y);
-                    }
-                    else if(control == 0x83 && command == 0x0E && payload_len == 6) {
-                        // Height Proportion Report:
-                        // Byte 0-1: Total height count (16-bit)
-                        // Byte 2: Proportion for 0-0.5 m
-                        // Byte 3: Proportion for 0.5-1 m
-                        // Byte 4: Proportion for 1-1.5 m
-                        // Byte 5: Proportion for 1.5-2 m
-                        
-                        // Add debug output to see raw bytes
-                        printf("Height Proportion Raw Data: ");
-                        for (int j = 0; j < payload_len; j++) {
-                            printf("%02X ", data[i+6+j]);
-                        }
-                        printf("\n");
-                        
-                        uint16_t total = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        uint8_t prop0 = data[i+8];
-                        uint8_t prop1 = data[i+9];
-                        uint8_t prop2 = data[i+10];
-                        uint8_t prop3 = data[i+11];
-                        g_total_height_count = total;
-                        g_height_prop_0_0_5 = prop0;
-                        g_height_prop_0_5_1 = prop1;
-                        g_height_prop_1_1_5 = prop2;
-                        g_height_prop_1_5_2 = prop3;
-                        
-                        // Improved debug output with clear formatting and percentage calculation
-                        printf("Height Proportion Report:\n");
-                        printf("  Total Count: %d\n", total);
-                        printf("  0-0.5m: %d (%d%%)\n", prop0, total > 0 ? (prop0 * 100 / total) : 0);
-                        printf("  0.5-1m: %d (%d%%)\n", prop1, total > 0 ? (prop1 * 100 / total) : 0);
-                        printf("  1-1.5m: %d (%d%%)\n", prop2, total > 0 ? (prop2 * 100 / total) : 0);
-                        printf("  1.5-2m: %d (%d%%)\n", prop3, total > 0 ? (prop3 * 100 / total) : 0);
-                        
-                        // Verify that proportions add up to total (for debugging)
-                        uint16_t sum = prop0 + prop1 + prop2 + prop3;
-                        if (sum != total) {
-                            printf("  WARNING: Sum of proportions (%d) doesn't match total (%d)\n", sum, total);
-                        }
-                    }
-                    else if(control == 0x80 && command == 0x0A && payload_len == 4) {
-                        // Non-presence time report (4 bytes, in seconds)
-                        // Extract the 32-bit value (little-endian)
-                        g_non_presence_time = ((uint32_t)data[i+9] << 24) | 
-                                             ((uint32_t)data[i+8] << 16) | 
-                                             ((uint32_t)data[i+7] << 8) | 
-                                              data[i+6];
-                        printf("Parsed Non-presence Time: %" PRIu32 " seconds\n", g_non_presence_time);
-                    }
-                    else if(control == 0x80 && command == 0x12 && payload_len == 4) {
-                        // Non-presence time report (4 bytes, in seconds, transmitted in big-endian)
-                        g_non_presence_time = ((uint32_t)data[i+6] << 24) |
-                                              ((uint32_t)data[i+7] << 16) |
-                                              ((uint32_t)data[i+8] << 8)  |
-                                               data[i+9];
-                        printf("Parsed Non-presence Time: %" PRIu32 " seconds\n", g_non_presence_time);
-                    }
-                    else if(control == 0x05 && command == 0x07 && payload_len == 1) {
-                        // Scenario Report
-                        g_scenario = data[i + 6];
-                        printf("Parsed Scenario Report: %d\n", g_scenario);
-                    }
-                    else if(control == 0x06 && command == 0x01 && payload_len == 6) {
-                        // Installation Angle Report: 3 x 16-bit values (X, Y, Z)
-                        g_installation_angle_x = (int16_t)((data[i+7] << 8) | data[i+6]);
-                        g_installation_angle_y = (int16_t)((data[i+9] << 8) | data[i+8]);
-                        g_installation_angle_z = (int16_t)((data[i+11] << 8) | data[i+10]);
-                        printf("Parsed Installation Angle: X=%d, Y=%d, Z=%d\n", 
-                               g_installation_angle_x, g_installation_angle_y, g_installation_angle_z);
-                    }
-                    else if(control == 0x06 && command == 0x02 && payload_len == 2) {
-                        // Installation Height Report
-                        g_installation_height = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        printf("Parsed Installation Height: %d cm\n", g_installation_height);
-                    }
-                    else if(control == 0x83 && command == 0x02 && payload_len == 7) {
-                        // Fall Detection Parameters
-                        g_fall_detection_sensitivity = data[i + 6];
-                        g_fall_duration = ((uint32_t)data[i+10] << 24) | 
-                                         ((uint32_t)data[i+9] << 16) | 
-                                         ((uint32_t)data[i+8] << 8) | 
-                                          data[i+7];
-                        g_fall_breaking_height = ((uint16_t)data[i+12] << 8) | data[i+11];
-                        printf("Parsed Fall Detection Parameters: Sensitivity=%d, Duration=%"PRIu32" s, Breaking Height=%d cm\n",
-                               g_fall_detection_sensitivity, g_fall_duration, g_fall_breaking_height);
-                    }
-                    else if(control == 0x83 && command == 0x0D && payload_len == 1) {
-                        // Fall Detection Sensitivity Report
-                        g_fall_detection_sensitivity = data[i+6];
-                        printf("Parsed Fall Detection Sensitivity: %d\n", g_fall_detection_sensitivity);
-                    }
-                    else if(control == 0x83 && command == 0x0C && payload_len == 4) {
-                        // Fall Duration Report (4 bytes, big-endian)
-                        g_fall_duration = ((uint32_t)data[i+6] << 24) |
-                                          ((uint32_t)data[i+7] << 16) |
-                                          ((uint32_t)data[i+8] << 8)  | data[i+9];
-                        printf("Parsed Fall Duration: %" PRIu32 " seconds\n", g_fall_duration);
-                    }
-                    else if(control == 0x83 && command == 0x11 && payload_len == 2) {
-                        // Fall Breaking Height Report (2 bytes, big-endian)
-                        g_fall_breaking_height = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        printf("Parsed Fall Breaking Height: %d cm\n", g_fall_breaking_height);
-                    }
-                    else if(control == 0x80 && command == 0x0D && payload_len == 2) {
-                        // Sitting-still Horizontal Distance (big-endian)
-                        g_sitting_still_distance = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        printf("Parsed Sitting-still Horizontal Distance: %d cm\n", g_sitting_still_distance);
-                    }
-                    else if(control == 0x80 && command == 0x0E && payload_len == 2) {
-                        // Moving Horizontal Distance (big-endian)
-                        g_moving_distance = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        printf("Parsed Moving Horizontal Distance: %d cm\n", g_moving_distance);
-                    }
-                    else if(control == 0x02 && command == 0xA1 && payload_len >= 1) {
-                        int len_str = payload_len;
-                        if(len_str > PRODUCT_STR_LEN - 1) len_str = PRODUCT_STR_LEN - 1;
-                        memcpy(g_product_model, &data[i+6], len_str);
-                        g_product_model[len_str] = '\0';
-                        printf("Parsed Product Model: %s\n", g_product_model);
-                    }
-                    else if(control == 0x02 && command == 0xA2 && payload_len >= 1) {
-                        int len_str = payload_len;
-                        if(len_str > PRODUCT_STR_LEN - 1) len_str = PRODUCT_STR_LEN - 1;
-                        memcpy(g_product_id, &data[i+6], len_str);
-                        g_product_id[len_str] = '\0';
-                        printf("Parsed Product ID: %s\n", g_product_id);
-                    }
-                    else if(control == 0x02 && command == 0xA3 && payload_len >= 1) {
-                        int len_str = payload_len;
-                        if(len_str > PRODUCT_STR_LEN - 1) len_str = PRODUCT_STR_LEN - 1;
-                        memcpy(g_hardware_model, &data[i+6], len_str);
-                        g_hardware_model[len_str] = '\0';
-                        printf("Parsed Hardware Model: %s\n", g_hardware_model);
-                    }
-                    else if(control == 0x02 && command == 0xA4 && payload_len >= 1) {
-                        int len_str = payload_len;
-                        if(len_str > PRODUCT_STR_LEN - 1) len_str = PRODUCT_STR_LEN - 1;
-                        memcpy(g_firmware_version, &data[i+6], len_str);
-                        g_firmware_version[len_str] = '\0';
-                        printf("Parsed Firmware Version: %s\n", g_firmware_version);
-                    }
-                    else if(control == 0x03 && command == 0xB0 && payload_len == 4) {
-                        // Operating Time Report (4 bytes, big-endian)
-                        g_operating_time = ((uint32_t)data[i+6] << 24) |
-                                           ((uint32_t)data[i+7] << 16) |
-                                           ((uint32_t)data[i+8] << 8)  | data[i+9];
-                        printf("Parsed Operating Time: %" PRIu32 " seconds\n", g_operating_time);
-                    }
-                    else if(control == 0x83 && command == 0x0B && payload_len == 1) {
-                        // Stay-still switch response
-                        g_stay_still_switch = (data[i+6] == 0x01);
-                        printf("Parsed Stay-still Switch: %s\n", g_stay_still_switch ? "Enabled" : "Disabled");
-                    }
-                    else if(control == 0x83 && command == 0x0A && payload_len == 4) {
-                        // Stay-still duration response (4 bytes, big-endian)
-                        g_stay_still_duration = ((uint32_t)data[i+6] << 24) |
-                                               ((uint32_t)data[i+7] << 16) |
-                                               ((uint32_t)data[i+8] << 8)  |
-                                                data[i+9];
-                        printf("Parsed Stay-still Duration: %" PRIu32 " seconds\n", g_stay_still_duration);
-                    }
-                    else if(control == 0x83 && command == 0x8F && payload_len == 4) {
-                        // Height cumulation time query reply (4 bytes, big-endian)
-                        g_height_accumulation_time= ((uint32_t)data[i+6] << 24) |
-                                                   ((uint32_t)data[i+7] << 16) |
-                                                   ((uint32_t)data[i+8] << 8)  |
-                                                   data[i+9];
-                        printf("Parsed Height Cumulation Time: %" PRIu32 " seconds\n", g_height_accumulation_time);
-                    }
-                    else if (control == 0x82 && command == 0x02 && payload_len == 11) {
-                        // New hypothesis: This frame contains height measurement data.
-                        uint16_t height_value = ((uint16_t)data[i+1]); // Take byte [1] as height in cm
-                        
-                        // Store the value in an appropriate global variable
-                        g_total_height_count = height_value;
-
-                        printf("✅ Parsed Height Measurement Frame: Height = %d cm\n", g_total_height_count);
-                    }
-                    // Inside the while(i < len) loop, after all known frame branches
-                    else if(payload_len == 6 && !(control == 0x83 && command == 0x0E)) {
-                        // Assume this 6-byte payload is a height proportion report
-                        uint16_t total = ((uint16_t)data[i+6] << 8) | data[i+7];
-                        uint8_t prop0 = data[i+8];
-                        uint8_t prop1 = data[i+9];
-                        uint8_t prop2 = data[i+10];
-                        uint8_t prop3 = data[i+11];
-                        // Update global variables
-                        g_total_height_count = total;
-                        g_height_prop_0_0_5 = prop0;
-                        g_height_prop_0_5_1 = prop1;
-                        g_height_prop_1_1_5 = prop2;
-                        g_height_prop_1_5_2 = prop3;
-                        
-                        // Print a clear debug message with calculated percentages
-                        printf("Height Proportion Report (fallback):\n");
-                        printf("  Total Count: %d\n", total);
-                        printf("  0-0.5m: %d (%d%%)\n", prop0, total > 0 ? (prop0 * 100 / total) : 0);
-                        printf("  0.5-1m: %d (%d%%)\n", prop1, total > 0 ? (prop1 * 100 / total) : 0);
-                        printf("  1-1.5m: %d (%d%%)\n", prop2, total > 0 ? (prop2 * 100 / total) : 0);
-                        printf("  1.5-2m: %d (%d%%)\n", prop3, total > 0 ? (prop3 * 100 / total) : 0);
-                        
-                        // Advance the index past this frame and continue with next frame.
-                        i += frame_total_length;
-                        continue;
-                    }
-                    else {
-                        // Print unknown frame data for debugging
-                        printf("🚨🚨 Unknown Frame Data 🚨🚨: ");
-                        for (int j = 0; j < payload_len; j++) {
-                            printf("%02X ", data[i + 6 + j]);  // Print each byte in HEX
-                        }
-                        printf("\n");
-                    }
+    switch (r->id) {
+        case RADAR_RPT_PRESENCE:
+            if (st->presence != r->flag) changed |= LIVE_FIELD_PRESENCE;
+            st->presence = r->flag;
+            break;
+        case RADAR_RPT_WORKING_STATUS:
+            st->working_status = r->u8;
+            break;
+        case RADAR_RPT_WORKING_STATUS_ACK:
+            st->working_status = r->u8;
+            break;
+        case RADAR_RPT_MOVEMENT_STATE:
+            if (st->movement_state != r->u8) changed |= LIVE_FIELD_MOVEMENT_STATE;
+            st->movement_state = r->u8; // 0: No movement, 1: Static, 2: Active
+            break;
+        case RADAR_RPT_BODY_MOVEMENT:
+            if (st->body_movement_param != r->u8) changed |= LIVE_FIELD_BODY_MOVEMENT;
+            st->body_movement_param = r->u8;
+            break;
+        case RADAR_RPT_FALL_ALARM:
+            if (st->fall_alarm != r->flag) changed |= LIVE_FIELD_FALL_ALARM;
+            st->fall_alarm = r->flag;
+            break;
+        case RADAR_RPT_STAY_STILL_ALARM:
+            if (st->stay_still_alarm != r->flag) changed |= LIVE_FIELD_STAY_STILL_ALARM;
+            st->stay_still_alarm = r->flag;
+            break;
+        case RADAR_RPT_HEARTBEAT:
+            if (st->heartbeat != r->u8) changed |= LIVE_FIELD_HEARTBEAT;
+            st->heartbeat = r->u8;
+            break;
+        case RADAR_RPT_TRAJECTORY:
+            if (st->traj_x != r->traj.x || st->traj_y != r->traj.y) changed |= LIVE_FIELD_TRAJECTORY;
+            st->traj_x = r->traj.x;
+            st->traj_y = r->traj.y;
+            track_buffer_add(r->traj.x, r->traj.y);
+            break;
+        case RADAR_RPT_HEIGHT_PROPORTION: {
+            uint16_t total = r->height_prop.total;
+            const uint8_t *prop = r->height_prop.prop;
+            if (st->total_height_count != total || st->height_prop_0_0_5 != prop[0] ||
+                st->height_prop_0_5_1 != prop[1] || st->height_prop_1_1_5 != prop[2] ||
+                st->height_prop_1_5_2 != prop[3]) {
+                changed |= LIVE_FIELD_HEIGHT;
+            }
+            st->total_height_count = total;
+            st->height_prop_0_0_5 = prop[0];
+            st->height_prop_0_5_1 = prop[1];
+            st->height_prop_1_1_5 = prop[2];
+            st->height_prop_1_5_2 = prop[3];
+            break;
+        }
+        case RADAR_RPT_NON_PRESENCE_TIME:
+            if (st->non_presence_time != r->u32) changed |= LIVE_FIELD_NON_PRESENCE_TIME;
+            st->non_presence_time = r->u32;
+            break;
+        case RADAR_RPT_SCENARIO:
+            st->scenario = r->u8;
+            break;
+        case RADAR_RPT_INSTALL_ANGLES:
+            st->installation_angle_x = r->angles.x;
+            st->installation_angle_y = r->angles.y;
+            st->installation_angle_z = r->angles.z;
+            break;
+        case RADAR_RPT_INSTALL_HEIGHT:
+            st->installation_height = r->u16;
+            break;
+        case RADAR_RPT_FALL_PARAMS:
+            st->fall_detection_sensitivity = r->fall.sensitivity;
+            st->fall_duration = r->fall.duration;
+            st->fall_breaking_height = r->fall.breaking_height;
+            break;
+        case RADAR_RPT_FALL_SENSITIVITY:
+            st->fall_detection_sensitivity = r->u8;
+            break;
+        case RADAR_RPT_FALL_DURATION:
+            st->fall_duration = r->u32;
+            break;
+        case RADAR_RPT_FALL_BREAKING_HEIGHT:
+            st->fall_breaking_height = r->u16;
+            break;
+        case RADAR_RPT_SITTING_STILL_DISTANCE:
+            st->sitting_still_distance = r->u16;
+            break;
+        case RADAR_RPT_MOVING_DISTANCE:
+            st->moving_distance = r->u16;
+            break;
+        case RADAR_RPT_PRODUCT_MODEL:
+            strncpy(st->product_model, r->text, PRODUCT_STR_LEN - 1);
+            break;
+        case RADAR_RPT_PRODUCT_ID:
+            strncpy(st->product_id, r->text, PRODUCT_STR_LEN - 1);
+            break;
+        case RADAR_RPT_HARDWARE_MODEL:
+            strncpy(st->hardware_model, r->text, PRODUCT_STR_LEN - 1);
+            break;
+        case RADAR_RPT_FIRMWARE_VERSION:
+            strncpy(st->firmware_version, r->text, PRODUCT_STR_LEN - 1);
+            break;
+        case RADAR_RPT_OPERATING_TIME:
+            st->operating_time = r->u32;
+            break;
+        case RADAR_RPT_STAY_STILL_SWITCH:
+            st->stay_still_switch = r->flag;
+            break;
+        case RADAR_RPT_STAY_STILL_DURATION:
+            st->stay_still_duration = r->u32;
+            break;
+        case RADAR_RPT_HEIGHT_ACCUMULATION_TIME:
+            st->height_accumulation_time = r->u32;
+            break;
+        case RADAR_RPT_HEIGHT_MEASUREMENT:
+            if (st->total_height_count != r->u16) changed |= LIVE_FIELD_HEIGHT;
+            st->total_height_count = r->u16;
+            break;
+        default:
+            break;
+    }
 
-                    
-                    // Move index past this frame
-                    i += frame_total_length;
-                } else {
-                    i++;
-                }
-            }
-        }
-        
-        // Increase the frequency of height proportion data requests to get more updates
-        uint32_t current_tick = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        if(current_tick - last_height_prop_request > 2000) {  // Changed from 5000 to 2000 ms
-            // Send both types of height queries to ensure we get data
-            send_query(0x83, 0x8E, 0x0F); // Height proportion over a period
-            vTaskDelay(pdMS_TO_TICKS(50));
-            send_query(0x83, 0x0E, 0x0F); // Direct height proportion query
-            printf("Requested Height Proportion Queries\n");
-            last_height_prop_request = current_tick;
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(100));
+    radar_state_publish();
+
+    if (changed) {
+        live_publisher_notify(changed, s_frame_rx_us);
     }
 }
 
-// Task to print live data JSON payload
-void live_json_print_task(void *arg)
+// Called by the decoder for every complete, checksum-verified frame
+static void handle_radar_frame(const radar_frame_t *frame, void *ctx)
 {
-    while(1) {
-        print_live_json_payload();
-        vTaskDelay(pdMS_TO_TICKS(30000));  // ปรับ refresh rate เป็น 30 วินาที
+    int64_t start = esp_timer_get_time();
+
+    radar_cmd_on_response(frame);
+
+    radar_report_t report;
+    if (radar_report_decode(frame, &report)) {
+        apply_radar_report(&report);
+        radar_log_frame(frame, true, false);
+    } else {
+        metrics_inc(METRIC_RADAR_UNKNOWN_FRAMES);
+        radar_log_frame(frame, false, radar_reports_unknown_count(frame->control, frame->command) == 1);
     }
+
+    metrics_observe(METRIC_HIST_RADAR_FRAME_US, (uint32_t)(esp_timer_get_time() - start));
 }
 
-// Task to print settings JSON payload
-void settings_json_print_task(void *arg)
+// Print how often each unknown opcode has been seen
+static void print_unknown_opcode(uint8_t control, uint8_t command, uint32_t count, void *ctx)
 {
-    while(1) {
-        print_settings_json_payload();
-        vTaskDelay(pdMS_TO_TICKS(15000));  // Adjust refresh rate as needed
+    bool *header_printed = ctx;
+    if (!*header_printed) {
+        printf("Unknown radar frames by opcode:\n");
+        *header_printed = true;
     }
+    printf("  0x%02X/0x%02X: %" PRIu32 "\n", control, command, count);
 }
 
-// Task to print product information JSON payload
-void product_info_json_print_task(void *arg)
+void print_unknown_frame_stats(void)
 {
-    while(1) {
-        print_product_info_payload();
-        vTaskDelay(pdMS_TO_TICKS(10000));
+    bool header_printed = false;
+    uint32_t overflow = radar_reports_foreach_unknown(print_unknown_opcode, &header_printed);
+    if (overflow > 0) {
+        printf("  (other opcodes): %" PRIu32 "\n", overflow);
     }
 }
 
-// Task to print Usage/Operating Time JSON payload periodically
-void usage_json_print_task(void *arg)
+// This task continuously reads UART data and feeds it to the frame decoder
+void uart_read_task(void *arg)
 {
+    uint8_t data[BUF_SIZE];
+
+    radar_decoder_init(&s_radar_decoder, handle_radar_frame, NULL);
+
     while(1) {
-        print_usage_json_payload();
-        vTaskDelay(pdMS_TO_TICKS(10000));  // Adjust update interval as needed
+        // Block until the driver reports RX activity
+        uart_event_t event;
+        if (xQueueReceive(s_uart_event_queue, &event, portMAX_DELAY) == pdTRUE) {
+            switch (event.type) {
+                case UART_DATA: {
+                    // Drain everything buffered so far, not just this event's chunk
+                    size_t buffered = 0;
+                    uart_get_buffered_data_len(UART_PORT_NUM, &buffered);
+                    while (buffered > 0) {
+                        int len = uart_read_bytes(UART_PORT_NUM, data,
+                                                  buffered < BUF_SIZE ? buffered : BUF_SIZE, 0);
+                        if (len <= 0) {
+                            break;
+                        }
+                        s_frame_rx_us = (uint32_t)esp_timer_get_time();
+                        metrics_add(METRIC_UART_BYTES, (uint32_t)len);
+                        radar_decoder_feed(&s_radar_decoder, data, len);
+                        buffered = (size_t)len < buffered ? buffered - len : 0;
+                    }
+                    break;
+                }
+                case UART_FIFO_OVF:
+                case UART_BUFFER_FULL:
+                    // Bytes were lost, so any partial frame is garbage
+                    printf("UART RX overflow (event %d), flushing input\n", event.type);
+                    metrics_inc(METRIC_UART_OVERFLOWS);
+                    uart_flush_input(UART_PORT_NUM);
+                    xQueueReset(s_uart_event_queue);
+                    radar_decoder_reset(&s_radar_decoder);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+#if CONFIG_DIAG_PRINT_JSON
+// Console dumps of the JSON payloads for bench debugging. One low-priority task
+// replaces the four print tasks that used to run at the parser's priority.
+static void diag_print_task(void *arg)
+{
+    for (uint32_t s = 0;; s += 5) {
+        if (s % 10 == 0) {
+            print_product_info_payload();
+            print_usage_json_payload();
+        }
+        if (s % 15 == 0) {
+            print_settings_json_payload();
+        }
+        if (s % 30 == 0) {
+            print_live_json_payload();
+            print_unknown_frame_stats();
+        }
+        vTaskDelay(pdMS_TO_TICKS(5000));
     }
 }
+#endif
 
 // Task that monitors console input (from UART0) for key presses.
 // When the user types the letter 'r' or 'R', it prints the working status report.
@@ -1068,181 +1506,73 @@ void key_read_task(void *arg)
         // getchar() will block until a character is received on the console (UART0).
         ch = getchar();
         if(ch == 'r' || ch == 'R'){
-            printf("Working Status Report (on demand): 0x%02X\n", g_working_status);
+            radar_state_t st;
+            radar_state_snapshot(&st);
+            printf("Working Status Report (on demand): 0x%02X\n", st.working_status);
+        } else if (ch == 't' || ch == 'T') {
+            // Stack headroom and CPU share per task since the previous sample
+            task_profile_print();
         }
         vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
 
-// This task periodically sends a working status query to the radar module.
-void settings_read_task(void *arg)
-{
-    while(1) {
-        send_query(0x05, 0x81, 0x0F);
-        printf("Sent Working Status Query\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-    }
+// Send a one-shot query through the command scheduler
+void send_query(uint8_t control, uint8_t command, uint8_t data_payload) {
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_query(frame, sizeof(frame), control, command, data_payload);
+    radar_cmd_submit(frame, len, RADAR_CMD_PRIO_NORMAL);
 }
 
-// Helper function to build and send a query frame.
-// The frame format is: HEADER (2 bytes), control (1 byte), command (1 byte),
-// length (2 bytes), data (payload), check (1 byte), tail (2 bytes).
-void send_query(uint8_t control, uint8_t command, uint8_t data_payload) {
-    uint8_t frame[10];
-    frame[0] = FRAME_HEADER0;
-    frame[1] = FRAME_HEADER1;
-    frame[2] = control;
-    frame[3] = command;
-    frame[4] = 0x00;
-    frame[5] = 0x01; // 1 byte payload
-    frame[6] = data_payload;
-    uint32_t sum = 0;
-    for (int j = 0; j < 7; j++) {
-        sum += frame[j];
-    }
-    frame[7] = sum & 0xFF;
-    frame[8] = FRAME_TAIL0;
-    frame[9] = FRAME_TAIL1;
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+// Register a query that the command scheduler repeats every period_ms
+static void schedule_query(uint8_t control, uint8_t command, uint8_t data_payload,
+                           uint32_t period_ms, radar_cmd_prio_t prio) {
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_query(frame, sizeof(frame), control, command, data_payload);
+    radar_cmd_schedule(frame, len, period_ms, prio);
+}
+
+// Periodic radar polling. These used to be separate tasks (plus a second copy of
+// the height queries and another 2 s burst from uart_read_task); the scheduler
+// now spaces them out on the TX line.
+static void start_radar_polling(void) {
+    // Live data
+    schedule_query(0x83, 0x0E, 0x0F, 2000, RADAR_CMD_PRIO_NORMAL);   // Height proportion
+    schedule_query(0x83, 0x8E, 0x0F, 2000, RADAR_CMD_PRIO_NORMAL);   // Height proportion over a period
+    schedule_query(0x01, 0x01, 0x0F, 10000, RADAR_CMD_PRIO_NORMAL);  // Heartbeat
+
+    // Housekeeping
+    schedule_query(0x05, 0x81, 0x0F, 5000, RADAR_CMD_PRIO_LOW);      // Working status
+    schedule_query(0x02, 0xA1, 0x0F, 15000, RADAR_CMD_PRIO_LOW);     // Product model
+    schedule_query(0x02, 0xA2, 0x0F, 15000, RADAR_CMD_PRIO_LOW);     // Product ID
+    schedule_query(0x02, 0xA3, 0x0F, 15000, RADAR_CMD_PRIO_LOW);     // Hardware model
+    schedule_query(0x02, 0xA4, 0x0F, 15000, RADAR_CMD_PRIO_LOW);     // Firmware version
 }
 
 // Function to update the installation height setting on the radar device
 void update_installation_height(uint16_t new_height) {
-    // Frame structure: HEADER (2) + CONTROL (1) + COMMAND (1) +
-    // LENGTH (2) + PAYLOAD (2) + CHECK (1) + TAIL (2) = 11 bytes total.
-    uint8_t frame[11];
-    frame[0] = FRAME_HEADER0;        // 0x53
-    frame[1] = FRAME_HEADER1;        // 0x59
-    frame[2] = 0x06;                 // Control for installation configuration
-    frame[3] = 0x02;                 // Command for installation height
-    frame[4] = 0x00;                 // Length high byte
-    frame[5] = 0x02;                 // Length low byte (2 bytes payload)
-    // Payload: height in centimeters, big-endian
-    frame[6] = (new_height >> 8) & 0xFF;
-    frame[7] = new_height & 0xFF;
-    
-    // Calculate check digit: sum of all bytes from header to payload.
-    uint32_t sum = 0;
-    for (int i = 0; i < 8; i++) {
-        sum += frame[i];
-    }
-    frame[8] = sum & 0xFF;
-    
-    // Append fixed tail
-    frame[9]  = FRAME_TAIL0;         // 0x54
-    frame[10] = FRAME_TAIL1;         // 0x43
-
-    // Write frame to UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_installation_height(frame, sizeof(frame), new_height);
+    request_setting(SETTING_INSTALLATION_HEIGHT, frame, len, (setting_value_t){ .u32 = new_height });
     printf("Sent installation height update: %d cm\n", new_height);
-
-    // Optionally update the global variable if you want to reflect the change immediately.
-    g_installation_height = new_height;
     
     // // Publish updated settings
     // mqtt_publish_settings();
 }
 
 void update_height_accumulation_time(uint32_t seconds) {
-    uint8_t frame[13];
-    frame[0] = FRAME_HEADER0;   // 0x53
-    frame[1] = FRAME_HEADER1;   // 0x59
-    frame[2] = 0x83;            // Control byte
-    frame[3] = 0x8F;            // <-- Corrected command for height accumulation time
-    frame[4] = 0x00;            // Payload length high byte
-    frame[5] = 0x04;            // Payload length (4 bytes)
-
-    // Payload: seconds (big-endian)
-    frame[6] = (seconds >> 24) & 0xFF;
-    frame[7] = (seconds >> 16) & 0xFF;
-    frame[8] = (seconds >> 8) & 0xFF;
-    frame[9] = seconds & 0xFF;
-
-    // Checksum calculation
-    uint32_t sum = 0;
-    for (int i = 0; i < 10; i++) sum += frame[i];
-    frame[10] = sum & 0xFF;
-
-    // Append tail
-    frame[11] = FRAME_TAIL0;    // 0x54
-    frame[12] = FRAME_TAIL1;    // 0x43
-
-    // Send frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_height_accumulation_time(frame, sizeof(frame), seconds);
+    request_setting(SETTING_HEIGHT_ACCUMULATION_TIME, frame, len, (setting_value_t){ .u32 = seconds });
     printf("Height Accumulation Time updated to: %" PRIu32 " seconds\n", seconds);
-
-    g_height_accumulation_time = seconds;
-}
-
-
-void heartbeat_task(void *arg)
-{
-    while (1) {
-        // Send heartbeat query frame
-        uint8_t frame[10];
-        frame[0] = FRAME_HEADER0;   // 0x53
-        frame[1] = FRAME_HEADER1;   // 0x59
-        frame[2] = 0x01;            // Control byte for heartbeat
-        frame[3] = 0x01;            // Command for heartbeat query
-        frame[4] = 0x00;            // Length high byte
-        frame[5] = 0x01;            // Length low byte (1 byte payload)
-        frame[6] = 0x0F;            // Payload (query value)
-
-        // Calculate checksum
-        uint32_t sum = 0;
-        for (int i = 0; i < 7; i++) {
-            sum += frame[i];
-        }
-        frame[7] = sum & 0xFF;
-
-        // Append tail
-        frame[8] = FRAME_TAIL0;     // 0x54
-        frame[9] = FRAME_TAIL1;     // 0x43
-
-        // Send frame via UART
-        uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
-        printf("Sent heartbeat query\n");
-
-        // Wait for 10 seconds before next heartbeat
-        vTaskDelay(pdMS_TO_TICKS(10000));
-    }
 }
 
 
 void update_non_presence_time(uint32_t seconds) {
-    // Frame structure (13 bytes total):
-    // Header (2) + Control (1) + Command (1) + Length (2) + Payload (4) + Check (1) + Tail (2)
-    uint8_t frame[13];
-    frame[0] = FRAME_HEADER0;   // 0x53
-    frame[1] = FRAME_HEADER1;   // 0x59
-    frame[2] = 0x83;            // Control byte
-    frame[3] = 0x0B;            // Command for non-presence time
-    frame[4] = 0x00;            // Length high byte
-    frame[5] = 0x04;            // Length low byte (4 bytes payload)
-    
-    // Convert seconds to bytes (little-endian)
-    frame[6] = seconds & 0xFF;
-    frame[7] = (seconds >> 8) & 0xFF;
-    frame[8] = (seconds >> 16) & 0xFF;
-    frame[9] = (seconds >> 24) & 0xFF;
-
-    // Calculate checksum
-    uint32_t sum = 0;
-    for (int i = 0; i < 10; i++) {
-        sum += frame[i];
-    }
-    frame[10] = sum & 0xFF;
-
-    // Append tail
-    frame[11] = FRAME_TAIL0;    // 0x54
-    frame[12] = FRAME_TAIL1;    // 0x43
-
-    // Send frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_non_presence_time(frame, sizeof(frame), seconds);
+    request_setting(SETTING_NON_PRESENCE_TIME, frame, len, (setting_value_t){ .u32 = seconds });
     printf("Non-presence Time updated to: %" PRIu32 " seconds\n", seconds);
-
-    // Update global variable
-    g_non_presence_time = seconds;
 }
 
 // Function to update the fall detection sensitivity setting on the radar device
@@ -1252,33 +1582,10 @@ void update_fall_detection_sensitivity(uint8_t new_sensitivity) {
         printf("Sensitivity value %d out of range. Clamping to 3.\n", new_sensitivity);
         new_sensitivity = 3;
     }
-    // Frame structure:
-    // Header (2 bytes) + Control (1 byte) + Command (1 byte) +
-    // Length (2 bytes) + Payload (1 byte) + Check (1 byte) + Tail (2 bytes) = 10 bytes total.
-    uint8_t frame[10];
-    frame[0] = FRAME_HEADER0;          // e.g., 0x53
-    frame[1] = FRAME_HEADER1;          // e.g., 0x59
-    frame[2] = 0x83;                   // Control for fall detection
-    frame[3] = 0x0D;                   // Command for updating fall detection sensitivity
-    frame[4] = 0x00;                   // Payload length high byte (1 byte payload)
-    frame[5] = 0x01;                   // Payload length low byte
-    frame[6] = new_sensitivity;        // New sensitivity value (0 to 3)
-    
-    // Calculate check digit (sum of header, control, command, length, and payload bytes)
-    uint32_t sum = 0;
-    for (int i = 0; i < 7; i++) {
-        sum += frame[i];
-    }
-    frame[7] = sum & 0xFF;
-    frame[8] = FRAME_TAIL0;            // e.g., 0x54
-    frame[9] = FRAME_TAIL1;            // e.g., 0x43
-
-    // Send the frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_fall_sensitivity(frame, sizeof(frame), new_sensitivity);
+    request_setting(SETTING_FALL_SENSITIVITY, frame, len, (setting_value_t){ .u32 = new_sensitivity });
     printf("Sent Fall Detection Sensitivity update: %d\n", new_sensitivity);
-
-    // Update the global variable to reflect the new setting
-    g_fall_detection_sensitivity = new_sensitivity;
     
     // Publish updated settings
     // mqtt_publish_settings();
@@ -1296,40 +1603,10 @@ void update_fall_duration(uint32_t new_duration) {
         new_duration = 180;
     }
     
-    // Frame structure:
-    // Header (2 bytes) + Control (1 byte) + Command (1 byte) + Length (2 bytes)
-    // + Payload (4 bytes) + Check (1 byte) + Tail (2 bytes) = 13 bytes total.
-    uint8_t frame[13];
-    frame[0] = FRAME_HEADER0;          // 0x53
-    frame[1] = FRAME_HEADER1;          // 0x59
-    frame[2] = 0x83;                   // Control for fall detection parameters
-    frame[3] = 0x0C;                   // Command for updating fall duration
-    frame[4] = 0x00;                   // Length high byte (payload is 4 bytes)
-    frame[5] = 0x04;                   // Length low byte
-    
-    // Payload: new_duration (4 bytes, big-endian)
-    frame[6] = (new_duration >> 24) & 0xFF;
-    frame[7] = (new_duration >> 16) & 0xFF;
-    frame[8] = (new_duration >> 8)  & 0xFF;
-    frame[9] = new_duration & 0xFF;
-    
-    // Calculate check digit: sum bytes from header through payload
-    uint32_t sum = 0;
-    for (int i = 0; i < 10; i++) {
-        sum += frame[i];
-    }
-    frame[10] = sum & 0xFF;
-    
-    // Append tail bytes
-    frame[11] = FRAME_TAIL0;           // 0x54
-    frame[12] = FRAME_TAIL1;           // 0x43
-
-    // Send the frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_fall_duration(frame, sizeof(frame), new_duration);
+    request_setting(SETTING_FALL_DURATION, frame, len, (setting_value_t){ .u32 = new_duration });
     printf("Sent Fall Duration update: %" PRIu32 " seconds\n", new_duration);
-
-    // Optionally, update the global variable to reflect the new value.
-    g_fall_duration = new_duration;
     
     // Publish updated settings
     // mqtt_publish_settings();
@@ -1343,38 +1620,10 @@ void update_fall_breaking_height(uint16_t new_height) {
         new_height = 150;
     }
     
-    // Frame structure:
-    // HEADER (2 bytes) + CONTROL (1 byte) + COMMAND (1 byte) + LENGTH (2 bytes)
-    // + PAYLOAD (2 bytes) + CHECK (1 byte) + TAIL (2 bytes) = 11 bytes total.
-    uint8_t frame[11];
-    frame[0] = FRAME_HEADER0;          // e.g., 0x53
-    frame[1] = FRAME_HEADER1;          // e.g., 0x59
-    frame[2] = 0x83;                   // Control for fall detection parameters
-    frame[3] = 0x11;                   // Command for fall breaking height update
-    frame[4] = 0x00;                   // Length high byte (payload length is 2)
-    frame[5] = 0x02;                   // Length low byte
-    
-    // Payload: new_height (2 bytes, big-endian)
-    frame[6] = (new_height >> 8) & 0xFF;
-    frame[7] = new_height & 0xFF;
-    
-    // Calculate check digit: sum of header, control, command, length, and payload bytes (bytes 0 to 7)
-    uint32_t sum = 0;
-    for (int i = 0; i < 8; i++) {
-        sum += frame[i];
-    }
-    frame[8] = sum & 0xFF;
-    
-    // Append tail bytes
-    frame[9]  = FRAME_TAIL0;           // e.g., 0x54
-    frame[10] = FRAME_TAIL1;           // e.g., 0x43
-
-    // Send the frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_fall_breaking_height(frame, sizeof(frame), new_height);
+    request_setting(SETTING_FALL_BREAKING_HEIGHT, frame, len, (setting_value_t){ .u32 = new_height });
     printf("Sent Fall Breaking Height update: %d cm\n", new_height);
-
-    // Optionally update the global variable
-    g_fall_breaking_height = new_height;
     
     // Publish updated settings
     // mqtt_publish_settings();
@@ -1388,38 +1637,11 @@ void update_sitting_still_distance(uint16_t new_distance) {
         new_distance = 300;
     }
     
-    // Frame structure:
-    // HEADER (2 bytes) + CONTROL (1 byte) + COMMAND (1 byte) + LENGTH (2 bytes)
-    // + PAYLOAD (2 bytes) + CHECK (1 byte) + TAIL (2 bytes) = 11 bytes total.
-    uint8_t frame[11];
-    frame[0] = FRAME_HEADER0;          // e.g., 0x53
-    frame[1] = FRAME_HEADER1;          // e.g., 0x59
-    frame[2] = 0x80;                   // Control for sensor data settings
-    frame[3] = 0x0D;                   // Command for setting sitting-still horizontal distance
-    frame[4] = 0x00;                   // Length high byte (2 bytes payload)
-    frame[5] = 0x02;                   // Length low byte
-    // Payload: new_distance in cm, represented in big-endian format.
-    frame[6] = (new_distance >> 8) & 0xFF;
-    frame[7] = new_distance & 0xFF;
-    
-    // Calculate check digit: sum bytes 0 to 7, then take the lower 8 bits.
-    uint32_t sum = 0;
-    for (int i = 0; i < 8; i++) {
-        sum += frame[i];
-    }
-    frame[8] = sum & 0xFF;
-    
-    // Append tail bytes
-    frame[9]  = FRAME_TAIL0;           // e.g., 0x54
-    frame[10] = FRAME_TAIL1;           // e.g., 0x43
-
-    // Send the frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_sitting_still_distance(frame, sizeof(frame), new_distance);
+    request_setting(SETTING_SITTING_STILL_DISTANCE, frame, len, (setting_value_t){ .u32 = new_distance });
     printf("Sent Sitting-Still Distance update: %d cm\n", new_distance);
     
-    // Optionally update the global variable to reflect the new setting
-    g_sitting_still_distance = new_distance;
-    
     // Publish updated settings
     // mqtt_publish_settings();
 }
@@ -1432,39 +1654,10 @@ void update_moving_distance(uint16_t new_distance) {
         new_distance = 300;
     }
     
-    // Frame structure:
-    // HEADER (2 bytes) + CONTROL (1 byte) + COMMAND (1 byte) +
-    // LENGTH (2 bytes) + PAYLOAD (2 bytes) + CHECK (1 byte) + TAIL (2 bytes)
-    // Total: 11 bytes.
-    uint8_t frame[11];
-    frame[0] = FRAME_HEADER0;  // e.g., 0x53
-    frame[1] = FRAME_HEADER1;  // e.g., 0x59
-    frame[2] = 0x80;           // Control for sensor data settings
-    frame[3] = 0x0E;           // Command for setting moving horizontal distance
-    frame[4] = 0x00;           // Payload length high byte (2 bytes)
-    frame[5] = 0x02;           // Payload length low byte
-    
-    // Payload: new_distance in big-endian format
-    frame[6] = (new_distance >> 8) & 0xFF;
-    frame[7] = new_distance & 0xFF;
-    
-    // Calculate check digit: sum of bytes 0 to 7
-    uint32_t sum = 0;
-    for (int i = 0; i < 8; i++) {
-        sum += frame[i];
-    }
-    frame[8] = sum & 0xFF;
-    
-    // Append tail bytes
-    frame[9]  = FRAME_TAIL0;  // e.g., 0x54
-    frame[10] = FRAME_TAIL1;  // e.g., 0x43
-
-    // Send the frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_moving_distance(frame, sizeof(frame), new_distance);
+    request_setting(SETTING_MOVING_DISTANCE, frame, len, (setting_value_t){ .u32 = new_distance });
     printf("Sent Moving Horizontal Distance update: %d cm\n", new_distance);
-
-    // Optionally update the global variable
-    g_moving_distance = new_distance;
     
     // Publish updated settings
     // mqtt_publish_settings();
@@ -1472,34 +1665,10 @@ void update_moving_distance(uint16_t new_distance) {
 
 // Function to update the stay-still alarm switch on the radar device
 void update_stay_still_switch(bool enable) {
-    // Frame structure (10 bytes total):
-    // Header (2) + Control (1) + Command (1) + Length (2) + Payload (1) + Check (1) + Tail (2)
-    uint8_t frame[10];
-    frame[0] = FRAME_HEADER0;   // 0x53
-    frame[1] = FRAME_HEADER1;   // 0x59
-    frame[2] = 0x83;            // Control for fall detection / stay-still
-    frame[3] = 0x0B;            // Command for stay-still switch
-    frame[4] = 0x00;            // Length high byte
-    frame[5] = 0x01;            // Length low byte (1 byte payload)
-    frame[6] = enable ? 0x01 : 0x00; // Payload: 0x01 to enable, 0x00 to disable
-
-    // Calculate checksum: sum of bytes [0..6], take lower 8 bits
-    uint32_t sum = 0;
-    for (int i = 0; i < 7; i++) {
-        sum += frame[i];
-    }
-    frame[7] = sum & 0xFF;
-
-    // Append tail
-    frame[8] = FRAME_TAIL0;    // 0x54
-    frame[9] = FRAME_TAIL1;    // 0x43
-
-    // Send frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_stay_still_switch(frame, sizeof(frame), enable);
+    request_setting(SETTING_STAY_STILL_SWITCH, frame, len, (setting_value_t){ .flag = enable });
     printf("Stay-Still Alarm %s\n", enable ? "ENABLED" : "DISABLED");
-    
-    // Update global variable
-    g_stay_still_switch = enable;
 }
 
 // Function to update the stay-still duration setting on the radar device
@@ -1514,84 +1683,10 @@ void update_stay_still_duration(uint32_t new_duration) {
         new_duration = 3600;
     }
 
-    uint8_t frame[13] = {
-        FRAME_HEADER0, FRAME_HEADER1,
-        0x83, 0x0A, 0x00, 0x04,
-        (new_duration >> 24) & 0xFF,
-        (new_duration >> 16) & 0xFF,
-        (new_duration >> 8) & 0xFF,
-        new_duration & 0xFF,
-        0x00, // placeholder for checksum
-        FRAME_TAIL0,
-        FRAME_TAIL1
-    };
-
-    uint32_t sum = 0;
-    for (int i = 0; i < 10; i++) sum += frame[i];
-    frame[10] = sum & 0xFF;
-
-    // Update global variable before sending UART command
-    g_stay_still_duration = new_duration;
-
-    // Send UART command
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_stay_still_duration(frame, sizeof(frame), new_duration);
+    request_setting(SETTING_STAY_STILL_DURATION, frame, len, (setting_value_t){ .u32 = new_duration });
     printf("Sent Stay-still Duration update: %" PRIu32 " seconds\n", new_duration);
-
-    // Add a small delay to ensure UART transmission is complete
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    // Check if MQTT client is initialized before publishing
-    if (mqtt_client != NULL) {
-        mqtt_publish_settings();
-    }
-}
-
-// This task periodically sends product information queries.
-void product_info_query_task(void *arg)
-{
-    while(1) {
-        // Query Product Model (control 0x02, command 0xA1)
-        send_query(0x02, 0xA1, 0x0F);
-        printf("Sent Product Model Query\n");
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        // Query Product ID (control 0x02, command 0xA2)
-        send_query(0x02, 0xA2, 0x0F);
-        printf("Sent Product ID Query\n");
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        // Query Hardware Model (control 0x02, command 0xA3)
-        send_query(0x02, 0xA3, 0x0F);
-        printf("Sent Hardware Model Query\n");
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        // Query Firmware Version (control 0x02, command 0xA4)
-        send_query(0x02, 0xA4, 0x0F);
-        printf("Sent Firmware Version Query\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-    }
-}
-
-// ---------------------- New: Height Proportion Query Task ----------------------
-// This task periodically sends a query for height proportion data.
-// Expected response: control 0x83, command 0x0E, payload length 6.
-void height_proportion_query_task(void *arg)
-{
-    while(1) {
-        send_query(0x83, 0x0E, 0x0F); // Adjust data payload as per device spec
-        printf("Sent Height Proportion Query\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-    }
-}
-
-// ---------------------- New: Height Proportion Period Query Task ----------------------
-// This task periodically sends a query for height proportion over a period of time.
-// Expected query: control 0x83, command 0x8E, with 1-byte payload (example: 0x0F).
-void height_proportion_period_query_task(void *arg)
-{
-    while(1) {
-        // Send query frame with control 0x83 and command 0x8E.
-        send_query(0x83, 0x8E, 0x0F); // Adjust the payload (0x0F) as per your device specification.
-        printf("Sent Height Proportion Period Query\n");
-        vTaskDelay(pdMS_TO_TICKS(5000));  // Adjust the query interval as needed
-    }
 }
 
 // ---------------------- Wi-Fi Configuration ----------------------
@@ -1695,38 +1790,11 @@ void wifi_init_sta(void)
 
 // New: Function to update installation angles.
 void update_installation_angles(int16_t angle_x, int16_t angle_y, int16_t angle_z) {
-    // Frame structure:
-    // HEADER (2 bytes) + CONTROL (1) + COMMAND (1) + LENGTH (2) + PAYLOAD (6 bytes) + CHECK (1) + TAIL (2) = 15 bytes.
-    uint8_t frame[15];
-    frame[0] = FRAME_HEADER0;
-    frame[1] = FRAME_HEADER1;
-    frame[2] = 0x06;   // Control for installation configuration.
-    frame[3] = 0x01;   // Command for installation angle update.
-    frame[4] = 0x00;
-    frame[5] = 0x06;   // 6-byte payload.
-    // Payload: 16-bit signed values (big-endian)
-    frame[6]  = (angle_x >> 8) & 0xFF;
-    frame[7]  = angle_x & 0xFF;
-    frame[8]  = (angle_y >> 8) & 0xFF;
-    frame[9]  = angle_y & 0xFF;
-    frame[10] = (angle_z >> 8) & 0xFF;
-    frame[11] = angle_z & 0xFF;
-    // Calculate checksum over bytes 0 to 11.
-    uint32_t sum = 0;
-    for (int i = 0; i < 12; i++) {
-        sum += frame[i];
-    }
-    frame[12] = sum & 0xFF;
-    frame[13] = FRAME_TAIL0;
-    frame[14] = FRAME_TAIL1;
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_installation_angles(frame, sizeof(frame), angle_x, angle_y, angle_z);
+    request_setting(SETTING_INSTALLATION_ANGLES, frame, len, (setting_value_t){ .angles = { angle_x, angle_y, angle_z } });
     printf("Sent Installation Angles update: X=%d, Y=%d, Z=%d\n", angle_x, angle_y, angle_z);
     
-    // Optionally update the global variables.
-    g_installation_angle_x = angle_x;
-    g_installation_angle_y = angle_y;
-    g_installation_angle_z = angle_z;
-    
     // Publish updated settings
     // mqtt_publish_settings();
 }
@@ -1734,36 +1802,16 @@ void update_installation_angles(int16_t angle_x, int16_t angle_y, int16_t angle_
 // Function to publish product information to MQTT
 void mqtt_publish_product_info(void)
 {
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        printf("Error creating product info JSON object\n");
-        return;
-    }
-    
-    // Add device identification
-    cJSON_AddStringToObject(json, "device_id", g_device_id);
-    cJSON_AddStringToObject(json, "device_type", DEVICE_TYPE);
-    
-    // Add product information
-    cJSON_AddStringToObject(json, "product_model", g_product_model);
-    cJSON_AddStringToObject(json, "product_id", g_product_id);
-    cJSON_AddStringToObject(json, "hardware_model", g_hardware_model);
-    cJSON_AddStringToObject(json, "firmware_version", g_firmware_version);
-    
-    // Add operating time
-    cJSON_AddNumberToObject(json, "operating_time", g_operating_time);
-    
-    char *json_str = cJSON_Print(json);
-    if (json_str) {
-        int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_INFO, json_str, 0, 1, 0);
+    char json[PRODUCT_INFO_JSON_MAX];
+    size_t len = build_product_info_json(json, sizeof(json), true);
+    if (len > 0) {
+        int msg_id = mqtt_publish(MQTT_TOPIC_INFO, json, len, 1);
         if (msg_id != -1) {
             printf("Published product info to %s\n", MQTT_TOPIC_INFO);
         } else {
             printf("Failed to publish product info\n");
         }
-        free(json_str);
     }
-    cJSON_Delete(json);
 }
 
 // Function to initialize default settings on the radar device
@@ -1772,279 +1820,117 @@ void init_default_settings(void) {
     
     // Enable human presence detection first
     enable_human_presence_detection(true);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default installation angles (0, 0, 0)
     update_installation_angles(0, 0, 0);
-    vTaskDelay(pdMS_TO_TICKS(200)); // Small delay between commands
     
     // Set default installation height (200 cm)
     update_installation_height(200);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default fall detection sensitivity (3)
     update_fall_detection_sensitivity(3);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default fall duration (5 seconds)
     update_fall_duration(5);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default fall breaking height (20 cm)
     update_fall_breaking_height(20);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default sitting still distance (300 cm)
     update_sitting_still_distance(300);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default moving distance (30 cm)
     update_moving_distance(30);
     
     // Set default stay-still duration (300 seconds = 5 minutes)
     update_stay_still_duration(60);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Enable fall detection by default
     update_fall_detection_switch(true);
-    vTaskDelay(pdMS_TO_TICKS(200));
 
     // Set default non-presence time (300 seconds = 5 minutes)
     update_non_presence_time(5);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Set default height accumulation time (60 seconds = 1 minute)
     update_height_accumulation_time(60);
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     printf("Default settings initialized\n");
 }
 
-// Function to save current settings to NVS
-void save_settings_to_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("radar_config", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        printf("Error opening NVS handle: %s\n", esp_err_to_name(err));
-        return;
-    }
-
-    // Individual error checking for each setting
-    err = nvs_set_i16(nvs_handle, "angle_x", g_installation_angle_x);
-    if (err != ESP_OK) printf("Error saving angle_x: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_i16(nvs_handle, "angle_y", g_installation_angle_y);
-    if (err != ESP_OK) printf("Error saving angle_y: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_i16(nvs_handle, "angle_z", g_installation_angle_z);
-    if (err != ESP_OK) printf("Error saving angle_z: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u16(nvs_handle, "inst_height", g_installation_height);
-    if (err != ESP_OK) printf("Error saving inst_height: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u8(nvs_handle, "fall_sens", g_fall_detection_sensitivity);
-    if (err != ESP_OK) printf("Error saving fall_sens: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u32(nvs_handle, "fall_dur", g_fall_duration);
-    if (err != ESP_OK) printf("Error saving fall_dur: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u16(nvs_handle, "fall_height", g_fall_breaking_height);
-    if (err != ESP_OK) printf("Error saving fall_height: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u16(nvs_handle, "still_dist", g_sitting_still_distance);
-    if (err != ESP_OK) printf("Error saving still_dist: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u16(nvs_handle, "move_dist", g_moving_distance);
-    if (err != ESP_OK) printf("Error saving move_dist: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u8(nvs_handle, "still_switch", g_stay_still_switch ? 1 : 0);
-    if (err != ESP_OK) printf("Error saving still_switch: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u32(nvs_handle, "still_dur", g_stay_still_duration);
-    if (err != ESP_OK) printf("Error saving still_dur: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u8(nvs_handle, "fall_switch", g_fall_detection_switch ? 1 : 0);
-    if (err != ESP_OK) printf("Error saving fall_switch: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u32(nvs_handle, "non_p_time", g_non_presence_time);
-    if (err != ESP_OK) printf("Error saving non_presence_time: %s\n", esp_err_to_name(err));
-    
-    err = nvs_set_u32(nvs_handle, "h_acc_t", g_height_accumulation_time);
-    if (err != ESP_OK) printf("Error saving height_accumulation_time: %s\n", esp_err_to_name(err));
-
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        printf("Error committing NVS changes: %s\n", esp_err_to_name(err));
-    } else {
-        printf("Settings saved to NVS successfully\n");
-    }
-
-    nvs_close(nvs_handle);
+// Current values of every persisted setting, for the settings store
+static void settings_snapshot(settings_values_t *out)
+{
+    radar_state_t st;
+    radar_state_snapshot(&st);
+    out->installation_angle_x = st.installation_angle_x;
+    out->installation_angle_y = st.installation_angle_y;
+    out->installation_angle_z = st.installation_angle_z;
+    out->installation_height = st.installation_height;
+    out->fall_detection_sensitivity = st.fall_detection_sensitivity;
+    out->fall_duration = st.fall_duration;
+    out->fall_breaking_height = st.fall_breaking_height;
+    out->sitting_still_distance = st.sitting_still_distance;
+    out->moving_distance = st.moving_distance;
+    out->stay_still_switch = st.stay_still_switch;
+    out->stay_still_duration = st.stay_still_duration;
+    out->fall_detection_switch = st.fall_detection_switch;
+    out->non_presence_time = st.non_presence_time;
+    out->height_accumulation_time = st.height_accumulation_time;
+    out->live_format = g_live_format;
 }
 
-// Improved function to load settings from NVS
-void load_settings_from_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("radar_config", NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        printf("Error opening NVS handle: %s\n", esp_err_to_name(err));
-        printf("Using default settings instead\n");
-        init_default_settings();
-        return;
-    }
-
-    bool at_least_one_failed = false;
-    
-    // Temp variables with defaults pre-set
-    int16_t angle_x = 0, angle_y = 0, angle_z = 0;
-    uint16_t inst_height = 200, fall_height = 20, still_dist = 300, move_dist = 30;
-    uint8_t fall_sens = 3, still_switch = 0, fall_switch = 1;
-    uint32_t fall_dur = 5, still_dur = 60, non_p_time = 5, h_acc_t = 60;
-    
-    // Load all values with individual error checking
-    err = nvs_get_i16(nvs_handle, "angle_x", &angle_x);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading angle_x: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_i16(nvs_handle, "angle_y", &angle_y);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading angle_y: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    // ... repeat for all other parameters with similar error checking ...
-    
-    err = nvs_get_i16(nvs_handle, "angle_z", &angle_z);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading angle_z: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u16(nvs_handle, "inst_height", &inst_height);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading inst_height: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u8(nvs_handle, "fall_sens", &fall_sens);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading fall_sens: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u32(nvs_handle, "fall_dur", &fall_dur);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading fall_dur: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u16(nvs_handle, "fall_height", &fall_height);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading fall_height: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u16(nvs_handle, "still_dist", &still_dist);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading still_dist: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u16(nvs_handle, "move_dist", &move_dist);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading move_dist: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u8(nvs_handle, "still_switch", &still_switch);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading still_switch: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u32(nvs_handle, "still_dur", &still_dur);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading still_dur: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u8(nvs_handle, "fall_switch", &fall_switch);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading fall_switch: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u32(nvs_handle, "non_p_time", &non_p_time);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading non_p_time: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
-    
-    err = nvs_get_u32(nvs_handle, "h_acc_t", &h_acc_t);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Error reading h_acc_t: %s\n", esp_err_to_name(err));
-        at_least_one_failed = true;
-    }
+// Load the settings blob (one NVS read) and seed the radar state with it.
+// Runs before the UART reader starts, while app_main is the state's writer.
+// Returns false if nothing was stored.
+bool load_settings_from_nvs(void) {
+    settings_values_t v;
+    if (!settings_store_load(&v)) {
+        return false;
+    }
+    printf("Settings loaded successfully from NVS\n");
+
+    // Start from the stored values (only confirmed settings are saved); the
+    // radar's replies to apply_settings_to_radar() overwrite them if it disagrees.
+    radar_state_t *st = radar_state_edit();
+    st->installation_angle_x = v.installation_angle_x;
+    st->installation_angle_y = v.installation_angle_y;
+    st->installation_angle_z = v.installation_angle_z;
+    st->installation_height = v.installation_height;
+    st->fall_detection_sensitivity = v.fall_detection_sensitivity;
+    st->fall_duration = v.fall_duration;
+    st->fall_breaking_height = v.fall_breaking_height;
+    st->sitting_still_distance = v.sitting_still_distance;
+    st->moving_distance = v.moving_distance;
+    st->stay_still_switch = v.stay_still_switch;
+    st->stay_still_duration = v.stay_still_duration;
+    st->fall_detection_switch = v.fall_detection_switch;
+    st->non_presence_time = v.non_presence_time;
+    st->height_accumulation_time = v.height_accumulation_time;
+    radar_state_publish();
+    g_live_format = (v.live_format & LIVE_FORMAT_BOTH) ? (v.live_format & LIVE_FORMAT_BOTH) : LIVE_FORMAT_JSON;
+    return true;
+}
 
-    nvs_close(nvs_handle);
-    
-    if (at_least_one_failed) {
-        printf("Some settings could not be loaded from NVS, using available values\n");
-    } else {
-        printf("Settings loaded successfully from NVS\n");
-    }
+// Send the seeded settings to the radar (the command scheduler paces the UART
+// writes). Replies are matched by the UART reader, so it must be running.
+void apply_settings_to_radar(void) {
+    radar_state_t st;
+    radar_state_snapshot(&st);
 
-    // Apply loaded settings to the radar
     printf("Applying settings...\n");
-    
-    // Store values in global variables
-    g_non_presence_time = non_p_time;
-    g_height_accumulation_time = h_acc_t;
-    
-    // Apply settings to device with small delays between commands
     enable_human_presence_detection(true);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_installation_angles(angle_x, angle_y, angle_z);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    // ... apply other settings similarly ...
-    update_installation_height(inst_height);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_fall_detection_sensitivity(fall_sens);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_fall_duration(fall_dur);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_fall_breaking_height(fall_height);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_sitting_still_distance(still_dist);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_moving_distance(move_dist);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_stay_still_switch(still_switch);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_stay_still_duration(still_dur);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_fall_detection_switch(fall_switch);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_height_accumulation_time(h_acc_t);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    update_non_presence_time(non_p_time);
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
+    update_installation_angles(st.installation_angle_x, st.installation_angle_y, st.installation_angle_z);
+    update_installation_height(st.installation_height);
+    update_fall_detection_sensitivity(st.fall_detection_sensitivity);
+    update_fall_duration(st.fall_duration);
+    update_fall_breaking_height(st.fall_breaking_height);
+    update_sitting_still_distance(st.sitting_still_distance);
+    update_moving_distance(st.moving_distance);
+    update_stay_still_switch(st.stay_still_switch);
+    update_stay_still_duration(st.stay_still_duration);
+    update_fall_detection_switch(st.fall_detection_switch);
+    update_height_accumulation_time(st.height_accumulation_time);
+    update_non_presence_time(st.non_presence_time);
     printf("Settings applied successfully\n");
 }
 
@@ -2106,11 +1992,9 @@ void init_height_detection(void) {
     
     // Send a smaller value first to get faster results
     update_height_accumulation_time(30);  // 30 seconds instead of 60
-    vTaskDelay(pdMS_TO_TICKS(200));
     
     // Force a height proportion request immediately
     send_query(0x83, 0x0E, 0x0F);
-    vTaskDelay(pdMS_TO_TICKS(100));
     send_query(0x83, 0x8E, 0x0F);
     
     printf("Height detection parameters initialized\n");
@@ -2163,6 +2047,69 @@ void load_device_id_from_nvs() {
     }
 }
 
+// Metrics kept in other modules' own stats, copied in before each export
+static void collect_radar_metrics(void)
+{
+    const radar_decoder_stats_t *dec = &s_radar_decoder.stats;
+    metrics_set(METRIC_RADAR_FRAMES, (int32_t)dec->frames);
+    metrics_set(METRIC_RADAR_CHECKSUM_ERRORS, (int32_t)dec->checksum_errors);
+    metrics_set(METRIC_RADAR_TAIL_ERRORS, (int32_t)dec->tail_errors);
+    metrics_set(METRIC_RADAR_LENGTH_ERRORS, (int32_t)dec->length_errors);
+    metrics_set(METRIC_RADAR_RESYNCS, (int32_t)dec->resyncs);
+    metrics_set(METRIC_RADAR_BYTES_DISCARDED, (int32_t)dec->bytes_discarded);
+
+    radar_cmd_stats_t cmd;
+    radar_cmd_get_stats(&cmd);
+    metrics_set(METRIC_RADAR_CMD_SENT, (int32_t)cmd.sent);
+    metrics_set(METRIC_RADAR_CMD_TIMEOUTS, (int32_t)cmd.timeouts);
+    metrics_set(METRIC_RADAR_CMD_FAILED, (int32_t)cmd.failed);
+}
+
+static void collect_mqtt_metrics(void)
+{
+    mqtt_inbox_stats_t inbox;
+    mqtt_inbox_get_stats(&inbox);
+    metrics_set(METRIC_MQTT_INBOX_RECEIVED, (int32_t)inbox.received);
+    metrics_set(METRIC_MQTT_INBOX_DROPPED,
+                (int32_t)(inbox.dropped_full + inbox.dropped_oversize + inbox.dropped_partial));
+    metrics_set(METRIC_MQTT_INBOX_QUEUED, inbox.queued);
+    metrics_set(METRIC_MQTT_INBOX_HIGH_WATER, inbox.high_water);
+    metrics_set(METRIC_MQTT_OUTBOX_BYTES, mqtt_client ? esp_mqtt_client_get_outbox_size(mqtt_client) : 0);
+
+    live_journal_stats_t journal;
+    live_journal_get_stats(&journal);
+    metrics_set(METRIC_JOURNAL_APPENDED, (int32_t)journal.appended);
+    metrics_set(METRIC_JOURNAL_DROPPED, (int32_t)journal.dropped);
+    metrics_set(METRIC_JOURNAL_PENDING, (int32_t)journal.pending);
+}
+
+static void collect_wifi_metrics(void)
+{
+    wm_connect_stats_t wifi;
+    wifiManager_get_connect_stats(&wifi);
+    metrics_set(METRIC_WIFI_RECONNECTS, wifi.reconnects);
+    metrics_set(METRIC_WIFI_FALLBACKS, wifi.fallbacks);
+    metrics_set(METRIC_WIFI_CONNECT_MS, (int32_t)wifi.connect_ms);
+    metrics_set(METRIC_WIFI_BOOT_MS, (int32_t)wifi.boot_ms);
+
+    wifi_ap_record_t ap;
+    metrics_set(METRIC_WIFI_RSSI, esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0);
+}
+
+static bool publish_metrics(const char *json, size_t len)
+{
+    if (mqtt_client == NULL || !s_mqtt_connected) {
+        return false;
+    }
+    return mqtt_publish(mqtt_topic_metrics, json, (int)len, 0) >= 0;
+}
+
+// GET /metrics on the wifiManager HTTP server
+static size_t render_metrics_http(char *buf, size_t len)
+{
+    return metrics_to_json(buf, len, true);
+}
+
 // Main entry point
 void app_main(void)
 {
@@ -2179,14 +2126,67 @@ void app_main(void)
     snprintf(mqtt_topic_info_device_id, sizeof(mqtt_topic_info_device_id), "%s/info", g_device_id);
     snprintf(mqtt_topic_settings_state_device_id, sizeof(mqtt_topic_settings_state_device_id), "%s/settings_state", g_device_id);
     snprintf(mqtt_topic_ota_update, sizeof(mqtt_topic_ota_update), "%s/ota_update", g_device_id);
+    snprintf(mqtt_topic_ota_status, sizeof(mqtt_topic_ota_status), "%s/ota_status", g_device_id);
+    snprintf(mqtt_topic_metrics, sizeof(mqtt_topic_metrics), "%s/metrics", g_device_id);
+    snprintf(mqtt_topic_log_level, sizeof(mqtt_topic_log_level), "%s/log_level", g_device_id);
+    snprintf(mqtt_topic_tasks_request, sizeof(mqtt_topic_tasks_request), "%s/tasks_request", g_device_id);
+    snprintf(mqtt_topic_tasks, sizeof(mqtt_topic_tasks), "%s/tasks", g_device_id);
+    snprintf(mqtt_topic_bench_request, sizeof(mqtt_topic_bench_request), "%s/bench_request", g_device_id);
+    snprintf(mqtt_topic_bench, sizeof(mqtt_topic_bench), "%s/bench", g_device_id);
     snprintf(mqtt_topic_live, sizeof(mqtt_topic_live), "R60AFD1/live");
+    snprintf(mqtt_topic_live_bin, sizeof(mqtt_topic_live_bin), "R60AFD1/live_bin");
+    snprintf(mqtt_topic_journal, sizeof(mqtt_topic_journal), "%s/journal", g_device_id);
+    snprintf(mqtt_topic_track_request, sizeof(mqtt_topic_track_request), "%s/track_request", g_device_id);
+    snprintf(mqtt_topic_track, sizeof(mqtt_topic_track), "%s/track", g_device_id);
+
+    // OTA progress reporting; arms the rollback timer on the first boot of a new image
+    ota_update_init(publish_ota_status);
+
+    // Trajectory history (filled by the UART parser)
+    track_buffer_init();
+    s_track_lock = xSemaphoreCreateMutex();
+
+    // settings_state payloads: cached snapshot and the base for deltas
+    s_settings_json_lock = xSemaphoreCreateMutex();
+    s_settings_pub.boot = esp_random();
+
+    // Radar frames are printed by a low-priority task, never by the UART task
+    radar_log_init();
 
     // Initialize UART for communication with the radar module
     init_uart();
+    radar_cmd_init(UART_PORT_NUM);
+    settings_commit_init();
+    settings_store_init(settings_snapshot);
+
+    // Seed the radar state from NVS while app_main is still its only writer
+    bool have_stored = load_settings_from_nvs();
+
+    // Reading/parsing UART data heads the alarm pipeline (task_priorities.h).
+    // It also matches the radar's replies, so it starts before any setting is sent.
+    xTaskCreate(uart_read_task, "uart_read_task", 4096, NULL, TASK_PRIO_UART_READ, NULL);
     
-    // Load settings from NVS (or use defaults if not found)
-    load_settings_from_nvs();
+    // Send the stored settings (or the defaults); the confirmed values are
+    // saved once every write has been answered
+    if (have_stored) {
+        apply_settings_to_radar();
+    } else {
+        printf("Using default settings instead\n");
+        init_default_settings();
+    }
+    request_settings_commit();
     
+    // Offline store-and-forward for live data (drains once MQTT connects)
+    live_journal_init(publish_journal_batch);
+
+    // Runtime metrics: collectors for module stats, /metrics on the wifiManager HTTP server
+    metrics_add_collector(collect_radar_metrics);
+    metrics_add_collector(collect_mqtt_metrics);
+    metrics_add_collector(collect_wifi_metrics);
+    wifiManager_add_status_endpoint("/metrics", render_metrics_http);
+    // Per-task report every CONFIG_TASK_PROFILE_INTERVAL_S (publish_tasks skips it while offline)
+    task_profile_start(publish_tasks);
+
     // Start WiFiManager (AP + Web Portal)
     wifiManager_init();
     
@@ -2196,31 +2196,19 @@ void app_main(void)
     // เมื่อเชื่อมต่อ Wi-Fi ได้แล้ว ค่อยเริ่ม MQTT และ sensor task
     mqtt_init();
     mqtt_publish_product_info();
-    mqtt_publish_settings();
+    mqtt_publish_settings(true);
+    metrics_start(publish_metrics);
     
-    // Create tasks: one for reading/parsing UART data, one for printing live data JSON, one for settings JSON, one for product info JSON, and one for settings read
-    xTaskCreate(uart_read_task, "uart_read_task", 4096, NULL, 10, NULL);
-    xTaskCreate(live_json_print_task, "live_json_print_task", 4096, NULL, 10, NULL);
-    xTaskCreate(settings_json_print_task, "settings_json_print_task", 4096, NULL, 10, NULL);
-    xTaskCreate(product_info_json_print_task, "product_info_json_print_task", 4096, NULL, 10, NULL);
-    xTaskCreate(usage_json_print_task, "usage_json_print_task", 4096, NULL, 10, NULL);
-    xTaskCreate(settings_read_task, "settings_read_task", 2048, NULL, 10, NULL);
-    xTaskCreate(product_info_query_task, "product_info_query_task", 2048, NULL, 10, NULL);
-    xTaskCreate(height_proportion_query_task, "height_proportion_query_task", 2048, NULL, 10, NULL);
-    xTaskCreate(height_proportion_period_query_task, "height_proportion_period_query_task", 2048, NULL, 10, NULL);
+#if CONFIG_DIAG_PRINT_JSON
+    xTaskCreate(diag_print_task, "diag_print", 4096, NULL, TASK_PRIO_DIAG_PRINT, NULL);
+#endif
+    start_radar_polling();
     
-    // Add the new MQTT publish task
-    xTaskCreate(mqtt_publish_task, "mqtt_publish_task", 4096, NULL, 10, NULL);
-    xTaskCreate(heartbeat_task, "heartbeat_task", 2048, NULL, 10, NULL);  // Add heartbeat task
+    // Publish live data when the parser reports changes (plus a keepalive snapshot)
+    live_publisher_start(publish_live_snapshot);
     
     // Initialize height detection separately after other settings
     init_height_detection();
-    
-    // Create and start height proportion query task
-    xTaskCreate(height_proportion_query_task, "height_prop_query", 2048, NULL, 5, NULL);
-    
-    // If your app_main doesn't already have this task creation, add it
-    xTaskCreate(height_proportion_period_query_task, "height_period_query", 2048, NULL, 5, NULL);
 
     // ตัวอย่างการเรียก OTA (แนะนำให้เรียกเมื่อได้รับคำสั่งจาก MQTT หรือปุ่ม ไม่ควรเรียกทันทีหลังบูต)
     // ota_update_start("http://192.168.1.58:8000/esp32-R60AFD1.bin");
@@ -2228,35 +2216,17 @@ void app_main(void)
     // ota_update_start("http://192.168.1.58:8000/esp32-R60AFD1.bin");
 
     // ใน app_main() ให้เพิ่มการสร้าง task นี้
-    xTaskCreate(wifi_reset_button_task, "wifi_reset_button_task", 2048, NULL, 5, NULL);
+    xTaskCreate(wifi_reset_button_task, "wifi_reset_button_task", 2048, NULL, TASK_PRIO_RESET_BUTTON, NULL);
+
+    // Console keys: 'r' working status, 't' task profile
+    xTaskCreate(key_read_task, "key_read_task", 3072, NULL, TASK_PRIO_KEY_READ, NULL);
 }
 
 // Add this function implementation with the other command functions
 void enable_human_presence_detection(bool enable) {
-    // Frame structure (10 bytes total):
-    // Header (2) + Control (1) + Command (1) + Length (2) + Payload (1) + Check (1) + Tail (2)
-    uint8_t frame[10];
-    frame[0] = FRAME_HEADER0;   // 0x53
-    frame[1] = FRAME_HEADER1;   // 0x59
-    frame[2] = 0x80;            // Control for sensor data settings
-    frame[3] = 0x00;            // Command for human presence detection
-    frame[4] = 0x00;            // Length high byte
-    frame[5] = 0x01;            // Length low byte (1 byte payload)
-    frame[6] = enable ? 0x01 : 0x00; // Payload: 0x01 to enable, 0x00 to disable
-
-    // Calculate checksum
-    uint32_t sum = 0;
-    for (int i = 0; i < 7; i++) {
-        sum += frame[i];
-    }
-    frame[7] = sum & 0xFF;
-
-    // Append tail
-    frame[8] = FRAME_TAIL0;    // 0x54
-    frame[9] = FRAME_TAIL1;    // 0x43
-
-    // Send frame via UART
-    uart_write_bytes(UART_PORT_NUM, (const char*)frame, sizeof(frame));
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    size_t len = radar_encode_presence_detection(frame, sizeof(frame), enable);
+    request_setting(SETTING_PRESENCE_DETECTION, frame, len, (setting_value_t){ .flag = enable });
     printf("Human Presence Detection %s\n", enable ? "ENABLED" : "DISABLED");
 }
 
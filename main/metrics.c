@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "metrics.h"
+#include "json_writer.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_METRICS_PUBLISH_INTERVAL_S
+#define CONFIG_METRICS_PUBLISH_INTERVAL_S 60
+#endif
+#ifndef CONFIG_METRICS_JSON_MAX
+#define CONFIG_METRICS_JSON_MAX 1536
+#endif
+
+#define MAX_COLLECTORS  8
+
+static const char *TAG = "metrics";
+
+static const char *const s_names[METRIC_COUNT] = {
+    [METRIC_UART_BYTES]             = "uart.bytes",
+    [METRIC_UART_OVERFLOWS]         = "uart.overflows",
+    [METRIC_RADAR_FRAMES]           = "radar.frames",
+    [METRIC_RADAR_CHECKSUM_ERRORS]  = "radar.checksum_errors",
+    [METRIC_RADAR_TAIL_ERRORS]      = "radar.tail_errors",
+    [METRIC_RADAR_LENGTH_ERRORS]    = "radar.length_errors",
+    [METRIC_RADAR_RESYNCS]          = "radar.resyncs",
+    [METRIC_RADAR_BYTES_DISCARDED]  = "radar.bytes_discarded",
+    [METRIC_RADAR_UNKNOWN_FRAMES]   = "radar.unknown_frames",
+    [METRIC_RADAR_LOG_DROPPED]      = "radar.log_dropped",
+    [METRIC_RADAR_CMD_SENT]         = "radar.cmd_sent",
+    [METRIC_RADAR_CMD_TIMEOUTS]     = "radar.cmd_timeouts",
+    [METRIC_RADAR_CMD_FAILED]       = "radar.cmd_failed",
+    [METRIC_MQTT_PUBLISHED]         = "mqtt.published",
+    [METRIC_MQTT_PUBLISH_FAILURES]  = "mqtt.publish_failures",
+    [METRIC_MQTT_DISCONNECTS]       = "mqtt.disconnects",
+    [METRIC_MQTT_INBOX_RECEIVED]    = "mqtt.inbox_received",
+    [METRIC_MQTT_INBOX_DROPPED]     = "mqtt.inbox_dropped",
+    [METRIC_JOURNAL_APPENDED]       = "journal.appended",
+    [METRIC_JOURNAL_DROPPED]        = "journal.dropped",
+    [METRIC_WIFI_RECONNECTS]        = "wifi.reconnects",
+    [METRIC_WIFI_FALLBACKS]         = "wifi.fallbacks",
+    [METRIC_OTA_STARTED]            = "ota.started",
+    [METRIC_OTA_RETRIES]            = "ota.retries",
+    [METRIC_OTA_FAILURES]           = "ota.failures",
+    [METRIC_OTA_REFUSED]            = "ota.refused",
+    [METRIC_HEAP_FREE]              = "heap.free",
+    [METRIC_HEAP_MIN_FREE]          = "heap.min_free",
+    [METRIC_HEAP_LARGEST_BLOCK]     = "heap.largest_block",
+    [METRIC_HEAP_FRAGMENTATION]     = "heap.fragmentation_pct",
+    [METRIC_MQTT_INBOX_QUEUED]      = "mqtt.inbox_queued",
+    [METRIC_MQTT_INBOX_HIGH_WATER]  = "mqtt.inbox_high_water",
+    [METRIC_MQTT_OUTBOX_BYTES]      = "mqtt.outbox_bytes",
+    [METRIC_JOURNAL_PENDING]        = "journal.pending",
+    [METRIC_WIFI_RSSI]              = "wifi.rssi",
+    [METRIC_WIFI_CONNECT_MS]        = "wifi.connect_ms",
+    [METRIC_WIFI_BOOT_MS]           = "wifi.boot_ms",
+    [METRIC_OTA_BYTES]              = "ota.bytes",
+};
+
+typedef struct {
+    const char *name;
+    uint8_t bounds_count;
+    uint32_t bounds[METRIC_HIST_MAX_BUCKETS - 1];  // upper bounds (inclusive), ascending
+} hist_def_t;
+
+static const hist_def_t s_hist_defs[METRIC_HIST_COUNT] = {
+    [METRIC_HIST_RADAR_FRAME_US]  = { "radar.frame_us", 6, { 100, 250, 500, 1000, 5000, 20000 } },
+    [METRIC_HIST_MQTT_PUBLISH_US] = { "mqtt.publish_us", 6, { 1000, 5000, 20000, 100000, 500000, 2000000 } },
+    [METRIC_HIST_LIVE_EVENT_US]   = { "live.event_us", 6, { 100, 500, 1000, 5000, 20000, 100000 } },
+    [METRIC_HIST_LIVE_ALARM_US]   = { "live.alarm_us", 7, { 1000, 5000, 10000, 20000, 50000, 100000, 500000 } },
+};
+
+typedef struct {
+    atomic_uint_least32_t counts[METRIC_HIST_MAX_BUCKETS];
+    atomic_uint_least32_t sum;      // wraps; consumers use differences
+} hist_t;
+
+static atomic_uint_least32_t s_values[METRIC_COUNT];
+static hist_t s_hists[METRIC_HIST_COUNT];
+
+static metrics_collector_t s_collectors[MAX_COLLECTORS];
+static atomic_uint s_collector_count;
+
+void metrics_inc(metric_id_t id)
+{
+    atomic_fetch_add_explicit(&s_values[id], 1, memory_order_relaxed);
+}
+
+void metrics_add(metric_id_t id, uint32_t n)
+{
+    atomic_fetch_add_explicit(&s_values[id], n, memory_order_relaxed);
+}
+
+void metrics_set(metric_id_t id, int32_t value)
+{
+    atomic_store_explicit(&s_values[id], (uint32_t)value, memory_order_relaxed);
+}
+
+int32_t metrics_get(metric_id_t id)
+{
+    return (int32_t)atomic_load_explicit(&s_values[id], memory_order_relaxed);
+}
+
+void metrics_observe(metric_hist_id_t id, uint32_t value)
+{
+    const hist_def_t *def = &s_hist_defs[id];
+    uint8_t bucket = 0;
+    while (bucket < def->bounds_count && value > def->bounds[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&s_hists[id].counts[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_hists[id].sum, value, memory_order_relaxed);
+}
+
+void metrics_add_collector(metrics_collector_t collect)
+{
+    unsigned n = atomic_load(&s_collector_count);
+    if (n >= MAX_COLLECTORS) {
+        ESP_LOGE(TAG, "Too many collectors");
+        return;
+    }
+    s_collectors[n] = collect;
+    atomic_store(&s_collector_count, n + 1);
+}
+
+static void collect_heap(void)
+{
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    metrics_set(METRIC_HEAP_FREE, (int32_t)free_bytes);
+    metrics_set(METRIC_HEAP_MIN_FREE, (int32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    metrics_set(METRIC_HEAP_LARGEST_BLOCK, (int32_t)largest);
+    // Free memory that cannot be had in one piece
+    metrics_set(METRIC_HEAP_FRAGMENTATION, free_bytes ? (int32_t)(100 - (uint64_t)largest * 100 / free_bytes) : 0);
+}
+
+static void collect_all(void)
+{
+    collect_heap();
+    unsigned n = atomic_load(&s_collector_count);
+    for (unsigned i = 0; i < n; i++) {
+        s_collectors[i]();
+    }
+}
+
+static void write_value(json_writer_t *w, metric_id_t id)
+{
+    if (id < METRIC_COUNTER_COUNT) {
+        json_writer_uint(w, s_names[id], (uint32_t)metrics_get(id));
+    } else {
+        json_writer_int(w, s_names[id], metrics_get(id));
+    }
+}
+
+static void write_counts(json_writer_t *w, const char *key, metric_hist_id_t id)
+{
+    const hist_def_t *def = &s_hist_defs[id];
+    json_writer_begin_array(w, key);
+    for (uint8_t b = 0; b <= def->bounds_count; b++) {
+        json_writer_uint(w, NULL, atomic_load_explicit(&s_hists[id].counts[b], memory_order_relaxed));
+    }
+    json_writer_end_array(w);
+}
+
+size_t metrics_to_json(char *buf, size_t len, bool verbose)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+    uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    collect_all();
+
+    json_writer_begin_object(&w, NULL);
+    if (!verbose) {
+        json_writer_uint(&w, "up", uptime_s);
+        for (int id = 0; id < METRIC_COUNT; id++) {
+            write_value(&w, (metric_id_t)id);
+        }
+        for (int h = 0; h < METRIC_HIST_COUNT; h++) {
+            write_counts(&w, s_hist_defs[h].name, (metric_hist_id_t)h);
+        }
+    } else {
+        json_writer_uint(&w, "uptime_s", uptime_s);
+        json_writer_begin_object(&w, "counters");
+        for (int id = 0; id < METRIC_COUNTER_COUNT; id++) {
+            write_value(&w, (metric_id_t)id);
+        }
+        json_writer_end_object(&w);
+        json_writer_begin_object(&w, "gauges");
+        for (int id = METRIC_COUNTER_COUNT; id < METRIC_COUNT; id++) {
+            write_value(&w, (metric_id_t)id);
+        }
+        json_writer_end_object(&w);
+        json_writer_begin_object(&w, "histograms");
+        for (int h = 0; h < METRIC_HIST_COUNT; h++) {
+            const hist_def_t *def = &s_hist_defs[h];
+            json_writer_begin_object(&w, def->name);
+            json_writer_begin_array(&w, "le");
+            for (uint8_t b = 0; b < def->bounds_count; b++) {
+                json_writer_uint(&w, NULL, def->bounds[b]);
+            }
+            json_writer_end_array(&w);
+            write_counts(&w, "counts", (metric_hist_id_t)h);
+            json_writer_uint(&w, "sum", atomic_load_explicit(&s_hists[h].sum, memory_order_relaxed));
+            json_writer_end_object(&w);
+        }
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+
+    size_t n = json_writer_finish(&w);
+    if (n == 0) {
+        ESP_LOGW(TAG, "Metrics do not fit in %u bytes", (unsigned)len);
+    }
+    return n;
+}
+
+static void metrics_task(void *arg)
+{
+    metrics_publish_fn_t publish = (metrics_publish_fn_t)arg;
+    static char json[CONFIG_METRICS_JSON_MAX];
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_METRICS_PUBLISH_INTERVAL_S * 1000));
+        size_t len = metrics_to_json(json, sizeof(json), false);
+        if (len > 0) {
+            publish(json, len);
+        }
+    }
+}
+
+void metrics_start(metrics_publish_fn_t publish)
+{
+    xTaskCreate(metrics_task, "metrics", 3072, (void *)publish, TASK_PRIO_METRICS, NULL);
+}
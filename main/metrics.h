@@ -0,0 +1,101 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Device-wide runtime metrics. Every metric is a fixed slot named below, so
+// recording one is a relaxed atomic add or store (histograms: a bucket search
+// over at most METRIC_HIST_MAX_BUCKETS bounds plus two adds) and can be done
+// from any task. Values that other modules already keep in their own stats
+// structs are pulled in by collectors just before an export instead of being
+// recorded twice.
+//
+// Exports (metrics_to_json):
+//   compact  {"up":s,"<name>":v,...,"<hist>":[count per bucket...]}
+//            published on <device_id>/metrics; bucket bounds are listed in
+//            metrics.c and in the verbose form
+//   verbose  {"uptime_s":s,"counters":{...},"gauges":{...},
+//             "histograms":{"<hist>":{"le":[bounds],"counts":[...],"sum":n}}}
+//            served as /metrics on the wifiManager HTTP server
+
+// Counters only go up (since boot); gauges hold the latest value
+typedef enum {
+    // counters
+    METRIC_UART_BYTES,
+    METRIC_UART_OVERFLOWS,
+    METRIC_RADAR_FRAMES,
+    METRIC_RADAR_CHECKSUM_ERRORS,
+    METRIC_RADAR_TAIL_ERRORS,
+    METRIC_RADAR_LENGTH_ERRORS,
+    METRIC_RADAR_RESYNCS,
+    METRIC_RADAR_BYTES_DISCARDED,
+    METRIC_RADAR_UNKNOWN_FRAMES,
+    METRIC_RADAR_LOG_DROPPED,
+    METRIC_RADAR_CMD_SENT,
+    METRIC_RADAR_CMD_TIMEOUTS,
+    METRIC_RADAR_CMD_FAILED,
+    METRIC_MQTT_PUBLISHED,
+    METRIC_MQTT_PUBLISH_FAILURES,
+    METRIC_MQTT_DISCONNECTS,
+    METRIC_MQTT_INBOX_RECEIVED,
+    METRIC_MQTT_INBOX_DROPPED,
+    METRIC_JOURNAL_APPENDED,
+    METRIC_JOURNAL_DROPPED,
+    METRIC_WIFI_RECONNECTS,
+    METRIC_WIFI_FALLBACKS,
+    METRIC_OTA_STARTED,
+    METRIC_OTA_RETRIES,
+    METRIC_OTA_FAILURES,
+    METRIC_OTA_REFUSED,
+    METRIC_COUNTER_COUNT,
+
+    // gauges
+    METRIC_HEAP_FREE = METRIC_COUNTER_COUNT,
+    METRIC_HEAP_MIN_FREE,
+    METRIC_HEAP_LARGEST_BLOCK,
+    METRIC_HEAP_FRAGMENTATION,
+    METRIC_MQTT_INBOX_QUEUED,
+    METRIC_MQTT_INBOX_HIGH_WATER,
+    METRIC_MQTT_OUTBOX_BYTES,
+    METRIC_JOURNAL_PENDING,
+    METRIC_WIFI_RSSI,
+    METRIC_WIFI_CONNECT_MS,
+    METRIC_WIFI_BOOT_MS,
+    METRIC_OTA_BYTES,
+    METRIC_COUNT,
+} metric_id_t;
+
+typedef enum {
+    METRIC_HIST_RADAR_FRAME_US,     // time spent handling one radar frame
+    METRIC_HIST_MQTT_PUBLISH_US,    // time esp_mqtt_client_publish blocked the caller
+    METRIC_HIST_LIVE_EVENT_US,      // radar bytes read -> change picked up by the live publisher
+    METRIC_HIST_LIVE_ALARM_US,      // radar bytes read -> alarm/presence publish enqueued
+    METRIC_HIST_COUNT,
+} metric_hist_id_t;
+
+#define METRIC_HIST_MAX_BUCKETS 8   // bounds, plus one overflow bucket
+
+void metrics_inc(metric_id_t id);
+void metrics_add(metric_id_t id, uint32_t n);
+// Gauges, and counters mirrored from another module's own stats
+void metrics_set(metric_id_t id, int32_t value);
+void metrics_observe(metric_hist_id_t id, uint32_t value);
+
+int32_t metrics_get(metric_id_t id);
+
+// Called before every export, in registration order (at most 8)
+typedef void (*metrics_collector_t)(void);
+void metrics_add_collector(metrics_collector_t collect);
+
+// Run the collectors and render all metrics. Returns the length written
+// (excluding the NUL), or 0 if buf is too small.
+size_t metrics_to_json(char *buf, size_t len, bool verbose);
+
+// Publish the compact form every CONFIG_METRICS_PUBLISH_INTERVAL_S seconds.
+// publish returns false when the message could not be sent (e.g. offline).
+typedef bool (*metrics_publish_fn_t)(const char *json, size_t len);
+void metrics_start(metrics_publish_fn_t publish);
+
+#endif // METRICS_H
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "sdkconfig.h"
+#include "mqtt_inbox.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_MQTT_INBOX_DEPTH
+#define CONFIG_MQTT_INBOX_DEPTH 4
+#endif
+#ifndef CONFIG_MQTT_INBOX_MAX_PAYLOAD
+#define CONFIG_MQTT_INBOX_MAX_PAYLOAD 1024
+#endif
+
+#define INBOX_DEPTH     CONFIG_MQTT_INBOX_DEPTH
+#define INBOX_PAYLOAD   CONFIG_MQTT_INBOX_MAX_PAYLOAD
+#define NO_SLOT         0xFF
+
+typedef struct {
+    char topic[MQTT_INBOX_TOPIC_MAX];
+    char data[INBOX_PAYLOAD + 1];
+    size_t len;
+} inbox_slot_t;
+
+static inbox_slot_t s_slots[INBOX_DEPTH];
+static QueueHandle_t s_free;        // slot indexes the handler may fill
+static QueueHandle_t s_ready;       // slot indexes waiting for the worker
+static mqtt_inbox_handler_t s_handler;
+
+// Reassembly state, only touched by the esp-mqtt task
+static uint8_t s_current = NO_SLOT;
+static size_t s_expected;           // offset of the next fragment
+static size_t s_total;
+static bool s_skipping;             // rest of the current message is being dropped
+
+// Counters are each written by a single task
+static mqtt_inbox_stats_t s_stats;
+
+static void inbox_worker_task(void *arg)
+{
+    uint8_t idx;
+    for (;;) {
+        xQueueReceive(s_ready, &idx, portMAX_DELAY);
+        inbox_slot_t *slot = &s_slots[idx];
+        s_handler(slot->topic, slot->data, slot->len);
+        s_stats.handled++;
+        xQueueSend(s_free, &idx, 0);
+    }
+}
+
+esp_err_t mqtt_inbox_init(mqtt_inbox_handler_t handler)
+{
+    s_handler = handler;
+    s_free = xQueueCreate(INBOX_DEPTH, sizeof(uint8_t));
+    s_ready = xQueueCreate(INBOX_DEPTH, sizeof(uint8_t));
+    if (s_free == NULL || s_ready == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint8_t i = 0; i < INBOX_DEPTH; i++) {
+        xQueueSend(s_free, &i, 0);
+    }
+    s_stats.depth = INBOX_DEPTH;
+
+    // Stack sized for cJSON parsing and the settings handlers
+    if (xTaskCreate(inbox_worker_task, "mqtt_inbox", 6144, NULL, TASK_PRIO_MQTT_INBOX, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void drop(uint32_t *counter, const char *why)
+{
+    (*counter)++;
+    printf("MQTT inbox: dropped message (%s), full=%" PRIu32 " oversize=%" PRIu32 " partial=%" PRIu32 "\n",
+           why, s_stats.dropped_full, s_stats.dropped_oversize, s_stats.dropped_partial);
+}
+
+bool mqtt_inbox_post(const esp_mqtt_event_t *event)
+{
+    size_t offset = event->current_data_offset;
+    size_t total = event->total_data_len > event->data_len ? event->total_data_len : event->data_len;
+
+    if (offset == 0) {
+        // A new message; anything still being assembled was cut short
+        if (s_current != NO_SLOT) {
+            xQueueSend(s_free, &s_current, 0);
+            s_current = NO_SLOT;
+            drop(&s_stats.dropped_partial, "incomplete");
+        }
+        s_skipping = false;
+
+        if (event->topic_len >= MQTT_INBOX_TOPIC_MAX || total > INBOX_PAYLOAD) {
+            s_skipping = true;
+            drop(&s_stats.dropped_oversize, "too large");
+            return false;
+        }
+        uint8_t idx;
+        if (xQueueReceive(s_free, &idx, 0) != pdTRUE) {
+            s_skipping = true;
+            drop(&s_stats.dropped_full, "queue full");
+            return false;
+        }
+        inbox_slot_t *slot = &s_slots[idx];
+        memcpy(slot->topic, event->topic, event->topic_len);
+        slot->topic[event->topic_len] = '\0';
+        slot->len = 0;
+        s_current = idx;
+        s_expected = 0;
+        s_total = total;
+    } else if (s_skipping) {
+        return false;
+    } else if (s_current == NO_SLOT || offset != s_expected) {
+        if (s_current != NO_SLOT) {
+            xQueueSend(s_free, &s_current, 0);
+            s_current = NO_SLOT;
+        }
+        s_skipping = true;
+        drop(&s_stats.dropped_partial, "fragment out of order");
+        return false;
+    }
+
+    inbox_slot_t *slot = &s_slots[s_current];
+    if (offset + event->data_len > s_total) {
+        xQueueSend(s_free, &s_current, 0);
+        s_current = NO_SLOT;
+        s_skipping = true;
+        drop(&s_stats.dropped_oversize, "fragment past end");
+        return false;
+    }
+    memcpy(slot->data + offset, event->data, event->data_len);
+    s_expected = offset + event->data_len;
+    if (s_expected < s_total) {
+        return true;
+    }
+
+    // Complete: hand it to the worker. The ready queue has one entry per
+    // slot, so this cannot fail.
+    slot->len = s_total;
+    slot->data[s_total] = '\0';
+    if (offset != 0) {
+        s_stats.fragmented++;
+    }
+    s_stats.received++;
+    xQueueSend(s_ready, &s_current, 0);
+    s_current = NO_SLOT;
+
+    UBaseType_t waiting = uxQueueMessagesWaiting(s_ready);
+    if (waiting > s_stats.high_water) {
+        s_stats.high_water = (uint8_t)waiting;
+    }
+    return true;
+}
+
+void mqtt_inbox_get_stats(mqtt_inbox_stats_t *out)
+{
+    *out = s_stats;
+    out->queued = s_ready ? (uint8_t)uxQueueMessagesWaiting(s_ready) : 0;
+}
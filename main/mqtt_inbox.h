@@ -0,0 +1,46 @@
+#ifndef MQTT_INBOX_H
+#define MQTT_INBOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+
+// Bounded queue between the esp-mqtt task and a worker that handles incoming
+// messages. The event handler only copies the message into a preallocated
+// slot and returns, so slow handlers (UART writes, NVS, restarts) never stall
+// keepalives or the reception of further messages.
+//
+// Messages split over several MQTT_EVENT_DATA events are reassembled before
+// they are queued. A message is dropped, and counted, when no slot is free or
+// it does not fit in a slot.
+
+#define MQTT_INBOX_TOPIC_MAX    96
+
+// Called on the worker task with a complete message. data is NUL-terminated
+// (data[data_len] == '\0') so text payloads can be parsed in place.
+typedef void (*mqtt_inbox_handler_t)(const char *topic, const char *data, size_t data_len);
+
+typedef struct {
+    uint32_t received;          // complete messages queued
+    uint32_t fragmented;        // of those, reassembled from several events
+    uint32_t handled;
+    uint32_t dropped_full;      // no free slot: the worker is behind
+    uint32_t dropped_oversize;  // topic or payload larger than a slot
+    uint32_t dropped_partial;   // fragments that arrived without their start
+    uint8_t depth;              // slots configured
+    uint8_t queued;             // messages waiting for the worker now
+    uint8_t high_water;         // most messages ever waiting at once
+} mqtt_inbox_stats_t;
+
+// Allocate the slots and start the worker task
+esp_err_t mqtt_inbox_init(mqtt_inbox_handler_t handler);
+
+// Copy one MQTT_EVENT_DATA event. Never blocks; returns false when the
+// message it belongs to is being dropped.
+bool mqtt_inbox_post(const esp_mqtt_event_t *event);
+
+void mqtt_inbox_get_stats(mqtt_inbox_stats_t *out);
+
+#endif // MQTT_INBOX_H
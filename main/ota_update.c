@@ -1,33 +1,533 @@
+#include <stdio.h>
+#include <string.h>
 #include "ota_update.h"
 #include "esp_https_ota.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_log.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+#include "delta_patch.h"
+#include "metrics.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_crt_bundle.h"
+#include "sdkconfig.h"
+#include "task_priorities.h"
 
 #define TAG "OTA_UPDATE"
 
-static void ota_task(void *pvParameter) {
-    const char *url = (const char *)pvParameter;
-    ESP_LOGI(TAG, "Starting OTA from URL: %s", url);
+#ifndef CONFIG_OTA_MAX_ATTEMPTS
+#define CONFIG_OTA_MAX_ATTEMPTS 8
+#endif
+#ifndef CONFIG_OTA_RESUME_SAVE_KB
+#define CONFIG_OTA_RESUME_SAVE_KB 64
+#endif
+#ifndef CONFIG_OTA_PROGRESS_STEP_PERCENT
+#define CONFIG_OTA_PROGRESS_STEP_PERCENT 5
+#endif
+#ifndef CONFIG_OTA_VALIDATE_TIMEOUT_S
+#define CONFIG_OTA_VALIDATE_TIMEOUT_S 300
+#endif
+#ifndef CONFIG_OTA_HTTP_TIMEOUT_MS
+#define CONFIG_OTA_HTTP_TIMEOUT_MS 10000
+#endif
+
+#define OTA_NAMESPACE       "ota"
+#define SECTOR_SIZE         4096
+#define RESUME_SAVE_BYTES   (CONFIG_OTA_RESUME_SAVE_KB * 1024)
+#define RETRY_MAX_DELAY_MS  30000
+
+static ota_status_fn_t s_report;
+static SemaphoreHandle_t s_job_lock;
+static ota_job_t s_job;                 // owned by ota_task while s_job_lock is held
+static esp_timer_handle_t s_rollback_timer;
+static bool s_pending_verify;
+
+const char *ota_state_to_str(ota_state_t state)
+{
+    switch (state) {
+        case OTA_STATE_DOWNLOADING:    return "downloading";
+        case OTA_STATE_RETRYING:       return "retrying";
+        case OTA_STATE_VERIFYING:      return "verifying";
+        case OTA_STATE_REBOOTING:      return "rebooting";
+        case OTA_STATE_FAILED:         return "failed";
+        case OTA_STATE_BUSY:           return "busy";
+        case OTA_STATE_VALID:          return "valid";
+    }
+    return "unknown";
+}
+
+static void report(ota_state_t state, uint32_t bytes, uint32_t total, uint8_t attempt, esp_err_t err, const char *detail)
+{
+    ota_status_t status = { state, bytes, total, attempt, err, detail };
+    switch (state) {
+        case OTA_STATE_DOWNLOADING: metrics_set(METRIC_OTA_BYTES, (int32_t)bytes); break;
+        case OTA_STATE_RETRYING:    metrics_inc(METRIC_OTA_RETRIES); break;
+        case OTA_STATE_FAILED:      metrics_inc(METRIC_OTA_FAILURES); break;
+        case OTA_STATE_BUSY:        metrics_inc(METRIC_OTA_REFUSED); break;
+        default: break;
+    }
+    ESP_LOGI(TAG, "%s %lu/%lu attempt %u %s", ota_state_to_str(state),
+             (unsigned long)bytes, (unsigned long)total, attempt, detail ? detail : "");
+    if (s_report) {
+        s_report(&status);
+    }
+}
+
+// ---------------------- Resume point (NVS) ----------------------
+// The offset is only ever saved rounded down to a flash sector, so the
+// resumed download rewrites at most one sector that may have been partial.
+static uint32_t resume_load(const char *url, uint32_t *size)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return 0;
+    }
+    char saved_url[OTA_URL_MAX];
+    size_t len = sizeof(saved_url);
+    uint32_t offset = 0;
+    *size = 0;
+    if (nvs_get_str(nvs, "url", saved_url, &len) == ESP_OK && strcmp(saved_url, url) == 0) {
+        nvs_get_u32(nvs, "offset", &offset);
+        nvs_get_u32(nvs, "size", size);
+    }
+    nvs_close(nvs);
+    return offset;
+}
+
+static void resume_save(const char *url, uint32_t offset, uint32_t size)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    nvs_set_str(nvs, "url", url);
+    nvs_set_u32(nvs, "offset", offset & ~(uint32_t)(SECTOR_SIZE - 1));
+    nvs_set_u32(nvs, "size", size);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void resume_clear(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    nvs_erase_key(nvs, "url");
+    nvs_erase_key(nvs, "offset");
+    nvs_erase_key(nvs, "size");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+// ---------------------- Verification ----------------------
+// SHA-256 of the first len bytes of the update partition, i.e. of the .bin
+static esp_err_t partition_sha256(const esp_partition_t *part, uint32_t len, uint8_t out[32])
+{
+    static uint8_t buf[1024];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    esp_err_t err = ESP_OK;
+    for (uint32_t off = 0; off < len; off += sizeof(buf)) {
+        uint32_t n = len - off < sizeof(buf) ? len - off : sizeof(buf);
+        err = esp_partition_read(part, off, buf, n);
+        if (err != ESP_OK) {
+            break;
+        }
+        mbedtls_sha256_update(&ctx, buf, n);
+    }
+    mbedtls_sha256_finish(&ctx, out);
+    mbedtls_sha256_free(&ctx);
+    return err;
+}
+
+// Check the downloaded image before it is made bootable. Returns a reason on failure.
+static const char *verify_image(uint32_t size, esp_app_desc_t *desc)
+{
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    if (part == NULL || esp_ota_get_partition_description(part, desc) != ESP_OK) {
+        return "no app description";
+    }
+    if (s_job.version[0] != '\0' && strcmp(desc->version, s_job.version) != 0) {
+        return "unexpected version";
+    }
+    if (!s_job.force && strcmp(desc->version, esp_app_get_description()->version) == 0) {
+        return "same version as running";
+    }
+    if (s_job.has_sha256) {
+        uint8_t digest[32];
+        if (partition_sha256(part, size, digest) != ESP_OK) {
+            return "read back failed";
+        }
+        if (memcmp(digest, s_job.sha256, sizeof(digest)) != 0) {
+            return "sha256 mismatch";
+        }
+    }
+    return NULL;
+}
+
+// ---------------------- Full image download ----------------------
+typedef struct {
+    uint32_t written;           // bytes downloaded
+    uint32_t total;             // bytes expected, 0 while unknown
+    esp_err_t err;
+    char version[OTA_VERSION_MAX];
+} ota_progress_t;
+
+static esp_http_client_config_t http_config_for_job(void)
+{
     esp_http_client_config_t http_config = {
-        .url = url,
+        .url = s_job.url,
         .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = CONFIG_OTA_HTTP_TIMEOUT_MS,
+        .keep_alive_enable = true,
     };
-    esp_https_ota_config_t ota_config = {
-        .http_config = &http_config,
+    return http_config;
+}
+
+static void retry_pause(ota_progress_t *pr, uint8_t attempt, uint32_t *delay_ms)
+{
+    report(OTA_STATE_RETRYING, pr->written, pr->total, attempt, pr->err, esp_err_to_name(pr->err));
+    vTaskDelay(pdMS_TO_TICKS(*delay_ms));
+    *delay_ms = *delay_ms * 2 > RETRY_MAX_DELAY_MS ? RETRY_MAX_DELAY_MS : *delay_ms * 2;
+}
+
+// Download the image with esp_https_ota, resuming after drops. Returns NULL
+// once the new image is verified and set as the boot partition.
+static const char *run_full_image(ota_progress_t *pr)
+{
+    esp_http_client_config_t http_config = http_config_for_job();
+    uint32_t saved_size;
+    uint32_t retry_delay_ms = 1000;
+    esp_https_ota_handle_t handle = NULL;
+    pr->written = resume_load(s_job.url, &saved_size);
+
+    for (uint8_t attempt = 1; ; attempt++) {
+        esp_https_ota_config_t ota_config = {
+            .http_config = &http_config,
+            .ota_resumption = pr->written > 0,
+            .ota_image_bytes_written = pr->written,
+        };
+        if (pr->written > 0) {
+            ESP_LOGI(TAG, "Resuming at %lu bytes", (unsigned long)pr->written);
+        }
+        pr->err = esp_https_ota_begin(&ota_config, &handle);
+        if (pr->err == ESP_OK) {
+            int size = esp_https_ota_get_image_size(handle);
+            pr->total = size > 0 ? (uint32_t)size : 0;
+            if (pr->written > 0 && saved_size != 0 && pr->total != 0 && pr->total != saved_size) {
+                // The file behind the URL changed: the flash holds part of another image
+                ESP_LOGW(TAG, "Image size changed (%lu -> %lu), restarting download",
+                         (unsigned long)saved_size, (unsigned long)pr->total);
+                esp_https_ota_abort(handle);
+                resume_clear();
+                pr->written = 0;
+                attempt--;
+                continue;
+            }
+            if (pr->total != 0) {
+                saved_size = pr->total;
+            }
+            report(OTA_STATE_DOWNLOADING, pr->written, pr->total, attempt, ESP_OK, NULL);
+
+            uint32_t last_saved = pr->written;
+            uint32_t step = pr->total ? pr->total * CONFIG_OTA_PROGRESS_STEP_PERCENT / 100 : RESUME_SAVE_BYTES;
+            uint32_t next_report = pr->written + step;
+            while ((pr->err = esp_https_ota_perform(handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+                pr->written = (uint32_t)esp_https_ota_get_image_len_read(handle);
+                if (pr->written - last_saved >= RESUME_SAVE_BYTES) {
+                    resume_save(s_job.url, pr->written, pr->total);
+                    last_saved = pr->written;
+                }
+                if (pr->written >= next_report) {
+                    report(OTA_STATE_DOWNLOADING, pr->written, pr->total, attempt, ESP_OK, NULL);
+                    next_report = pr->written + step;
+                }
+            }
+            pr->written = (uint32_t)esp_https_ota_get_image_len_read(handle);
+            if (pr->err == ESP_OK && esp_https_ota_is_complete_data_received(handle)) {
+                break;
+            }
+            esp_https_ota_abort(handle);
+            handle = NULL;
+        }
+
+        // Keep what is on flash and try again from there
+        if (pr->written > 0) {
+            resume_save(s_job.url, pr->written, pr->total);
+            pr->written &= ~(uint32_t)(SECTOR_SIZE - 1);
+        }
+        if (attempt >= CONFIG_OTA_MAX_ATTEMPTS) {
+            return "download failed";
+        }
+        retry_pause(pr, attempt, &retry_delay_ms);
+    }
+
+    report(OTA_STATE_VERIFYING, pr->written, pr->total, 0, ESP_OK, NULL);
+    esp_app_desc_t desc;
+    const char *failure = verify_image(pr->total ? pr->total : pr->written, &desc);
+    if (failure != NULL) {
+        esp_https_ota_abort(handle);
+        pr->err = ESP_ERR_INVALID_VERSION;
+    } else {
+        // Validates the image (header, segments, appended hash) and switches the boot partition
+        pr->err = esp_https_ota_finish(handle);
+        if (pr->err != ESP_OK) {
+            failure = "image rejected";
+        }
+    }
+    // Whatever happened, the partial image is no longer worth resuming
+    resume_clear();
+    if (failure == NULL) {
+        snprintf(pr->version, sizeof(pr->version), "%s", desc.version);
+    }
+    return failure;
+}
+
+// ---------------------- Delta patch download ----------------------
+// The patch (main/delta_patch.h) is applied while it downloads: the running
+// partition is the source and the new image is streamed into the passive
+// slot. Patches are small, so a dropped connection restarts the patch
+// instead of resuming it.
+typedef struct {
+    const esp_partition_t *running;
+    const esp_partition_t *update;
+    esp_ota_handle_t ota;
+    bool begun;
+    mbedtls_sha256_context sha;
+} delta_ctx_t;
+
+static int delta_read(uint32_t offset, uint8_t *buf, size_t len, void *ctx)
+{
+    delta_ctx_t *d = ctx;
+    return esp_partition_read(d->running, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int delta_write(const uint8_t *buf, size_t len, void *ctx)
+{
+    delta_ctx_t *d = ctx;
+    mbedtls_sha256_update(&d->sha, buf, len);
+    return esp_ota_write(d->ota, buf, len) == ESP_OK ? 0 : -1;
+}
+
+// Refuse a patch made for another image before anything is written
+static int delta_header(const delta_patch_t *patch, void *ctx)
+{
+    delta_ctx_t *d = ctx;
+    uint8_t digest[32];
+    if (patch->source_size > d->running->size || patch->target_size > d->update->size) {
+        ESP_LOGE(TAG, "Delta patch sizes do not fit the partitions");
+        return -1;
+    }
+    if (partition_sha256(d->running, patch->source_size, digest) != ESP_OK ||
+        memcmp(digest, patch->source_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Delta patch was made for a different firmware");
+        return -1;
+    }
+    if (esp_ota_begin(d->update, OTA_WITH_SEQUENTIAL_WRITES, &d->ota) != ESP_OK) {
+        return -1;
+    }
+    d->begun = true;
+    mbedtls_sha256_init(&d->sha);
+    mbedtls_sha256_starts(&d->sha, 0);
+    return 0;
+}
+
+static void delta_abort(delta_ctx_t *d)
+{
+    if (d->begun) {
+        esp_ota_abort(d->ota);
+        mbedtls_sha256_free(&d->sha);
+        d->begun = false;
+    }
+}
+
+static const char *run_delta(ota_progress_t *pr)
+{
+    static delta_patch_t patch;     // ~1.4 KB, kept off the task stack
+    static uint8_t buf[1024];
+    esp_http_client_config_t http_config = http_config_for_job();
+    uint32_t retry_delay_ms = 1000;
+    delta_ctx_t d = {
+        .running = esp_ota_get_running_partition(),
+        .update = esp_ota_get_next_update_partition(NULL),
     };
-    esp_err_t ret = esp_https_ota(&ota_config);
-    if (ret == ESP_OK) {
+    if (d.update == NULL) {
+        return "no update partition";
+    }
+
+    for (uint8_t attempt = 1; ; attempt++) {
+        const char *permanent = NULL;
+        delta_patch_init(&patch, delta_read, delta_write, delta_header, &d);
+        pr->written = 0;
+        esp_http_client_handle_t client = esp_http_client_init(&http_config);
+        pr->err = client ? esp_http_client_open(client, 0) : ESP_ERR_NO_MEM;
+        if (pr->err == ESP_OK) {
+            int64_t length = esp_http_client_fetch_headers(client);
+            int status = esp_http_client_get_status_code(client);
+            pr->total = length > 0 ? (uint32_t)length : 0;
+            if (status != 200) {
+                ESP_LOGE(TAG, "HTTP status %d", status);
+                permanent = "http error";
+                pr->err = ESP_FAIL;
+            } else {
+                report(OTA_STATE_DOWNLOADING, 0, pr->total, attempt, ESP_OK, "delta");
+                uint32_t step = pr->total ? pr->total * CONFIG_OTA_PROGRESS_STEP_PERCENT / 100 : RESUME_SAVE_BYTES;
+                uint32_t next_report = step;
+                for (;;) {
+                    int n = esp_http_client_read(client, (char *)buf, sizeof(buf));
+                    if (n < 0) {
+                        pr->err = ESP_FAIL;
+                        break;
+                    }
+                    if (n == 0) {
+                        if (!esp_http_client_is_complete_data_received(client)) {
+                            pr->err = ESP_ERR_INVALID_SIZE;
+                        }
+                        break;
+                    }
+                    if (delta_patch_feed(&patch, buf, n) != 0) {
+                        // A bad patch stays bad; only network errors are retried
+                        permanent = patch.error;
+                        pr->err = ESP_ERR_INVALID_RESPONSE;
+                        break;
+                    }
+                    pr->written += n;
+                    if (pr->written >= next_report) {
+                        report(OTA_STATE_DOWNLOADING, pr->written, pr->total, attempt, ESP_OK, "delta");
+                        next_report = pr->written + step;
+                    }
+                }
+            }
+        }
+        if (client) {
+            esp_http_client_close(client);
+            esp_http_client_cleanup(client);
+        }
+        if (delta_patch_done(&patch)) {
+            break;
+        }
+        delta_abort(&d);
+        if (permanent != NULL) {
+            return permanent;
+        }
+        if (pr->err == ESP_OK) {
+            pr->err = ESP_ERR_INVALID_SIZE;     // connection closed before the end marker
+        }
+        if (attempt >= CONFIG_OTA_MAX_ATTEMPTS) {
+            return "download failed";
+        }
+        retry_pause(pr, attempt, &retry_delay_ms);
+    }
+
+    report(OTA_STATE_VERIFYING, pr->written, pr->total, 0, ESP_OK, "delta");
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&d.sha, digest);
+    esp_app_desc_t desc;
+    const char *failure = NULL;
+    if (memcmp(digest, patch.target_sha256, sizeof(digest)) != 0) {
+        failure = "patched image hash mismatch";
+    } else {
+        failure = verify_image(patch.target_size, &desc);
+    }
+    if (failure != NULL) {
+        delta_abort(&d);
+        pr->err = ESP_ERR_INVALID_CRC;
+        return failure;
+    }
+    mbedtls_sha256_free(&d.sha);
+    pr->err = esp_ota_end(d.ota);
+    if (pr->err == ESP_OK) {
+        pr->err = esp_ota_set_boot_partition(d.update);
+    }
+    if (pr->err != ESP_OK) {
+        return "image rejected";
+    }
+    snprintf(pr->version, sizeof(pr->version), "%s", desc.version);
+    return NULL;
+}
+
+static void ota_task(void *pvParameter)
+{
+    ESP_LOGI(TAG, "Starting %sOTA from URL: %s", s_job.delta ? "delta " : "", s_job.url);
+    ota_progress_t pr = { 0 };
+    const char *failure = s_job.delta ? run_delta(&pr) : run_full_image(&pr);
+
+    if (failure == NULL) {
+        report(OTA_STATE_REBOOTING, pr.written, pr.total, 0, ESP_OK, pr.version);
         ESP_LOGI(TAG, "OTA Succeed, Rebooting...");
         vTaskDelay(1000 / portTICK_PERIOD_MS);
         esp_restart();
-    } else {
-        ESP_LOGE(TAG, "OTA Failed");
     }
+
+    ESP_LOGE(TAG, "OTA Failed: %s", failure);
+    report(OTA_STATE_FAILED, pr.written, pr.total, 0, pr.err, failure);
+    xSemaphoreGive(s_job_lock);
     vTaskDelete(NULL);
 }
 
-void ota_update_start(const char *url) {
-    xTaskCreate(&ota_task, "ota_task", 8192, (void *)url, 5, NULL);
-} 
\ No newline at end of file
+esp_err_t ota_update_start(const ota_job_t *job)
+{
+    if (xSemaphoreTake(s_job_lock, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "OTA already in progress, ignoring %s", job->url);
+        report(OTA_STATE_BUSY, 0, 0, 0, ESP_ERR_INVALID_STATE, s_job.url);
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_job = *job;
+    metrics_inc(METRIC_OTA_STARTED);
+    if (xTaskCreate(&ota_task, "ota_task", 8192, NULL, TASK_PRIO_OTA, NULL) != pdPASS) {
+        xSemaphoreGive(s_job_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// ---------------------- First boot of a new image ----------------------
+static void rollback_timer_cb(void *arg)
+{
+    ESP_LOGE(TAG, "New firmware not confirmed within %d s, rolling back", CONFIG_OTA_VALIDATE_TIMEOUT_S);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+void ota_update_init(ota_status_fn_t report_fn)
+{
+    s_report = report_fn;
+    s_job_lock = xSemaphoreCreateBinary();
+    xSemaphoreGive(s_job_lock);
+
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return;
+    }
+    s_pending_verify = true;
+    ESP_LOGW(TAG, "First boot of %s, waiting for confirmation", esp_app_get_description()->version);
+    const esp_timer_create_args_t args = {
+        .callback = rollback_timer_cb,
+        .name = "ota_rollback",
+    };
+    if (esp_timer_create(&args, &s_rollback_timer) == ESP_OK) {
+        esp_timer_start_once(s_rollback_timer, (uint64_t)CONFIG_OTA_VALIDATE_TIMEOUT_S * 1000000);
+    }
+}
+
+void ota_update_mark_healthy(void)
+{
+    if (!s_pending_verify) {
+        return;
+    }
+    s_pending_verify = false;
+    if (s_rollback_timer) {
+        esp_timer_stop(s_rollback_timer);
+    }
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    report(err == ESP_OK ? OTA_STATE_VALID : OTA_STATE_FAILED, 0, 0, 0, err,
+           esp_app_get_description()->version);
+}
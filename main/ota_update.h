@@ -1,6 +1,60 @@
 #ifndef OTA_UPDATE_H
 #define OTA_UPDATE_H
 
-void ota_update_start(const char *url);
- 
-#endif // OTA_UPDATE_H 
\ No newline at end of file
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Firmware update over HTTP(S). The download resumes with an HTTP Range
+// request after a dropped connection (and after a reboot, from the offset
+// saved in NVS), the image is checked before the boot partition is switched,
+// and a new image must prove itself healthy on first boot or it is rolled
+// back (needs CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE).
+
+#define OTA_URL_MAX     256
+#define OTA_VERSION_MAX 32
+
+typedef struct {
+    char url[OTA_URL_MAX];
+    bool has_sha256;
+    uint8_t sha256[32];             // SHA-256 of the whole (new) .bin file
+    char version[OTA_VERSION_MAX];  // expected app version, "" for any
+    bool force;                     // allow reinstalling the running version
+    bool delta;                     // url is a patch against the running image (ota_delta.py)
+} ota_job_t;
+
+typedef enum {
+    OTA_STATE_DOWNLOADING,
+    OTA_STATE_RETRYING,         // connection lost; resuming after a pause
+    OTA_STATE_VERIFYING,
+    OTA_STATE_REBOOTING,
+    OTA_STATE_FAILED,
+    OTA_STATE_BUSY,             // a job is already running; the new one was refused
+    OTA_STATE_VALID,            // new image confirmed, rollback cancelled
+} ota_state_t;
+
+typedef struct {
+    ota_state_t state;
+    uint32_t bytes;             // image bytes on flash
+    uint32_t total;             // image size, 0 while unknown
+    uint8_t attempt;            // connection attempts for this job
+    esp_err_t err;
+    const char *detail;         // short reason for FAILED, version otherwise
+} ota_status_t;
+
+typedef void (*ota_status_fn_t)(const ota_status_t *status);
+
+// Register the progress reporter and check whether this is the first boot of
+// a new image; if so, arm the rollback timer. Call early in app_main.
+void ota_update_init(ota_status_fn_t report);
+
+// Start a job in the background (the job is copied). Returns
+// ESP_ERR_INVALID_STATE if one is already running.
+esp_err_t ota_update_start(const ota_job_t *job);
+
+// The firmware is working (connected to the broker): confirm a pending image
+void ota_update_mark_healthy(void);
+
+const char *ota_state_to_str(ota_state_t state);
+
+#endif // OTA_UPDATE_H
@@ -0,0 +1,181 @@
+#include <string.h>
+#include <stddef.h>
+#include "payload_json.h"
+#include "json_writer.h"
+#include "live_binary.h"
+
+static void add_device_ident(json_writer_t *w, const char *device_id)
+{
+    json_writer_string(w, "device_id", device_id);
+    json_writer_string(w, "device_type", DEVICE_TYPE);
+}
+
+size_t payload_live_json(char *buf, size_t len, const char *device_id, const radar_state_t *st)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+    json_writer_begin_object(&w, NULL);
+    add_device_ident(&w, device_id);
+    json_writer_bool(&w, "presence", st->presence);
+    json_writer_bool(&w, "fall_alarm", st->fall_alarm);
+    json_writer_bool(&w, "stay_still_alarm", st->stay_still_alarm);
+    json_writer_uint(&w, "movement_state", st->movement_state);
+    json_writer_uint(&w, "body_movement_param", st->body_movement_param);
+    json_writer_uint(&w, "heartbeat", st->heartbeat);
+    json_writer_int(&w, "trajectory_x", st->traj_x);
+    json_writer_int(&w, "trajectory_y", st->traj_y);
+    json_writer_uint(&w, "total_height_count", st->total_height_count);
+    json_writer_uint(&w, "height_prop_0_0_5", st->height_prop_0_0_5);
+    json_writer_uint(&w, "height_prop_0_5_1", st->height_prop_0_5_1);
+    json_writer_uint(&w, "height_prop_1_1_5", st->height_prop_1_1_5);
+    json_writer_uint(&w, "height_prop_1_5_2", st->height_prop_1_5_2);
+    json_writer_uint(&w, "non_presence_time", st->non_presence_time);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// Settings reported on settings_state, in payload order. Keys are the
+// radar_state_t field names.
+typedef enum {
+    SETTING_UINT,
+    SETTING_INT,
+    SETTING_BOOL,
+} setting_kind_t;
+
+typedef struct {
+    const char *key;
+    uint16_t offset;
+    uint8_t size;
+    uint8_t kind;
+} setting_field_t;
+
+#define SETTING_FIELD(name, kind) \
+    { #name, offsetof(radar_state_t, name), sizeof(((radar_state_t *)0)->name), kind }
+
+static const setting_field_t s_settings_fields[] = {
+    SETTING_FIELD(working_status, SETTING_UINT),
+    SETTING_FIELD(scenario, SETTING_UINT),
+    SETTING_FIELD(installation_angle_x, SETTING_INT),
+    SETTING_FIELD(installation_angle_y, SETTING_INT),
+    SETTING_FIELD(installation_angle_z, SETTING_INT),
+    SETTING_FIELD(installation_height, SETTING_UINT),
+    // Fall detection parameters
+    SETTING_FIELD(fall_detection_sensitivity, SETTING_UINT),
+    SETTING_FIELD(fall_duration, SETTING_UINT),
+    SETTING_FIELD(fall_breaking_height, SETTING_UINT),
+    // Distance Settings
+    SETTING_FIELD(sitting_still_distance, SETTING_UINT),
+    SETTING_FIELD(moving_distance, SETTING_UINT),
+    // Stay-still parameters
+    SETTING_FIELD(stay_still_switch, SETTING_BOOL),
+    SETTING_FIELD(stay_still_duration, SETTING_UINT),
+    SETTING_FIELD(height_accumulation_time, SETTING_UINT),
+    SETTING_FIELD(fall_detection_switch, SETTING_BOOL),
+    SETTING_FIELD(non_presence_time, SETTING_UINT),
+};
+
+#define SETTINGS_FIELD_COUNT (sizeof(s_settings_fields) / sizeof(s_settings_fields[0]))
+
+static int64_t setting_value(const radar_state_t *st, const setting_field_t *f)
+{
+    const uint8_t *p = (const uint8_t *)st + f->offset;
+    switch (f->size) {
+        case 1: {
+            return *p;  // bools and unsigned bytes; there are no signed ones
+        }
+        case 2: {
+            uint16_t v;
+            memcpy(&v, p, sizeof(v));
+            return f->kind == SETTING_INT ? (int64_t)(int16_t)v : (int64_t)v;
+        }
+        default: {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return f->kind == SETTING_INT ? (int64_t)(int32_t)v : (int64_t)v;
+        }
+    }
+}
+
+size_t payload_settings_json(char *buf, size_t len, const char *device_id, uint32_t boot, uint32_t version,
+                             const radar_state_t *st, uint8_t live_format, const payload_settings_base_t *base)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+    json_writer_begin_object(&w, NULL);
+    add_device_ident(&w, device_id);
+    json_writer_uint(&w, "boot", boot);
+    json_writer_uint(&w, "version", version);
+    if (base != NULL) {
+        json_writer_bool(&w, "delta", true);
+        json_writer_uint(&w, "base", base->version);
+    }
+
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const setting_field_t *f = &s_settings_fields[i];
+        int64_t value = setting_value(st, f);
+        if (base != NULL && value == setting_value(base->st, f)) {
+            continue;
+        }
+        switch (f->kind) {
+            case SETTING_INT:  json_writer_int(&w, f->key, (int32_t)value); break;
+            case SETTING_BOOL: json_writer_bool(&w, f->key, value != 0); break;
+            default:           json_writer_uint(&w, f->key, (uint32_t)value); break;
+        }
+    }
+    if (base == NULL || live_format != base->live_format) {
+        json_writer_string(&w, "live_format", live_format_to_str(live_format));
+    }
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+bool payload_settings_differ(const radar_state_t *a, const radar_state_t *b)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (setting_value(a, &s_settings_fields[i]) != setting_value(b, &s_settings_fields[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t payload_product_info_json(char *buf, size_t len, const char *device_id, const radar_state_t *st,
+                                 const payload_wifi_t *wifi)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+    json_writer_begin_object(&w, NULL);
+    add_device_ident(&w, device_id);
+
+    json_writer_string(&w, "product_model", st->product_model);
+    json_writer_string(&w, "product_id", st->product_id);
+    json_writer_string(&w, "hardware_model", st->hardware_model);
+    json_writer_string(&w, "firmware_version", st->firmware_version);
+
+    if (wifi != NULL) {
+        json_writer_uint(&w, "operating_time", st->operating_time);
+
+        // Time to connected: cached AP/lease (fast) or full scan + DHCP
+        json_writer_begin_object(&w, "wifi");
+        json_writer_uint(&w, "boot_ms", wifi->boot_ms);
+        json_writer_uint(&w, "connect_ms", wifi->connect_ms);
+        json_writer_bool(&w, "fast", wifi->fast);
+        json_writer_bool(&w, "static_ip", wifi->static_ip);
+        json_writer_uint(&w, "reconnects", wifi->reconnects);
+        json_writer_uint(&w, "fallbacks", wifi->fallbacks);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+size_t payload_usage_json(char *buf, size_t len, const char *device_id, const radar_state_t *st)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+    json_writer_begin_object(&w, NULL);
+    add_device_ident(&w, device_id);
+    json_writer_uint(&w, "operating_time", st->operating_time);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
@@ -0,0 +1,58 @@
+#ifndef PAYLOAD_JSON_H
+#define PAYLOAD_JSON_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "radar_state.h"
+
+// JSON payloads published on MQTT, written from a radar_state_t snapshot with
+// json_writer. Builders return the payload length, or 0 if it does not fit
+// (never a truncated payload). No ESP-IDF dependencies, so the buffer sizes
+// below are checked on the host (test/payload_json_test.c).
+
+#define DEVICE_TYPE     "R60AFD1"
+
+// Buffer sizes including the NUL. The worst case has every number at its
+// widest and the device ID and product strings at 31 characters of '"', each
+// escaped to two bytes; the test builds exactly that.
+#define LIVE_JSON_MAX           448     // worst case 425 bytes
+#define SETTINGS_JSON_MAX       672     // 652 (a delta with every field; 621 as a snapshot)
+#define PRODUCT_INFO_JSON_MAX   608     // 578, with operating_time and wifi
+#define USAGE_JSON_MAX          160     // 131
+
+// Wi-Fi connection timing reported in the full product info payload (the
+// wm_connect_stats_t fields it publishes)
+typedef struct {
+    uint32_t boot_ms;
+    uint32_t connect_ms;
+    bool fast;
+    bool static_ip;
+    uint16_t reconnects;
+    uint16_t fallbacks;
+} payload_wifi_t;
+
+// The settings payload a delta is relative to
+typedef struct {
+    uint32_t version;
+    const radar_state_t *st;
+    uint8_t live_format;
+} payload_settings_base_t;
+
+size_t payload_live_json(char *buf, size_t len, const char *device_id, const radar_state_t *st);
+
+// base NULL: every setting (full snapshot); otherwise only the settings that
+// differ from base (delta)
+size_t payload_settings_json(char *buf, size_t len, const char *device_id, uint32_t boot, uint32_t version,
+                             const radar_state_t *st, uint8_t live_format, const payload_settings_base_t *base);
+
+// Any setting reported in the settings payload differs
+bool payload_settings_differ(const radar_state_t *a, const radar_state_t *b);
+
+// wifi NULL: the short form printed on the console, without operating_time and wifi
+size_t payload_product_info_json(char *buf, size_t len, const char *device_id, const radar_state_t *st,
+                                 const payload_wifi_t *wifi);
+
+size_t payload_usage_json(char *buf, size_t len, const char *device_id, const radar_state_t *st);
+
+#endif // PAYLOAD_JSON_H
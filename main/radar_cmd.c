@@ -0,0 +1,481 @@
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "radar_cmd.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_RADAR_CMD_TX_GAP_MS
+#define CONFIG_RADAR_CMD_TX_GAP_MS 100
+#endif
+#ifndef CONFIG_RADAR_CMD_RESPONSE_TIMEOUT_MS
+#define CONFIG_RADAR_CMD_RESPONSE_TIMEOUT_MS 1000
+#endif
+#ifndef CONFIG_RADAR_CMD_RETRIES
+#define CONFIG_RADAR_CMD_RETRIES 2
+#endif
+
+#define TX_GAP_TICKS        pdMS_TO_TICKS(CONFIG_RADAR_CMD_TX_GAP_MS)
+#define RESPONSE_TIMEOUT    pdMS_TO_TICKS(CONFIG_RADAR_CMD_RESPONSE_TIMEOUT_MS)
+
+typedef struct {
+    bool used;
+    bool periodic;
+    bool tracked;           // created by radar_cmd_request, completes on the matching reply
+    bool awaiting;          // tracked: taken for sending, waiting for the reply
+    bool on_wire;           // tracked: fully transmitted; only later frames can be the reply
+    uint8_t prio;
+    uint8_t len;
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    TickType_t period;      // periodic jobs only
+    TickType_t due;
+    uint32_t seq;           // submission order, keeps FIFO among equal priorities
+    // Tracked requests only
+    radar_cmd_handle_t handle;
+    uint8_t retries_left;
+    TickType_t timeout;
+    TickType_t sent_at;
+    radar_cmd_done_cb_t cb;
+    radar_cmd_match_cb_t match;
+    void *cb_ctx;
+} radar_cmd_job_t;
+
+typedef struct {
+    bool used;
+    uint8_t control;
+    uint8_t command;
+    TickType_t sent_at;
+} radar_cmd_inflight_t;
+
+// A finished tracked request, copied out so its callback can run unlocked
+typedef struct {
+    radar_cmd_handle_t handle;
+    radar_cmd_done_cb_t cb;
+    void *cb_ctx;
+} radar_cmd_completion_t;
+
+static radar_cmd_job_t s_jobs[RADAR_CMD_MAX_JOBS];
+static radar_cmd_inflight_t s_inflight[RADAR_CMD_MAX_INFLIGHT];
+static radar_cmd_stats_t s_stats;
+static uint32_t s_seq;
+static radar_cmd_handle_t s_next_handle;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static uart_port_t s_port;
+
+// due is in the past or now (tick counter may wrap)
+static inline bool tick_reached(TickType_t now, TickType_t due)
+{
+    return (int32_t)(now - due) >= 0;
+}
+
+static radar_cmd_job_t *find_job(const uint8_t *frame, size_t len, bool periodic)
+{
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        radar_cmd_job_t *job = &s_jobs[i];
+        if (job->used && !job->tracked && job->periodic == periodic && job->len == len &&
+            memcmp(job->frame, frame, len) == 0) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static radar_cmd_job_t *alloc_job(void)
+{
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        if (!s_jobs[i].used) {
+            memset(&s_jobs[i], 0, sizeof(s_jobs[i]));
+            return &s_jobs[i];
+        }
+    }
+    return NULL;
+}
+
+static void fill_job(radar_cmd_job_t *job, const uint8_t *frame, size_t len, radar_cmd_prio_t prio)
+{
+    job->used = true;
+    job->prio = prio;
+    job->len = len;
+    memcpy(job->frame, frame, len);
+    job->due = xTaskGetTickCount();
+    job->seq = s_seq++;
+}
+
+// Free a tracked job and return what is needed to run its callback (caller holds s_lock)
+static radar_cmd_completion_t finish_job(radar_cmd_job_t *job)
+{
+    radar_cmd_completion_t done = { job->handle, job->cb, job->cb_ctx };
+    job->used = false;
+    return done;
+}
+
+static void wake_scheduler(void)
+{
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static esp_err_t add_job(const uint8_t *frame, size_t len, uint32_t period_ms, radar_cmd_prio_t prio)
+{
+    bool periodic = period_ms > 0;
+    if (len < 4 || len > RADAR_CMD_MAX_FRAME) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    radar_cmd_job_t *job = find_job(frame, len, periodic);
+    if (job != NULL) {
+        if (periodic) {
+            job->period = pdMS_TO_TICKS(period_ms);
+        } else {
+            s_stats.deduplicated++;
+        }
+        if (prio < job->prio) {
+            job->prio = prio;
+        }
+    } else if ((job = alloc_job()) != NULL) {
+        fill_job(job, frame, len, prio);
+        job->periodic = periodic;
+        job->period = pdMS_TO_TICKS(period_ms);
+    } else {
+        s_stats.dropped++;
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(s_lock);
+
+    wake_scheduler();
+    return ret;
+}
+
+esp_err_t radar_cmd_submit(const uint8_t *frame, size_t len, radar_cmd_prio_t prio)
+{
+    return add_job(frame, len, 0, prio);
+}
+
+esp_err_t radar_cmd_schedule(const uint8_t *frame, size_t len, uint32_t period_ms, radar_cmd_prio_t prio)
+{
+    if (period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return add_job(frame, len, period_ms, prio);
+}
+
+radar_cmd_handle_t radar_cmd_request(const uint8_t *frame, size_t len, const radar_cmd_opts_t *opts)
+{
+    static const radar_cmd_opts_t defaults = RADAR_CMD_OPTS_DEFAULT;
+    if (opts == NULL) {
+        opts = &defaults;
+    }
+    if (len < 4 || len > RADAR_CMD_MAX_FRAME) {
+        return 0;
+    }
+
+    radar_cmd_handle_t handle = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    radar_cmd_job_t *job = alloc_job();
+    if (job != NULL) {
+        fill_job(job, frame, len, opts->prio);
+        job->tracked = true;
+        job->retries_left = opts->retries < 0 ? CONFIG_RADAR_CMD_RETRIES : opts->retries;
+        job->timeout = opts->timeout_ms ? pdMS_TO_TICKS(opts->timeout_ms) : RESPONSE_TIMEOUT;
+        job->cb = opts->cb;
+        job->match = opts->match;
+        job->cb_ctx = opts->ctx;
+        if (++s_next_handle == 0) {
+            s_next_handle = 1;
+        }
+        job->handle = handle = s_next_handle;
+    } else {
+        s_stats.dropped++;
+    }
+    xSemaphoreGive(s_lock);
+
+    wake_scheduler();
+    return handle;
+}
+
+bool radar_cmd_cancel(radar_cmd_handle_t handle)
+{
+    radar_cmd_completion_t done = { 0 };
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS && handle != 0; i++) {
+        radar_cmd_job_t *job = &s_jobs[i];
+        if (job->used && job->tracked && job->handle == handle) {
+            done = finish_job(job);
+            break;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (done.handle == 0) {
+        return false;
+    }
+    if (done.cb) {
+        done.cb(done.handle, RADAR_CMD_CANCELLED, NULL, done.cb_ctx);
+    }
+    // The opcode may be free again; a queued request for it may now go out
+    wake_scheduler();
+    return true;
+}
+
+// Remember that a reply to this opcode is expected (caller holds s_lock)
+static void track_inflight(uint8_t control, uint8_t command, TickType_t now)
+{
+    radar_cmd_inflight_t *slot = NULL;
+    for (int i = 0; i < RADAR_CMD_MAX_INFLIGHT; i++) {
+        radar_cmd_inflight_t *f = &s_inflight[i];
+        if (f->used && f->control == control && f->command == command) {
+            slot = f;   // re-sent before the reply came back; restart its clock
+            break;
+        }
+        if (!f->used && slot == NULL) {
+            slot = f;
+        }
+    }
+    if (slot == NULL) {
+        return;
+    }
+    slot->used = true;
+    slot->control = control;
+    slot->command = command;
+    slot->sent_at = now;
+}
+
+// The tracked request that owns this frame's opcode and has been transmitted
+// (caller holds s_lock)
+static radar_cmd_job_t *reply_owner(const radar_frame_t *frame)
+{
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        radar_cmd_job_t *job = &s_jobs[i];
+        if (job->used && job->awaiting && job->on_wire &&
+            job->frame[2] == frame->control && job->frame[3] == frame->command) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void radar_cmd_on_response(const radar_frame_t *frame)
+{
+    TickType_t now = xTaskGetTickCount();
+    radar_cmd_completion_t done = { 0 };
+    radar_cmd_handle_t owner = 0;
+    radar_cmd_match_cb_t match = NULL;
+    void *match_ctx = NULL;
+    bool matched = false;
+
+    // A tracked request owns its opcode while it is awaiting a reply. Its
+    // match callback decides (unlocked) whether this frame is that reply.
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    radar_cmd_job_t *job = reply_owner(frame);
+    if (job != NULL) {
+        owner = job->handle;
+        match = job->match;
+        match_ctx = job->cb_ctx;
+    }
+    xSemaphoreGive(s_lock);
+    bool accepted = owner != 0 && (match == NULL || match(frame, match_ctx));
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    job = accepted ? reply_owner(frame) : NULL;
+    if (job != NULL && job->handle == owner) {
+        s_stats.last_rtt_ms = pdTICKS_TO_MS(now - job->sent_at);
+        done = finish_job(job);
+        matched = true;
+    }
+    for (int i = 0; i < RADAR_CMD_MAX_INFLIGHT && !matched; i++) {
+        radar_cmd_inflight_t *f = &s_inflight[i];
+        if (f->used && f->control == frame->control && f->command == frame->command) {
+            f->used = false;
+            s_stats.last_rtt_ms = pdTICKS_TO_MS(now - f->sent_at);
+            matched = true;
+        }
+    }
+    if (matched) {
+        s_stats.responses++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (done.cb) {
+        done.cb(done.handle, RADAR_CMD_OK, frame, done.cb_ctx);
+    }
+    if (done.handle != 0) {
+        // The opcode is free again; a queued request for it may now go out
+        wake_scheduler();
+    }
+}
+
+void radar_cmd_get_stats(radar_cmd_stats_t *stats)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+// Is a tracked request for this opcode already waiting for its reply? (caller holds s_lock)
+static bool opcode_busy(uint8_t control, uint8_t command)
+{
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        const radar_cmd_job_t *job = &s_jobs[i];
+        if (job->used && job->awaiting && job->frame[2] == control && job->frame[3] == command) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Retry or fail one tracked request whose reply is overdue. Returns true and
+// fills *done if a request ran out of retries; its callback must then be run.
+static bool expire_one(TickType_t now, radar_cmd_completion_t *done)
+{
+    bool failed = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < RADAR_CMD_MAX_INFLIGHT; i++) {
+        radar_cmd_inflight_t *f = &s_inflight[i];
+        if (f->used && (now - f->sent_at) >= RESPONSE_TIMEOUT) {
+            f->used = false;
+            s_stats.timeouts++;
+        }
+    }
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        radar_cmd_job_t *job = &s_jobs[i];
+        if (!job->used || !job->awaiting || (now - job->sent_at) < job->timeout) {
+            continue;
+        }
+        s_stats.timeouts++;
+        if (job->retries_left > 0) {
+            job->retries_left--;
+            job->awaiting = false;
+            job->due = now;
+            s_stats.retries++;
+            continue;
+        }
+        s_stats.failed++;
+        *done = finish_job(job);
+        failed = true;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+    return failed;
+}
+
+// Pick the due job with the best priority (oldest first among equals), copy it
+// out and reschedule or free it. *handle is set for a tracked job. Returns the
+// ticks to sleep if nothing is due.
+static TickType_t take_next_job(TickType_t now, uint8_t *frame, uint8_t *len, radar_cmd_handle_t *handle)
+{
+    radar_cmd_job_t *best = NULL;
+    TickType_t sleep = portMAX_DELAY;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < RADAR_CMD_MAX_JOBS; i++) {
+        radar_cmd_job_t *job = &s_jobs[i];
+        if (!job->used) {
+            continue;
+        }
+        if (job->awaiting) {
+            // Wake up in time to retry or fail it
+            TickType_t left = job->timeout - (now - job->sent_at);
+            if ((int32_t)left > 0 && left < sleep) {
+                sleep = left;
+            }
+            continue;
+        }
+        if (!tick_reached(now, job->due)) {
+            TickType_t left = job->due - now;
+            if (left < sleep) {
+                sleep = left;
+            }
+            continue;
+        }
+        if (job->tracked && opcode_busy(job->frame[2], job->frame[3])) {
+            continue;   // woken again when the earlier request completes
+        }
+        if (best == NULL || job->prio < best->prio ||
+            (job->prio == best->prio && (int32_t)(job->seq - best->seq) < 0)) {
+            best = job;
+        }
+    }
+    if (best != NULL) {
+        memcpy(frame, best->frame, best->len);
+        *len = best->len;
+        *handle = best->tracked ? best->handle : 0;
+        if (best->tracked) {
+            best->awaiting = true;
+            best->on_wire = false;
+            best->sent_at = now;
+        } else {
+            track_inflight(best->frame[2], best->frame[3], now);
+            if (best->periodic) {
+                // Skip missed periods rather than bursting to catch up
+                best->due = now + best->period;
+                best->seq = s_seq++;
+            } else {
+                best->used = false;
+            }
+        }
+        sleep = 0;
+    }
+    xSemaphoreGive(s_lock);
+    return sleep;
+}
+
+static void radar_cmd_task(void *arg)
+{
+    uint8_t frame[RADAR_CMD_MAX_FRAME];
+    uint8_t len = 0;
+    TickType_t last_tx = xTaskGetTickCount() - TX_GAP_TICKS;
+
+    while (1) {
+        // Rate limit the radar's RX line
+        TickType_t since_tx = xTaskGetTickCount() - last_tx;
+        if (since_tx < TX_GAP_TICKS) {
+            vTaskDelay(TX_GAP_TICKS - since_tx);
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        radar_cmd_completion_t done;
+        while (expire_one(now, &done)) {
+            if (done.cb) {
+                done.cb(done.handle, RADAR_CMD_TIMEOUT, NULL, done.cb_ctx);
+            }
+        }
+
+        radar_cmd_handle_t handle = 0;
+        TickType_t sleep = take_next_job(now, frame, &len, &handle);
+        if (sleep > 0) {
+            // Nothing due: wait for the next deadline or a new submission
+            ulTaskNotifyTake(pdTRUE, sleep);
+            continue;
+        }
+
+        uart_write_bytes(s_port, (const char *)frame, len);
+        uart_wait_tx_done(s_port, TX_GAP_TICKS);
+        last_tx = xTaskGetTickCount();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.sent++;
+        // Frames decoded from now on can be the reply; anything earlier was
+        // already on its way (a periodic report, or a reply to an older request)
+        for (int i = 0; i < RADAR_CMD_MAX_JOBS && handle != 0; i++) {
+            radar_cmd_job_t *job = &s_jobs[i];
+            if (job->used && job->awaiting && job->handle == handle) {
+                job->on_wire = true;
+                job->sent_at = last_tx;
+                break;
+            }
+        }
+        xSemaphoreGive(s_lock);
+    }
+}
+
+void radar_cmd_init(uart_port_t port)
+{
+    s_port = port;
+    s_lock = xSemaphoreCreateMutex();
+    xTaskCreate(radar_cmd_task, "radar_cmd", 3072, NULL, TASK_PRIO_RADAR_CMD, &s_task);
+}
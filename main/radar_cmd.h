@@ -0,0 +1,89 @@
+#ifndef RADAR_CMD_H
+#define RADAR_CMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+#include "radar_frame.h"
+
+#define RADAR_CMD_MAX_FRAME     24   // longest command frame we send
+#define RADAR_CMD_MAX_JOBS      32   // periodic + pending one-shot jobs
+#define RADAR_CMD_MAX_INFLIGHT  8    // untracked commands awaiting a reply (stats only)
+
+typedef enum {
+    RADAR_CMD_PRIO_HIGH = 0,    // configuration commands
+    RADAR_CMD_PRIO_NORMAL,      // live-data queries (height proportion, heartbeat)
+    RADAR_CMD_PRIO_LOW,         // housekeeping (product info, working status)
+} radar_cmd_prio_t;
+
+// Outcome of a tracked request (radar_cmd_request)
+typedef enum {
+    RADAR_CMD_OK = 0,           // the radar answered and the reply was accepted
+    RADAR_CMD_TIMEOUT,          // no answer after all retries
+    RADAR_CMD_CANCELLED,        // cancelled before an answer arrived
+} radar_cmd_result_t;
+
+// 0 is never a valid handle
+typedef uint32_t radar_cmd_handle_t;
+
+// Completion callback. reply is the matching frame for RADAR_CMD_OK and NULL
+// otherwise; it is only valid during the call. Runs on the UART reader task
+// (replies) or the scheduler task (timeouts), so keep it short.
+typedef void (*radar_cmd_done_cb_t)(radar_cmd_handle_t handle, radar_cmd_result_t result,
+                                    const radar_frame_t *reply, void *ctx);
+
+// Reply filter. Called with each frame that has the request's control/command
+// and arrived after the request was sent; return false if it is not the reply
+// (e.g. a periodic report on the same opcode) to keep waiting. Runs on the
+// UART reader task without the scheduler lock held.
+typedef bool (*radar_cmd_match_cb_t)(const radar_frame_t *reply, void *ctx);
+
+typedef struct {
+    radar_cmd_prio_t prio;
+    uint32_t timeout_ms;        // per attempt; 0 = CONFIG_RADAR_CMD_RESPONSE_TIMEOUT_MS
+    int8_t retries;             // extra attempts after a timeout; -1 = CONFIG_RADAR_CMD_RETRIES
+    radar_cmd_done_cb_t cb;
+    radar_cmd_match_cb_t match; // NULL = the first frame with the same opcode is the reply
+    void *ctx;                  // passed to cb and match
+} radar_cmd_opts_t;
+
+#define RADAR_CMD_OPTS_DEFAULT { .prio = RADAR_CMD_PRIO_HIGH, .timeout_ms = 0, .retries = -1, .cb = NULL, .match = NULL, .ctx = NULL }
+
+typedef struct {
+    uint32_t sent;          // frames written to the radar
+    uint32_t deduplicated;  // submissions dropped because an identical frame was already queued
+    uint32_t dropped;       // submissions dropped because the job table was full
+    uint32_t responses;     // replies matched to an in-flight command
+    uint32_t timeouts;      // in-flight commands that got no reply in time
+    uint32_t last_rtt_ms;   // round-trip time of the most recent matched reply
+    uint32_t retries;       // tracked requests re-sent after a timeout
+    uint32_t failed;        // tracked requests that ran out of retries
+} radar_cmd_stats_t;
+
+// Start the command scheduler. It becomes the only writer on the radar's TX line.
+void radar_cmd_init(uart_port_t port);
+
+// Queue a one-shot frame. An identical frame that is still queued is not sent twice.
+esp_err_t radar_cmd_submit(const uint8_t *frame, size_t len, radar_cmd_prio_t prio);
+
+// Send a frame every period_ms. Scheduling the same frame again only updates its period/priority.
+esp_err_t radar_cmd_schedule(const uint8_t *frame, size_t len, uint32_t period_ms, radar_cmd_prio_t prio);
+
+// Send a frame and track it until the radar answers with the same
+// control/command (and opts->match accepts the answer). Requests for the same opcode are sent one at a time so each
+// reply can be attributed; requests for different opcodes are pipelined.
+// Returns 0 if the job table is full (the callback is not called in that case).
+radar_cmd_handle_t radar_cmd_request(const uint8_t *frame, size_t len, const radar_cmd_opts_t *opts);
+
+// Cancel a tracked request. Its callback runs with RADAR_CMD_CANCELLED unless it
+// already completed. Returns false if the handle is unknown.
+bool radar_cmd_cancel(radar_cmd_handle_t handle);
+
+// Feed every frame received from the radar so replies can be matched to commands.
+void radar_cmd_on_response(const radar_frame_t *frame);
+
+void radar_cmd_get_stats(radar_cmd_stats_t *stats);
+
+#endif // RADAR_CMD_H
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "radar_reports.h"
+#include "metrics.h"
+#include "radar_log.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_RADAR_LOG_RING_SIZE
+#define CONFIG_RADAR_LOG_RING_SIZE 4096
+#endif
+#ifndef CONFIG_RADAR_LOG_FLUSH_MS
+#define CONFIG_RADAR_LOG_FLUSH_MS 50
+#endif
+
+#define RING_SIZE   CONFIG_RADAR_LOG_RING_SIZE
+#define RING_MASK   (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_RADAR_LOG_RING_SIZE must be a power of two");
+_Static_assert(RADAR_FRAME_MAX_LEN <= UINT8_MAX, "record length is one byte");
+
+#define RECORD_KNOWN            0x01
+#define RECORD_FIRST_UNKNOWN    0x02
+
+// Followed by len raw frame bytes; records wrap around the end of the ring
+typedef struct {
+    uint32_t time_ms;
+    uint8_t flags;
+    uint8_t len;
+    uint8_t reserved[2];
+} record_hdr_t;
+
+static uint8_t s_ring[RING_SIZE];
+static atomic_uint_least32_t s_head;    // free-running, advanced by the UART task
+static atomic_uint_least32_t s_tail;    // free-running, advanced by the log task
+static atomic_uint_least32_t s_dropped;
+static atomic_int s_level = CONFIG_RADAR_LOG_DEFAULT_LEVEL;
+
+static const char *const s_level_names[] = { "none", "error", "warn", "info", "debug", "verbose" };
+
+static void ring_put(uint32_t pos, const void *src, size_t len)
+{
+    size_t off = pos & RING_MASK;
+    size_t first = len < RING_SIZE - off ? len : RING_SIZE - off;
+    memcpy(&s_ring[off], src, first);
+    memcpy(s_ring, (const uint8_t *)src + first, len - first);
+}
+
+static void ring_get(uint32_t pos, void *dst, size_t len)
+{
+    size_t off = pos & RING_MASK;
+    size_t first = len < RING_SIZE - off ? len : RING_SIZE - off;
+    memcpy(dst, &s_ring[off], first);
+    memcpy((uint8_t *)dst + first, s_ring, len - first);
+}
+
+void radar_log_frame(const radar_frame_t *frame, bool known, bool first_unknown)
+{
+    esp_log_level_t needed = known ? ESP_LOG_INFO : first_unknown ? ESP_LOG_WARN : ESP_LOG_DEBUG;
+    if (atomic_load_explicit(&s_level, memory_order_relaxed) < (int)needed) {
+        return;
+    }
+
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+    uint32_t len = sizeof(record_hdr_t) + frame->raw_len;
+    if (RING_SIZE - (head - tail) < len) {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+        metrics_inc(METRIC_RADAR_LOG_DROPPED);
+        return;
+    }
+
+    record_hdr_t hdr = {
+        .time_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .flags = (known ? RECORD_KNOWN : 0) | (first_unknown ? RECORD_FIRST_UNKNOWN : 0),
+        .len = (uint8_t)frame->raw_len,
+    };
+    ring_put(head, &hdr, sizeof(hdr));
+    ring_put(head + sizeof(hdr), frame->raw, frame->raw_len);
+    atomic_store_explicit(&s_head, head + len, memory_order_release);
+}
+
+// One line of space-separated hex bytes, printed with a single call
+static void print_hex(uint32_t time_ms, const char *title, const uint8_t *data, size_t len)
+{
+    char hex[RADAR_FRAME_MAX_LEN * 3 + 1];
+    for (size_t i = 0; i < len; i++) {
+        snprintf(&hex[i * 3], 4, "%02X ", data[i]);
+    }
+    hex[len * 3] = '\0';
+    printf("(%" PRIu32 ") %s: %s\n", time_ms, title, hex);
+}
+
+static void print_height_proportion(const char *title, uint16_t total, const uint8_t prop[4])
+{
+    printf("%s:\n", title);
+    printf("  Total Count: %d\n", total);
+    printf("  0-0.5m: %d (%d%%)\n", prop[0], total > 0 ? (prop[0] * 100 / total) : 0);
+    printf("  0.5-1m: %d (%d%%)\n", prop[1], total > 0 ? (prop[1] * 100 / total) : 0);
+    printf("  1-1.5m: %d (%d%%)\n", prop[2], total > 0 ? (prop[2] * 100 / total) : 0);
+    printf("  1.5-2m: %d (%d%%)\n", prop[3], total > 0 ? (prop[3] * 100 / total) : 0);
+}
+
+static void print_report(uint32_t time_ms, const radar_report_t *r)
+{
+    printf("(%" PRIu32 ") ", time_ms);
+    switch (r->id) {
+        case RADAR_RPT_PRESENCE:
+            printf("Parsed Presence: %d\n", r->flag);
+            break;
+        case RADAR_RPT_WORKING_STATUS:
+            printf("Parsed Working Status: 0x%02X\n", r->u8);
+            break;
+        case RADAR_RPT_WORKING_STATUS_ACK:
+            printf("Parsed Working Status Query Ack: 0x%02X\n", r->u8);
+            break;
+        case RADAR_RPT_MOVEMENT_STATE:
+            printf("Parsed Movement State: %d\n", r->u8);
+            break;
+        case RADAR_RPT_BODY_MOVEMENT:
+            printf("Parsed Body Movement Param: %d\n", r->u8);
+            break;
+        case RADAR_RPT_FALL_ALARM:
+            printf("Parsed Fall Alarm: %d\n", r->flag);
+            break;
+        case RADAR_RPT_STAY_STILL_ALARM:
+            printf("Parsed Stay-still Alarm: %d\n", r->flag);
+            break;
+        case RADAR_RPT_HEARTBEAT:
+            printf("Parsed Heartbeat: %d\n", r->u8);
+            break;
+        case RADAR_RPT_TRAJECTORY:
+            printf("Parsed Trajectory: X=%d, Y=%d\n", r->traj.x, r->traj.y);
+            break;
+        case RADAR_RPT_HEIGHT_PROPORTION: {
+            uint16_t total = r->height_prop.total;
+            const uint8_t *prop = r->height_prop.prop;
+            if (r->fallback) {
+                print_height_proportion("Height Proportion Report (fallback)", total, prop);
+                break;
+            }
+            print_height_proportion("Height Proportion Report", total, prop);
+            uint16_t sum = prop[0] + prop[1] + prop[2] + prop[3];
+            if (sum != total) {
+                printf("  WARNING: Sum of proportions (%d) doesn't match total (%d)\n", sum, total);
+            }
+            break;
+        }
+        case RADAR_RPT_NON_PRESENCE_TIME:
+            printf("Parsed Non-presence Time: %" PRIu32 " seconds\n", r->u32);
+            break;
+        case RADAR_RPT_SCENARIO:
+            printf("Parsed Scenario Report: %d\n", r->u8);
+            break;
+        case RADAR_RPT_INSTALL_ANGLES:
+            printf("Parsed Installation Angle: X=%d, Y=%d, Z=%d\n", r->angles.x, r->angles.y, r->angles.z);
+            break;
+        case RADAR_RPT_INSTALL_HEIGHT:
+            printf("Parsed Installation Height: %d cm\n", r->u16);
+            break;
+        case RADAR_RPT_FALL_PARAMS:
+            printf("Parsed Fall Detection Parameters: Sensitivity=%d, Duration=%" PRIu32 " s, Breaking Height=%d cm\n",
+                   r->fall.sensitivity, r->fall.duration, r->fall.breaking_height);
+            break;
+        case RADAR_RPT_FALL_SENSITIVITY:
+            printf("Parsed Fall Detection Sensitivity: %d\n", r->u8);
+            break;
+        case RADAR_RPT_FALL_DURATION:
+            printf("Parsed Fall Duration: %" PRIu32 " seconds\n", r->u32);
+            break;
+        case RADAR_RPT_FALL_BREAKING_HEIGHT:
+            printf("Parsed Fall Breaking Height: %d cm\n", r->u16);
+            break;
+        case RADAR_RPT_SITTING_STILL_DISTANCE:
+            printf("Parsed Sitting-still Horizontal Distance: %d cm\n", r->u16);
+            break;
+        case RADAR_RPT_MOVING_DISTANCE:
+            printf("Parsed Moving Horizontal Distance: %d cm\n", r->u16);
+            break;
+        case RADAR_RPT_PRODUCT_MODEL:
+            printf("Parsed Product Model: %s\n", r->text);
+            break;
+        case RADAR_RPT_PRODUCT_ID:
+            printf("Parsed Product ID: %s\n", r->text);
+            break;
+        case RADAR_RPT_HARDWARE_MODEL:
+            printf("Parsed Hardware Model: %s\n", r->text);
+            break;
+        case RADAR_RPT_FIRMWARE_VERSION:
+            printf("Parsed Firmware Version: %s\n", r->text);
+            break;
+        case RADAR_RPT_OPERATING_TIME:
+            printf("Parsed Operating Time: %" PRIu32 " seconds\n", r->u32);
+            break;
+        case RADAR_RPT_STAY_STILL_SWITCH:
+            printf("Parsed Stay-still Switch: %s\n", r->flag ? "Enabled" : "Disabled");
+            break;
+        case RADAR_RPT_STAY_STILL_DURATION:
+            printf("Parsed Stay-still Duration: %" PRIu32 " seconds\n", r->u32);
+            break;
+        case RADAR_RPT_HEIGHT_ACCUMULATION_TIME:
+            printf("Parsed Height Cumulation Time: %" PRIu32 " seconds\n", r->u32);
+            break;
+        case RADAR_RPT_HEIGHT_MEASUREMENT:
+            printf("✅ Parsed Height Measurement Frame: Height = %d cm\n", r->u16);
+            break;
+        default:
+            printf("Parsed %s\n", radar_report_name(r->id));
+            break;
+    }
+}
+
+static void print_record(const record_hdr_t *hdr, const uint8_t *raw)
+{
+    esp_log_level_t level = radar_log_get_level();
+    radar_frame_t frame = {
+        .control = raw[2],
+        .command = raw[3],
+        .payload_len = hdr->len - RADAR_FRAME_OVERHEAD,
+        .payload = raw + RADAR_FRAME_PREFIX_LEN,
+        .raw = raw,
+        .raw_len = hdr->len,
+    };
+
+    if (level >= ESP_LOG_DEBUG) {
+        print_hex(hdr->time_ms, "Raw frame", raw, hdr->len);
+    }
+    if (hdr->flags & RECORD_KNOWN) {
+        // Decoding a known opcode has no side effects, so it is safe to repeat here
+        radar_report_t report;
+        if (level >= ESP_LOG_INFO && radar_report_decode(&frame, &report)) {
+            print_report(hdr->time_ms, &report);
+        }
+    } else if ((hdr->flags & RECORD_FIRST_UNKNOWN) && level >= ESP_LOG_WARN) {
+        // Only the first frame of each unknown opcode is dumped; the rest are counted
+        char title[48];
+        snprintf(title, sizeof(title), "🚨🚨 Unknown Frame 0x%02X/0x%02X 🚨🚨", frame.control, frame.command);
+        print_hex(hdr->time_ms, title, frame.payload, frame.payload_len);
+    }
+}
+
+static void radar_log_task(void *arg)
+{
+    static uint8_t raw[RADAR_FRAME_MAX_LEN];
+    uint32_t reported_drops = 0;
+
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&s_head, memory_order_acquire);
+        if (tail == head) {
+            uint32_t dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+            if (dropped != reported_drops) {
+                printf("Radar log: %" PRIu32 " record(s) dropped, console too slow\n", dropped - reported_drops);
+                reported_drops = dropped;
+            }
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_RADAR_LOG_FLUSH_MS));
+            continue;
+        }
+
+        record_hdr_t hdr;
+        ring_get(tail, &hdr, sizeof(hdr));
+        ring_get(tail + sizeof(hdr), raw, hdr.len);
+        // Free the slot before the (slow) printing
+        atomic_store_explicit(&s_tail, tail + sizeof(hdr) + hdr.len, memory_order_release);
+        print_record(&hdr, raw);
+    }
+}
+
+void radar_log_init(void)
+{
+    xTaskCreate(radar_log_task, "radar_log", 3072, NULL, TASK_PRIO_RADAR_LOG, NULL);
+}
+
+void radar_log_set_level(esp_log_level_t level)
+{
+    if (level > ESP_LOG_VERBOSE) {
+        level = ESP_LOG_VERBOSE;
+    }
+    atomic_store_explicit(&s_level, (int)level, memory_order_relaxed);
+}
+
+esp_log_level_t radar_log_get_level(void)
+{
+    return (esp_log_level_t)atomic_load_explicit(&s_level, memory_order_relaxed);
+}
+
+bool radar_log_level_from_str(const char *s, size_t len, esp_log_level_t *level)
+{
+    if (len == 1 && s[0] >= '0' && s[0] <= '5') {
+        *level = (esp_log_level_t)(s[0] - '0');
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(s_level_names) / sizeof(s_level_names[0]); i++) {
+        if (strlen(s_level_names[i]) == len && strncmp(s, s_level_names[i], len) == 0) {
+            *level = (esp_log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *radar_log_level_to_str(esp_log_level_t level)
+{
+    return level <= ESP_LOG_VERBOSE ? s_level_names[level] : "?";
+}
@@ -0,0 +1,41 @@
+#ifndef RADAR_LOG_H
+#define RADAR_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "radar_frame.h"
+
+// Deferred console log for the radar UART path. uart_read_task only copies
+// the frame bytes and a timestamp into a lock-free ring (single producer,
+// single consumer); a low-priority task decodes and prints them later, so a
+// slow console never stalls the frame decoder. Frames below the current
+// level are not even copied. When the ring is full the record is dropped and
+// counted (radar.log_dropped).
+//
+// Levels (esp_log_level_t):
+//   WARN     the first frame of every unknown opcode, with its payload
+//   INFO     one "Parsed ..." line per decoded report (default)
+//   DEBUG    also "Raw frame: 53 59 ..." for every frame (radar_replay reads these)
+
+#ifndef CONFIG_RADAR_LOG_DEFAULT_LEVEL
+#define CONFIG_RADAR_LOG_DEFAULT_LEVEL 3    // ESP_LOG_INFO
+#endif
+
+// Start the formatting task. Frames logged before this are kept in the ring.
+void radar_log_init(void);
+
+// Queue a checksum-verified frame. known: radar_report_decode() accepted it;
+// first_unknown: first frame seen with this unknown opcode.
+// Must only be called from the UART task (the ring has one producer).
+void radar_log_frame(const radar_frame_t *frame, bool known, bool first_unknown);
+
+void radar_log_set_level(esp_log_level_t level);
+esp_log_level_t radar_log_get_level(void);
+
+// "none", "error", "warn", "info", "debug", "verbose" or a digit 0-5
+bool radar_log_level_from_str(const char *s, size_t len, esp_log_level_t *level);
+const char *radar_log_level_to_str(esp_log_level_t level);
+
+#endif // RADAR_LOG_H
@@ -0,0 +1,67 @@
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "radar_state.h"
+
+#define RADAR_STATE_DEFAULTS { .stay_still_switch = true, .fall_detection_switch = true }
+
+static radar_state_t s_work = RADAR_STATE_DEFAULTS;       // writer only
+static radar_state_t s_published = RADAR_STATE_DEFAULTS;  // guarded by s_seq
+
+// Odd while a publish is in progress; s_seq / 2 is the snapshot version
+static uint32_t s_seq = 0;
+static radar_state_versions_t s_versions;   // guarded by s_seq like s_published
+
+#define SETTINGS_START  offsetof(radar_state_t, working_status)
+#define PRODUCT_START   offsetof(radar_state_t, operating_time)
+
+static bool span_changed(size_t start, size_t end)
+{
+    return memcmp((const uint8_t *)&s_work + start, (const uint8_t *)&s_published + start, end - start) != 0;
+}
+
+radar_state_t *radar_state_edit(void)
+{
+    return &s_work;
+}
+
+void radar_state_publish(void)
+{
+    // Only the writer changes s_published, so it can compare without the lock
+    bool settings = span_changed(SETTINGS_START, PRODUCT_START) ||
+                    s_work.non_presence_time != s_published.non_presence_time;
+    bool product = span_changed(PRODUCT_START, sizeof(radar_state_t));
+
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_RELAXED);
+    // Readers must see the odd sequence before any of the copied bytes
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&s_published, &s_work, sizeof(s_published));
+    s_versions.settings += settings;
+    s_versions.product += product;
+    __atomic_store_n(&s_seq, s_seq + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t radar_state_snapshot(radar_state_t *out)
+{
+    radar_state_versions_t versions;
+    return radar_state_snapshot_versions(out, &versions);
+}
+
+uint32_t radar_state_snapshot_versions(radar_state_t *out, radar_state_versions_t *versions)
+{
+    while (1) {
+        uint32_t seq = __atomic_load_n(&s_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            // The writer was preempted mid-copy; let it finish
+            vTaskDelay(1);
+            continue;
+        }
+        memcpy(out, &s_published, sizeof(*out));
+        *versions = s_versions;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s_seq, __ATOMIC_RELAXED) == seq) {
+            return seq / 2;
+        }
+    }
+}
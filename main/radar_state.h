@@ -0,0 +1,79 @@
+#ifndef RADAR_STATE_H
+#define RADAR_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PRODUCT_STR_LEN 32
+
+// Everything the firmware knows about the radar: live readings, confirmed
+// settings and product information.
+typedef struct {
+    // Live data (change frequently)
+    bool     presence;              // Human presence
+    bool     fall_alarm;            // Fall detection
+    bool     stay_still_alarm;      // Stay-still alarm
+    uint8_t  movement_state;        // 0: No movement, 1: Static, 2: Active
+    uint8_t  body_movement_param;   // Body movement parameter
+    uint8_t  heartbeat;             // Heartbeat value
+    int16_t  traj_x;                // Trajectory point
+    int16_t  traj_y;
+    uint16_t total_height_count;    // Height proportion report
+    uint8_t  height_prop_0_0_5;
+    uint8_t  height_prop_0_5_1;
+    uint8_t  height_prop_1_1_5;
+    uint8_t  height_prop_1_5_2;
+    uint32_t non_presence_time;     // Seconds
+
+    // Settings (change infrequently)
+    uint8_t  working_status;        // Working status report (spontaneous or query reply)
+    uint8_t  scenario;
+    int16_t  installation_angle_x;
+    int16_t  installation_angle_y;
+    int16_t  installation_angle_z;
+    uint16_t installation_height;   // cm
+    uint8_t  fall_detection_sensitivity;
+    uint32_t fall_duration;         // Seconds
+    uint16_t fall_breaking_height;  // cm
+    uint16_t sitting_still_distance; // cm
+    uint16_t moving_distance;       // cm
+    bool     stay_still_switch;
+    uint32_t stay_still_duration;   // Seconds
+    uint32_t height_accumulation_time; // Seconds
+    bool     fall_detection_switch;
+
+    // Product information (queried from the device)
+    uint32_t operating_time;        // Seconds
+    char product_model[PRODUCT_STR_LEN];
+    char product_id[PRODUCT_STR_LEN];
+    char hardware_model[PRODUCT_STR_LEN];
+    char firmware_version[PRODUCT_STR_LEN];
+} radar_state_t;
+
+// There is exactly one writer: app_main while it seeds settings, then the
+// UART reader task. It edits a private working copy and publishes it with a
+// single copy under a sequence lock, so it never blocks. Readers copy the
+// published struct and retry if a publish overlapped the copy.
+
+// Working copy for the writer. Changes are invisible until radar_state_publish().
+radar_state_t *radar_state_edit(void);
+
+// Make the working copy the published state
+void radar_state_publish(void);
+
+// Copy a consistent snapshot into out. Returns its version, which increases
+// by one with every completed write.
+uint32_t radar_state_snapshot(radar_state_t *out);
+
+// Versions of the slow-changing sections, bumped only by a write that changed
+// them, so serialized settings / product info can be cached against them.
+// non_presence_time counts as a setting too (it is reported with them).
+typedef struct {
+    uint32_t settings;      // working_status .. fall_detection_switch
+    uint32_t product;       // operating_time .. firmware_version
+} radar_state_versions_t;
+
+// radar_state_snapshot() plus the section versions of the same snapshot
+uint32_t radar_state_snapshot_versions(radar_state_t *out, radar_state_versions_t *versions);
+
+#endif // RADAR_STATE_H
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "sdkconfig.h"
+#include "live_binary.h"
+#include "settings_store.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_SETTINGS_SAVE_DELAY_MS
+#define CONFIG_SETTINGS_SAVE_DELAY_MS 2000
+#endif
+
+#define SETTINGS_NAMESPACE  "radar_config"
+#define SETTINGS_KEY        "settings"
+#define SAVE_DELAY          pdMS_TO_TICKS(CONFIG_SETTINGS_SAVE_DELAY_MS)
+#define SAVE_MAX_DELAY      (SAVE_DELAY * 5)   // bound coalescing under a steady stream of changes
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t len;                   // sizeof(settings_values_t) when written
+    settings_values_t values;
+    uint32_t crc;                   // CRC-32 of everything above
+} settings_blob_t;
+
+static const settings_values_t s_defaults = {
+    .installation_height = 200,
+    .fall_detection_sensitivity = 3,
+    .fall_duration = 5,
+    .fall_breaking_height = 20,
+    .sitting_still_distance = 300,
+    .moving_distance = 30,
+    .stay_still_switch = 0,
+    .stay_still_duration = 60,
+    .fall_detection_switch = 1,
+    .non_presence_time = 5,
+    .height_accumulation_time = 60,
+    .live_format = LIVE_FORMAT_JSON,
+};
+
+static settings_snapshot_fn_t s_snapshot;
+static TaskHandle_t s_task;
+static uint32_t s_dirty;
+static settings_values_t s_saved;       // what is on flash (owned by the writer task after load)
+static bool s_saved_valid;
+
+static uint32_t blob_crc(const settings_blob_t *blob)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)blob, offsetof(settings_blob_t, crc));
+}
+
+static esp_err_t write_blob(const settings_values_t *values)
+{
+    settings_blob_t blob = {
+        .version = SETTINGS_BLOB_VERSION,
+        .len = sizeof(settings_values_t),
+        .values = *values,
+    };
+    blob.crc = blob_crc(&blob);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, SETTINGS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+// ---------------------- Legacy layout (one key per setting) ----------------------
+typedef enum { KEY_I16, KEY_U16, KEY_U8, KEY_U32 } legacy_type_t;
+
+typedef struct {
+    const char *key;
+    legacy_type_t type;
+    size_t offset;
+} legacy_key_t;
+
+#define LEGACY(key, type, field) { key, type, offsetof(settings_values_t, field) }
+
+static const legacy_key_t s_legacy_keys[] = {
+    LEGACY("angle_x",      KEY_I16, installation_angle_x),
+    LEGACY("angle_y",      KEY_I16, installation_angle_y),
+    LEGACY("angle_z",      KEY_I16, installation_angle_z),
+    LEGACY("inst_height",  KEY_U16, installation_height),
+    LEGACY("fall_sens",    KEY_U8,  fall_detection_sensitivity),
+    LEGACY("fall_dur",     KEY_U32, fall_duration),
+    LEGACY("fall_height",  KEY_U16, fall_breaking_height),
+    LEGACY("still_dist",   KEY_U16, sitting_still_distance),
+    LEGACY("move_dist",    KEY_U16, moving_distance),
+    LEGACY("still_switch", KEY_U8,  stay_still_switch),
+    LEGACY("still_dur",    KEY_U32, stay_still_duration),
+    LEGACY("fall_switch",  KEY_U8,  fall_detection_switch),
+    LEGACY("non_p_time",   KEY_U32, non_presence_time),
+    LEGACY("h_acc_t",      KEY_U32, height_accumulation_time),
+    LEGACY("live_fmt",     KEY_U8,  live_format),
+};
+
+// Read whatever old keys exist into out. Returns how many were found.
+static int load_legacy(nvs_handle_t nvs, settings_values_t *out)
+{
+    int found = 0;
+    for (size_t i = 0; i < sizeof(s_legacy_keys) / sizeof(s_legacy_keys[0]); i++) {
+        const legacy_key_t *k = &s_legacy_keys[i];
+        uint8_t *field = (uint8_t *)out + k->offset;
+        esp_err_t err;
+        switch (k->type) {
+            case KEY_I16: { int16_t v;  err = nvs_get_i16(nvs, k->key, &v); if (err == ESP_OK) memcpy(field, &v, sizeof(v)); break; }
+            case KEY_U16: { uint16_t v; err = nvs_get_u16(nvs, k->key, &v); if (err == ESP_OK) memcpy(field, &v, sizeof(v)); break; }
+            case KEY_U8:  { uint8_t v;  err = nvs_get_u8(nvs, k->key, &v);  if (err == ESP_OK) memcpy(field, &v, sizeof(v)); break; }
+            default:      { uint32_t v; err = nvs_get_u32(nvs, k->key, &v); if (err == ESP_OK) memcpy(field, &v, sizeof(v)); break; }
+        }
+        if (err == ESP_OK) {
+            found++;
+        } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+            printf("Error reading %s: %s\n", k->key, esp_err_to_name(err));
+        }
+    }
+    return found;
+}
+
+static void erase_legacy(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    for (size_t i = 0; i < sizeof(s_legacy_keys) / sizeof(s_legacy_keys[0]); i++) {
+        nvs_erase_key(nvs, s_legacy_keys[i].key);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+bool settings_store_load(settings_values_t *out)
+{
+    *out = s_defaults;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        printf("No stored settings (%s)\n", esp_err_to_name(err));
+        return false;
+    }
+
+    settings_blob_t blob;
+    size_t len = sizeof(blob);
+    err = nvs_get_blob(nvs, SETTINGS_KEY, &blob, &len);
+    if (err == ESP_OK) {
+        nvs_close(nvs);
+        if (len == sizeof(blob) && blob.version == SETTINGS_BLOB_VERSION &&
+            blob.len == sizeof(settings_values_t) && blob.crc == blob_crc(&blob)) {
+            *out = blob.values;
+            s_saved = blob.values;
+            s_saved_valid = true;
+            return true;
+        }
+        printf("Stored settings blob is invalid (version %u, %u bytes); using defaults\n",
+               (unsigned)blob.version, (unsigned)len);
+        return false;
+    }
+
+    // No blob yet: migrate the one-key-per-setting layout
+    int found = load_legacy(nvs, out);
+    nvs_close(nvs);
+    if (found == 0) {
+        return false;
+    }
+    err = write_blob(out);
+    if (err == ESP_OK) {
+        s_saved = *out;
+        s_saved_valid = true;
+        erase_legacy();
+        printf("Migrated %d settings keys to the settings blob\n", found);
+    } else {
+        printf("Error writing settings blob: %s\n", esp_err_to_name(err));
+    }
+    return true;
+}
+
+void settings_store_mark_dirty(uint32_t mask)
+{
+    __atomic_or_fetch(&s_dirty, mask, __ATOMIC_SEQ_CST);
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void settings_store_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Coalesce: wait until changes stop arriving (bounded)
+        TickType_t start = xTaskGetTickCount();
+        while (xTaskGetTickCount() - start < SAVE_MAX_DELAY && ulTaskNotifyTake(pdTRUE, SAVE_DELAY) > 0) {
+        }
+
+        uint32_t dirty = __atomic_exchange_n(&s_dirty, 0, __ATOMIC_SEQ_CST);
+        if (dirty == 0) {
+            continue;
+        }
+        settings_values_t values;
+        s_snapshot(&values);
+        if (s_saved_valid && memcmp(&values, &s_saved, sizeof(values)) == 0) {
+            continue;   // changed and changed back, or confirmed the stored value
+        }
+
+        esp_err_t err = write_blob(&values);
+        if (err == ESP_OK) {
+            s_saved = values;
+            s_saved_valid = true;
+            printf("Settings saved to NVS (changed 0x%04" PRIx32 ")\n", dirty);
+        } else {
+            // Keep the bits; the next change retries
+            __atomic_or_fetch(&s_dirty, dirty, __ATOMIC_SEQ_CST);
+            printf("Error saving settings: %s\n", esp_err_to_name(err));
+        }
+    }
+}
+
+void settings_store_init(settings_snapshot_fn_t snapshot)
+{
+    s_snapshot = snapshot;
+    xTaskCreate(settings_store_task, "settings_store", 3072, NULL, TASK_PRIO_SETTINGS_STORE, &s_task);
+}
@@ -0,0 +1,46 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Radar settings persisted in NVS as one packed blob ("settings" in the
+// "radar_config" namespace) with a version and CRC-32, written by a deferred
+// task that coalesces bursts of changes into a single write.
+typedef struct __attribute__((packed)) {
+    int16_t  installation_angle_x;
+    int16_t  installation_angle_y;
+    int16_t  installation_angle_z;
+    uint16_t installation_height;
+    uint8_t  fall_detection_sensitivity;
+    uint32_t fall_duration;
+    uint16_t fall_breaking_height;
+    uint16_t sitting_still_distance;
+    uint16_t moving_distance;
+    uint8_t  stay_still_switch;
+    uint32_t stay_still_duration;
+    uint8_t  fall_detection_switch;
+    uint32_t non_presence_time;
+    uint32_t height_accumulation_time;
+    uint8_t  live_format;
+} settings_values_t;
+
+#define SETTINGS_BLOB_VERSION 1
+
+// Fill in the values that should be on flash right now
+typedef void (*settings_snapshot_fn_t)(settings_values_t *out);
+
+// Start the writer task
+void settings_store_init(settings_snapshot_fn_t snapshot);
+
+// Read the blob. Devices that still have the old one-key-per-setting layout
+// are migrated to the blob once. Returns false if nothing was stored; out
+// then holds the defaults.
+bool settings_store_load(settings_values_t *out);
+
+// Mark settings as changed (one bit per setting, caller-defined). The blob is
+// written once no further change has arrived for CONFIG_SETTINGS_SAVE_DELAY_MS,
+// and only if its contents actually differ from what is on flash.
+void settings_store_mark_dirty(uint32_t mask);
+
+#endif // SETTINGS_STORE_H
@@ -0,0 +1,38 @@
+#ifndef TASK_PRIORITIES_H
+#define TASK_PRIORITIES_H
+
+// Priorities of every application task, highest first. Alarm-critical work
+// sits above everything else the application runs; the network stack's own
+// tasks (Wi-Fi 23, lwIP 18, esp-mqtt 5) are left at their ESP-IDF defaults.
+//
+// Alarm pipeline:
+//   uart_read_task    UART bytes -> frames -> radar state; changed live fields
+//        |            are handed on as task-notification bits stamped with the
+//        v            time the bytes were read (live_publisher_notify)
+//   live_publisher    publishes alarm/presence changes at once, coalesces the rest
+//
+// The pipeline's end-to-end latency is recorded in the live.event_us and
+// live.alarm_us histograms and can be measured under load (latency_bench.h).
+
+// Alarm pipeline
+#define TASK_PRIO_UART_READ         12
+#define TASK_PRIO_LIVE_PUBLISHER    11
+#define TASK_PRIO_RADAR_CMD         10  // radar commands; replies are matched in uart_read_task
+
+// Commands and control
+#define TASK_PRIO_MQTT_INBOX        5
+#define TASK_PRIO_SETTINGS_COMMIT   5
+#define TASK_PRIO_OTA               5
+#define TASK_PRIO_RESET_BUTTON      5
+
+// Housekeeping
+#define TASK_PRIO_LIVE_JOURNAL      4
+#define TASK_PRIO_SETTINGS_STORE    4
+#define TASK_PRIO_METRICS           3
+#define TASK_PRIO_TASK_PROFILE      3
+#define TASK_PRIO_LATENCY_BENCH     3   // the bench itself; its load task runs at the requested priority
+#define TASK_PRIO_DIAG_PRINT        2
+#define TASK_PRIO_RADAR_LOG         1
+#define TASK_PRIO_KEY_READ          1
+
+#endif // TASK_PRIORITIES_H
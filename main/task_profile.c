@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "task_profile.h"
+#include "json_writer.h"
+#include "task_priorities.h"
+
+#ifndef CONFIG_TASK_PROFILE_INTERVAL_S
+#define CONFIG_TASK_PROFILE_INTERVAL_S 300
+#endif
+
+#define MAX_TASKS   32
+
+static const char *TAG = "task_profile";
+
+typedef struct {
+    char name[16];
+    uint8_t priority;
+    uint32_t stack_free;
+    int16_t cpu_permille;       // -1: run-time stats disabled
+} task_entry_t;
+
+typedef struct {
+    uint32_t interval_ms;
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t heap_largest;
+    uint8_t heap_frag_pct;      // 100 - largest block / free
+    uint8_t count;
+    task_entry_t tasks[MAX_TASKS];
+} sample_t;
+
+// Run-time counters from the previous sample, to turn totals into a share
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t runtime;
+} prev_runtime_t;
+
+static prev_runtime_t s_prev[MAX_TASKS];
+static uint8_t s_prev_count;
+static uint32_t s_prev_total;
+static int64_t s_prev_us;
+static sample_t s_sample;
+static SemaphoreHandle_t s_lock;    // console, MQTT request and the periodic task can all sample
+
+static uint32_t prev_runtime(TaskHandle_t handle)
+{
+    for (uint8_t i = 0; i < s_prev_count; i++) {
+        if (s_prev[i].handle == handle) {
+            return s_prev[i].runtime;
+        }
+    }
+    return 0;   // started after the previous sample
+}
+
+static void sample_tasks(sample_t *s)
+{
+    s->count = 0;
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    UBaseType_t n = uxTaskGetNumberOfTasks() + 2;
+    TaskStatus_t *status = malloc(n * sizeof(TaskStatus_t));
+    if (status == NULL) {
+        ESP_LOGW(TAG, "No memory for %u task entries", (unsigned)n);
+        return;
+    }
+    uint32_t total = 0;
+    n = uxTaskGetSystemState(status, n, &total);
+
+    // Every core accumulates run time, so one interval counts portNUM_PROCESSORS times
+    uint32_t elapsed = (total - s_prev_total) * portNUM_PROCESSORS;
+    for (UBaseType_t i = 0; i < n && s->count < MAX_TASKS; i++) {
+        task_entry_t *t = &s->tasks[s->count++];
+        strncpy(t->name, status[i].pcTaskName, sizeof(t->name) - 1);
+        t->name[sizeof(t->name) - 1] = '\0';
+        t->priority = (uint8_t)status[i].uxCurrentPriority;
+        t->stack_free = status[i].usStackHighWaterMark;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        uint32_t used = status[i].ulRunTimeCounter - prev_runtime(status[i].xHandle);
+        t->cpu_permille = elapsed ? (int16_t)((uint64_t)used * 1000 / elapsed) : 0;
+#else
+        t->cpu_permille = -1;
+#endif
+    }
+
+    s_prev_count = 0;
+    for (UBaseType_t i = 0; i < n && i < MAX_TASKS; i++) {
+        s_prev[s_prev_count].handle = status[i].xHandle;
+        s_prev[s_prev_count].runtime = status[i].ulRunTimeCounter;
+        s_prev_count++;
+    }
+    s_prev_total = total;
+    free(status);
+#endif
+
+    // Busiest first (insertion sort; a few dozen entries at most)
+    for (uint8_t i = 1; i < s->count; i++) {
+        task_entry_t t = s->tasks[i];
+        uint8_t j = i;
+        while (j > 0 && s->tasks[j - 1].cpu_permille < t.cpu_permille) {
+            s->tasks[j] = s->tasks[j - 1];
+            j--;
+        }
+        s->tasks[j] = t;
+    }
+}
+
+static void sample(sample_t *s)
+{
+    int64_t now = esp_timer_get_time();
+    s->interval_ms = (uint32_t)((now - s_prev_us) / 1000);
+    s_prev_us = now;
+
+    s->heap_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    s->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    s->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    s->heap_frag_pct = s->heap_free ? (uint8_t)(100 - (uint64_t)s->heap_largest * 100 / s->heap_free) : 0;
+
+    sample_tasks(s);
+}
+
+size_t task_profile_to_json(char *buf, size_t len)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, len);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sample(&s_sample);
+    const sample_t *s = &s_sample;
+
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "up", (uint32_t)(esp_timer_get_time() / 1000000));
+    json_writer_uint(&w, "interval_ms", s->interval_ms);
+    json_writer_begin_array(&w, "heap");
+    json_writer_uint(&w, NULL, s->heap_free);
+    json_writer_uint(&w, NULL, s->heap_min_free);
+    json_writer_uint(&w, NULL, s->heap_largest);
+    json_writer_uint(&w, NULL, s->heap_frag_pct);
+    json_writer_end_array(&w);
+    json_writer_begin_array(&w, "tasks");
+    for (uint8_t i = 0; i < s->count; i++) {
+        const task_entry_t *t = &s->tasks[i];
+        json_writer_begin_array(&w, NULL);
+        json_writer_string(&w, NULL, t->name);
+        json_writer_uint(&w, NULL, t->priority);
+        json_writer_uint(&w, NULL, t->stack_free);
+        json_writer_int(&w, NULL, t->cpu_permille);
+        json_writer_end_array(&w);
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    xSemaphoreGive(s_lock);
+
+    size_t n = json_writer_finish(&w);
+    if (n == 0) {
+        ESP_LOGW(TAG, "Task report does not fit in %u bytes", (unsigned)len);
+    }
+    return n;
+}
+
+void task_profile_print(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sample(&s_sample);
+    const sample_t *s = &s_sample;
+
+    printf("Tasks over the last %" PRIu32 " ms:\n", s->interval_ms);
+    printf("  %-16s %4s %10s %6s\n", "name", "prio", "stack free", "cpu");
+    for (uint8_t i = 0; i < s->count; i++) {
+        const task_entry_t *t = &s->tasks[i];
+        if (t->cpu_permille < 0) {
+            printf("  %-16s %4u %10" PRIu32 " %6s\n", t->name, t->priority, t->stack_free, "-");
+        } else {
+            printf("  %-16s %4u %10" PRIu32 " %3d.%d%%\n", t->name, t->priority, t->stack_free,
+                   t->cpu_permille / 10, t->cpu_permille % 10);
+        }
+    }
+    printf("Heap: free %" PRIu32 ", min free %" PRIu32 ", largest block %" PRIu32 " (%u%% fragmented)\n",
+           s->heap_free, s->heap_min_free, s->heap_largest, s->heap_frag_pct);
+    xSemaphoreGive(s_lock);
+}
+
+static void task_profile_task(void *arg)
+{
+    task_profile_publish_fn_t publish = (task_profile_publish_fn_t)arg;
+    static char json[CONFIG_TASK_PROFILE_JSON_MAX];
+
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_TASK_PROFILE_INTERVAL_S * 1000));
+        size_t len = task_profile_to_json(json, sizeof(json));
+        if (len > 0) {
+            publish(json, len);
+        }
+    }
+}
+
+void task_profile_start(task_profile_publish_fn_t publish)
+{
+    s_lock = xSemaphoreCreateMutex();
+    if (CONFIG_TASK_PROFILE_INTERVAL_S > 0) {
+        xTaskCreate(task_profile_task, "task_profile", 3072, (void *)publish, TASK_PRIO_TASK_PROFILE, NULL);
+    }
+}
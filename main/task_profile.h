@@ -0,0 +1,39 @@
+#ifndef TASK_PROFILE_H
+#define TASK_PROFILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+// Per-task stack headroom and CPU share, plus heap fragmentation, sampled
+// with uxTaskGetSystemState(). CPU share is measured between two samples
+// (the first one covers the time since boot) and needs
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS; the task list needs
+// CONFIG_FREERTOS_USE_TRACE_FACILITY (both set in sdkconfig.defaults).
+//
+// Report (task_profile_to_json), published on <device_id>/tasks:
+//   {"up":s,"interval_ms":n,
+//    "heap":[free,min_free,largest_block,fragmentation_pct],
+//    "tasks":[["name",priority,stack_free_bytes,cpu_permille],...]}
+// Tasks are sorted by CPU share, busiest first; cpu_permille is -1 when
+// run-time stats are disabled. stack_free_bytes is the high-water mark: the
+// least free stack the task has had since it started.
+
+#ifndef CONFIG_TASK_PROFILE_JSON_MAX
+#define CONFIG_TASK_PROFILE_JSON_MAX 1536
+#endif
+
+// Publish a report every CONFIG_TASK_PROFILE_INTERVAL_S seconds (0: only on
+// request); publish returns false when it could not be sent. Call before the
+// other functions here, i.e. before MQTT and the console can ask for a report.
+typedef bool (*task_profile_publish_fn_t)(const char *json, size_t len);
+void task_profile_start(task_profile_publish_fn_t publish);
+
+// Take a sample and render it. Returns the length written (excluding the
+// NUL), or 0 if buf is too small.
+size_t task_profile_to_json(char *buf, size_t len);
+
+// Take a sample and print it as a table on the console
+void task_profile_print(void);
+
+#endif // TASK_PROFILE_H
@@ -0,0 +1,385 @@
+// Host test for the delta patch decoder: a patch built here the way
+// ota_delta.py builds one (moved, edited and inserted blocks) must rebuild
+// the target exactly, fed in one piece, byte by byte and in random chunks.
+// Every truncated prefix must leave the patch unfinished, and corrupt headers,
+// operations and failing callbacks must be refused with an error.
+//
+//   ctest --test-dir build/main_test --output-on-failure
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "delta_patch.h"
+
+static int s_failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+#define SOURCE_LEN  20000
+#define TARGET_MAX  24000
+#define PATCH_MAX   32768
+
+// ---------------------------------------------------------------- patch builder
+
+typedef struct {
+    uint8_t data[PATCH_MAX];
+    size_t len;
+    uint32_t src_pos;   // source position after the last ADD, as the decoder tracks it
+} patch_t;
+
+static void put_byte(patch_t *p, uint8_t b)
+{
+    if (p->len < PATCH_MAX) {
+        p->data[p->len++] = b;
+    }
+}
+
+static void put_varint(patch_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        put_byte(p, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(p, (uint8_t)v);
+}
+
+static void put_u32(patch_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        put_byte(p, (uint8_t)(v >> (8 * i)));
+    }
+}
+
+static void put_header(patch_t *p, uint32_t source_size, uint32_t target_size)
+{
+    memset(p, 0, sizeof(*p));
+    memcpy(p->data, "R6DP", 4);
+    p->data[4] = DELTA_PATCH_VERSION;
+    p->len = 8;
+    put_u32(p, source_size);
+    put_u32(p, target_size);
+    for (int i = 0; i < 64; i++) {
+        put_byte(p, (uint8_t)(0xA0 + i));  // the decoder only passes the hashes on
+    }
+}
+
+// target[0..len) from source[s..s+len): zero runs and (count, diff bytes) groups
+static void put_add(patch_t *p, const uint8_t *source, uint32_t s, const uint8_t *target, uint32_t len)
+{
+    int32_t seek = (int32_t)(s - p->src_pos);
+    put_byte(p, DELTA_OP_ADD);
+    put_varint(p, seek < 0 ? ((uint32_t)(-(seek + 1)) << 1) | 1 : (uint32_t)seek << 1);
+    put_varint(p, len);
+
+    uint32_t i = 0;
+    while (i < len) {
+        uint32_t run = 0;
+        while (i + run < len && target[i + run] == source[s + i + run]) {
+            run++;
+        }
+        put_varint(p, run);
+        i += run;
+        if (i == len) {
+            break;
+        }
+        uint32_t count = 0;
+        while (i + count < len && target[i + count] != source[s + i + count]) {
+            count++;
+        }
+        put_varint(p, count);
+        for (uint32_t k = 0; k < count; k++) {
+            put_byte(p, (uint8_t)(target[i + k] - source[s + i + k]));
+        }
+        i += count;
+    }
+    p->src_pos = s + len;
+}
+
+static void put_insert(patch_t *p, const uint8_t *bytes, uint32_t len)
+{
+    put_byte(p, DELTA_OP_INSERT);
+    put_varint(p, len);
+    for (uint32_t i = 0; i < len; i++) {
+        put_byte(p, bytes[i]);
+    }
+}
+
+// ---------------------------------------------------------------- harness
+
+typedef struct {
+    const uint8_t *source;
+    uint32_t source_len;
+    uint8_t target[TARGET_MAX];
+    uint32_t target_len;
+    bool fail_read;
+    bool fail_write;
+    bool refuse;
+    int headers;
+} sink_t;
+
+static int read_source(uint32_t offset, uint8_t *buf, size_t len, void *ctx)
+{
+    sink_t *k = ctx;
+    if (k->fail_read || offset + len > k->source_len) {
+        return -1;
+    }
+    memcpy(buf, k->source + offset, len);
+    return 0;
+}
+
+static int write_target(const uint8_t *buf, size_t len, void *ctx)
+{
+    sink_t *k = ctx;
+    if (k->fail_write || k->target_len + len > TARGET_MAX) {
+        return -1;
+    }
+    memcpy(k->target + k->target_len, buf, len);
+    k->target_len += len;
+    return 0;
+}
+
+static int on_header(const delta_patch_t *patch, void *ctx)
+{
+    sink_t *k = ctx;
+    k->headers++;
+    return k->refuse ? -1 : 0;
+}
+
+// Feed data in chunks of 1..max_chunk bytes (0: all at once). Returns the
+// first non-zero feed result.
+static int apply(delta_patch_t *dp, sink_t *k, const uint8_t *source, const uint8_t *data, size_t len,
+                 size_t max_chunk)
+{
+    k->source = source;
+    k->source_len = SOURCE_LEN;
+    k->target_len = 0;
+    k->headers = 0;
+    delta_patch_init(dp, read_source, write_target, on_header, k);
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = max_chunk ? 1 + (size_t)rand() % max_chunk : len;
+        if (n > len - pos) {
+            n = len - pos;
+        }
+        if (delta_patch_feed(dp, data + pos, n) != 0) {
+            return -1;
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+static uint8_t s_source[SOURCE_LEN];
+static uint8_t s_target[TARGET_MAX];
+static uint32_t s_target_len;
+static patch_t s_patch;
+static delta_patch_t s_dp;
+static sink_t s_sink;
+
+// A new "image": a moved block with scattered byte edits, inserted code, a
+// stretch from earlier in the source (negative seek) and a tail that ends in
+// a changed run
+static void build_round_trip_patch(void)
+{
+    srand(1);
+    for (size_t i = 0; i < SOURCE_LEN; i++) {
+        s_source[i] = (uint8_t)rand();
+    }
+
+    patch_t *p = &s_patch;
+    put_header(p, SOURCE_LEN, 0);
+    s_target_len = 0;
+
+    // 1. source[4000..9000) with every 97th byte changed
+    memcpy(s_target, s_source + 4000, 5000);
+    for (uint32_t i = 0; i < 5000; i += 97) {
+        s_target[i] ^= 0x5A;
+    }
+    put_add(p, s_source, 4000, s_target, 5000);
+    s_target_len = 5000;
+
+    // 2. 700 literal bytes
+    uint8_t *lit = s_target + s_target_len;
+    for (uint32_t i = 0; i < 700; i++) {
+        lit[i] = (uint8_t)(i * 7);
+    }
+    put_insert(p, lit, 700);
+    s_target_len += 700;
+
+    // 3. source[0..3000) unchanged: a negative seek
+    memcpy(s_target + s_target_len, s_source, 3000);
+    put_add(p, s_source, 0, s_target + s_target_len, 3000);
+    s_target_len += 3000;
+
+    // 4. source[12000..20000) ending in a changed run
+    memcpy(s_target + s_target_len, s_source + 12000, 8000);
+    for (uint32_t i = 7990; i < 8000; i++) {
+        s_target[s_target_len + i] += 1;
+    }
+    put_add(p, s_source, 12000, s_target + s_target_len, 8000);
+    s_target_len += 8000;
+
+    put_byte(p, DELTA_OP_END);
+    for (int i = 0; i < 4; i++) {
+        p->data[12 + i] = (uint8_t)(s_target_len >> (8 * i));
+    }
+}
+
+static void test_round_trip(void)
+{
+    static const size_t chunks[] = { 0, 1, 7, 64, 1500 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        int r = apply(&s_dp, &s_sink, s_source, s_patch.data, s_patch.len, chunks[c]);
+        CHECK(r == 0, "chunks of %zu: feed failed: %s", chunks[c], s_dp.error ? s_dp.error : "?");
+        CHECK(delta_patch_done(&s_dp), "chunks of %zu: not done", chunks[c]);
+        CHECK(s_dp.written == s_target_len && s_sink.target_len == s_target_len,
+              "chunks of %zu: wrote %u, expected %u", chunks[c], (unsigned)s_sink.target_len,
+              (unsigned)s_target_len);
+        CHECK(memcmp(s_sink.target, s_target, s_target_len) == 0, "chunks of %zu: target differs", chunks[c]);
+        CHECK(s_sink.headers == 1, "chunks of %zu: on_header ran %d times", chunks[c], s_sink.headers);
+        CHECK(s_dp.source_size == SOURCE_LEN && s_dp.target_size == s_target_len &&
+              s_dp.source_sha256[0] == 0xA0 && s_dp.target_sha256[31] == 0xDF,
+              "chunks of %zu: header fields", chunks[c]);
+    }
+    printf("Round trip: %u-byte target from a %zu-byte patch\n", (unsigned)s_target_len, s_patch.len);
+}
+
+// A download cut short anywhere must not look like a finished patch
+static void test_truncated(void)
+{
+    for (size_t len = 0; len < s_patch.len; len++) {
+        int r = apply(&s_dp, &s_sink, s_source, s_patch.data, len, 0);
+        CHECK(r == 0, "prefix of %zu bytes: feed failed: %s", len, s_dp.error ? s_dp.error : "?");
+        CHECK(!delta_patch_done(&s_dp), "prefix of %zu bytes reported done", len);
+        if (s_failures > 10) {
+            return;
+        }
+    }
+}
+
+// Feed a copy of the round-trip patch with one byte replaced (or appended)
+// and expect this error
+static void expect_error(const char *name, size_t offset, int value, const char *error)
+{
+    static uint8_t data[PATCH_MAX + 1];
+    memcpy(data, s_patch.data, s_patch.len);
+    size_t len = s_patch.len;
+    if (offset == len) {
+        len++;
+    }
+    data[offset] = (uint8_t)value;
+
+    int r = apply(&s_dp, &s_sink, s_source, data, len, 13);
+    CHECK(r == -1, "%s: accepted", name);
+    CHECK(s_dp.error != NULL && strcmp(s_dp.error, error) == 0, "%s: error \"%s\", expected \"%s\"",
+          name, s_dp.error ? s_dp.error : "(none)", error);
+    CHECK(!delta_patch_done(&s_dp), "%s: reported done", name);
+    CHECK(delta_patch_feed(&s_dp, data, 1) == -1, "%s: feed after an error succeeded", name);
+}
+
+// A minimal patch: header, then the given operation bytes
+static size_t small_patch(uint8_t *out, uint32_t target_size, const uint8_t *ops, size_t ops_len)
+{
+    patch_t p;
+    put_header(&p, SOURCE_LEN, target_size);
+    for (size_t i = 0; i < ops_len; i++) {
+        put_byte(&p, ops[i]);
+    }
+    memcpy(out, p.data, p.len);
+    return p.len;
+}
+
+static void expect_small_error(const char *name, uint32_t target_size, const uint8_t *ops, size_t ops_len,
+                               const char *error)
+{
+    static uint8_t data[PATCH_MAX];
+    size_t len = small_patch(data, target_size, ops, ops_len);
+    int r = apply(&s_dp, &s_sink, s_source, data, len, 0);
+    CHECK(r == -1, "%s: accepted", name);
+    CHECK(s_dp.error != NULL && strcmp(s_dp.error, error) == 0, "%s: error \"%s\", expected \"%s\"",
+          name, s_dp.error ? s_dp.error : "(none)", error);
+}
+
+static void test_corrupt(void)
+{
+    size_t first_op = DELTA_PATCH_HDR_LEN;
+
+    expect_error("bad magic", 0, 'X', "not a delta patch");
+    expect_error("bad version", 4, DELTA_PATCH_VERSION + 1, "unsupported patch version");
+    expect_error("unknown operation", first_op, 0x7F, "unknown operation");
+    expect_error("early end", first_op, DELTA_OP_END, "target size mismatch");
+    expect_error("trailing data", s_patch.len, 0x00, "data after end of patch");
+    // Target size one byte short: the last ADD runs past it
+    expect_error("target overrun", 12, (uint8_t)(s_target_len - 1), "target overrun");
+
+    static const uint8_t seek_before[] = { DELTA_OP_ADD, 0x01, 0x01, 0x01, DELTA_OP_END };   // seek -1
+    expect_small_error("seek before source", 1, seek_before, sizeof(seek_before), "seek outside source");
+
+    patch_t far;
+    put_header(&far, SOURCE_LEN, 0);
+    put_byte(&far, DELTA_OP_ADD);
+    put_varint(&far, (SOURCE_LEN + 1) << 1);
+    expect_small_error("seek after source", 0, far.data + DELTA_PATCH_HDR_LEN, far.len - DELTA_PATCH_HDR_LEN,
+                       "seek outside source");
+
+    static const uint8_t source_overrun[] = { DELTA_OP_ADD, 0x00, 0xA1, 0x9C, 0x01 };   // len 20001
+    expect_small_error("source overrun", SOURCE_LEN + 1, source_overrun, sizeof(source_overrun),
+                       "source overrun");
+
+    static const uint8_t zero_count[] = { DELTA_OP_ADD, 0x00, 0x04, 0x01, 0x00 };
+    expect_small_error("zero diff count", 4, zero_count, sizeof(zero_count), "bad diff count");
+
+    static const uint8_t long_count[] = { DELTA_OP_ADD, 0x00, 0x04, 0x00, 0x05 };
+    expect_small_error("diff count past operation", 4, long_count, sizeof(long_count), "bad diff count");
+
+    static const uint8_t long_run[] = { DELTA_OP_ADD, 0x00, 0x04, 0x05 };
+    expect_small_error("run past operation", 4, long_run, sizeof(long_run), "run past end of operation");
+
+    static const uint8_t insert_overrun[] = { DELTA_OP_INSERT, 0x05, 1, 2, 3, 4, 5 };
+    expect_small_error("insert overrun", 4, insert_overrun, sizeof(insert_overrun), "target overrun");
+
+    static const uint8_t overflow[] = { DELTA_OP_INSERT, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F };
+    expect_small_error("varint overflow", 4, overflow, sizeof(overflow), "varint overflow");
+}
+
+static void test_callbacks(void)
+{
+    s_sink.refuse = true;
+    int r = apply(&s_dp, &s_sink, s_source, s_patch.data, s_patch.len, 0);
+    CHECK(r == -1 && s_dp.error && strcmp(s_dp.error, "patch refused") == 0, "refused header accepted");
+    CHECK(s_sink.target_len == 0, "refused patch wrote %u bytes", (unsigned)s_sink.target_len);
+    s_sink.refuse = false;
+
+    s_sink.fail_read = true;
+    r = apply(&s_dp, &s_sink, s_source, s_patch.data, s_patch.len, 0);
+    CHECK(r == -1 && s_dp.error && strcmp(s_dp.error, "source read failed") == 0, "source read failure ignored");
+    s_sink.fail_read = false;
+
+    s_sink.fail_write = true;
+    r = apply(&s_dp, &s_sink, s_source, s_patch.data, s_patch.len, 0);
+    CHECK(r == -1 && s_dp.error && strcmp(s_dp.error, "target write failed") == 0, "target write failure ignored");
+    s_sink.fail_write = false;
+}
+
+int main(void)
+{
+    build_round_trip_patch();
+    test_round_trip();
+    test_truncated();
+    test_corrupt();
+    test_callbacks();
+
+    if (s_failures > 0) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("All delta patch checks passed\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+// Host test for the MQTT JSON payload sizes: every payload built at its worst
+// case (device ID and product strings at 31 characters of '"', each escaped
+// to two bytes, every number at its widest) must fit its *_JSON_MAX buffer,
+// and one byte less than needed must give 0, never a truncated payload.
+//
+//   ctest --test-dir build/main_test --output-on-failure
+
+#include <stdio.h>
+#include <string.h>
+#include "payload_json.h"
+#include "live_binary.h"
+
+static int s_failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static char s_device_id[32];
+static radar_state_t s_worst;       // widest value in every field
+static radar_state_t s_other;       // differs from s_worst in every setting
+
+static void fill_quotes(char *s, size_t size)
+{
+    memset(s, '"', size - 1);
+    s[size - 1] = '\0';
+}
+
+static void build_worst_state(void)
+{
+    fill_quotes(s_device_id, sizeof(s_device_id));
+
+    radar_state_t *st = &s_worst;
+    memset(st, 0, sizeof(*st));
+    // Booleans false ("false" is the longer literal)
+    st->movement_state = UINT8_MAX;
+    st->body_movement_param = UINT8_MAX;
+    st->heartbeat = UINT8_MAX;
+    st->traj_x = INT16_MIN;
+    st->traj_y = INT16_MIN;
+    st->total_height_count = UINT16_MAX;
+    st->height_prop_0_0_5 = UINT8_MAX;
+    st->height_prop_0_5_1 = UINT8_MAX;
+    st->height_prop_1_1_5 = UINT8_MAX;
+    st->height_prop_1_5_2 = UINT8_MAX;
+    st->non_presence_time = UINT32_MAX;
+
+    st->working_status = UINT8_MAX;
+    st->scenario = UINT8_MAX;
+    st->installation_angle_x = INT16_MIN;
+    st->installation_angle_y = INT16_MIN;
+    st->installation_angle_z = INT16_MIN;
+    st->installation_height = UINT16_MAX;
+    st->fall_detection_sensitivity = UINT8_MAX;
+    st->fall_duration = UINT32_MAX;
+    st->fall_breaking_height = UINT16_MAX;
+    st->sitting_still_distance = UINT16_MAX;
+    st->moving_distance = UINT16_MAX;
+    st->stay_still_duration = UINT32_MAX;
+    st->height_accumulation_time = UINT32_MAX;
+
+    st->operating_time = UINT32_MAX;
+    fill_quotes(st->product_model, sizeof(st->product_model));
+    fill_quotes(st->product_id, sizeof(st->product_id));
+    fill_quotes(st->hardware_model, sizeof(st->hardware_model));
+    fill_quotes(st->firmware_version, sizeof(st->firmware_version));
+
+    s_other = s_worst;
+    s_other.working_status = 0;
+    s_other.scenario = 0;
+    s_other.installation_angle_x = 0;
+    s_other.installation_angle_y = 0;
+    s_other.installation_angle_z = 0;
+    s_other.installation_height = 0;
+    s_other.fall_detection_sensitivity = 0;
+    s_other.fall_duration = 0;
+    s_other.fall_breaking_height = 0;
+    s_other.sitting_still_distance = 0;
+    s_other.moving_distance = 0;
+    s_other.stay_still_switch = true;
+    s_other.stay_still_duration = 0;
+    s_other.height_accumulation_time = 0;
+    s_other.fall_detection_switch = true;
+    s_other.non_presence_time = 0;
+}
+
+// Longest live_format name
+static uint8_t widest_live_format(void)
+{
+    static const uint8_t formats[] = { LIVE_FORMAT_JSON, LIVE_FORMAT_BINARY, LIVE_FORMAT_BOTH };
+    uint8_t widest = formats[0];
+    for (size_t i = 1; i < sizeof(formats); i++) {
+        if (strlen(live_format_to_str(formats[i])) > strlen(live_format_to_str(widest))) {
+            widest = formats[i];
+        }
+    }
+    return widest;
+}
+
+typedef size_t (*build_fn_t)(char *buf, size_t len);
+
+// Build into a buffer of max bytes, then into one exactly one byte too small
+static void check_fits(const char *name, build_fn_t build, size_t max)
+{
+    static char buf[4096];
+    size_t len = build(buf, max);
+    CHECK(len > 0, "%s: does not fit in %zu bytes", name, max);
+    if (len == 0) {
+        return;
+    }
+    CHECK(strlen(buf) == len, "%s: length %zu but %zu characters", name, len, strlen(buf));
+    CHECK(buf[0] == '{' && buf[len - 1] == '}', "%s: not an object: %s", name, buf);
+    printf("%-24s %3zu bytes including the NUL (buffer %zu)\n", name, len + 1, max);
+
+    CHECK(build(buf, len) == 0, "%s: fits in %zu bytes, one too few for the NUL", name, len);
+    CHECK(buf[0] == '\0', "%s: partial payload left in a short buffer", name);
+}
+
+static size_t build_live(char *buf, size_t len)
+{
+    return payload_live_json(buf, len, s_device_id, &s_worst);
+}
+
+static size_t build_settings_snapshot(char *buf, size_t len)
+{
+    return payload_settings_json(buf, len, s_device_id, UINT32_MAX, UINT32_MAX, &s_worst,
+                                 widest_live_format(), NULL);
+}
+
+// A delta carries every field a snapshot does, plus "delta" and "base"
+static size_t build_settings_delta(char *buf, size_t len)
+{
+    payload_settings_base_t base = { UINT32_MAX, &s_other, 0 };
+    return payload_settings_json(buf, len, s_device_id, UINT32_MAX, UINT32_MAX, &s_worst,
+                                 widest_live_format(), &base);
+}
+
+static size_t build_product_info(char *buf, size_t len)
+{
+    payload_wifi_t wifi = {
+        .boot_ms = UINT32_MAX,
+        .connect_ms = UINT32_MAX,
+        .reconnects = UINT16_MAX,
+        .fallbacks = UINT16_MAX,
+    };
+    return payload_product_info_json(buf, len, s_device_id, &s_worst, &wifi);
+}
+
+static size_t build_product_info_short(char *buf, size_t len)
+{
+    return payload_product_info_json(buf, len, s_device_id, &s_worst, NULL);
+}
+
+static size_t build_usage(char *buf, size_t len)
+{
+    return payload_usage_json(buf, len, s_device_id, &s_worst);
+}
+
+// The delta case above only holds if every setting really differs
+static void test_delta_has_every_field(void)
+{
+    char snapshot[SETTINGS_JSON_MAX];
+    char delta[SETTINGS_JSON_MAX];
+    build_settings_snapshot(snapshot, sizeof(snapshot));
+    build_settings_delta(delta, sizeof(delta));
+    CHECK(payload_settings_differ(&s_worst, &s_other), "states do not differ");
+
+    // Every key of the snapshot after "version" must appear in the delta
+    const char *p = strstr(snapshot, "\"version\"");
+    int keys = 0;
+    while (p != NULL && (p = strstr(p + 1, ",\"")) != NULL) {
+        char key[40];
+        const char *end = strchr(p + 2, '"');
+        size_t n = (size_t)(end - p) + 1;
+        if (end == NULL || n >= sizeof(key)) {
+            break;
+        }
+        memcpy(key, p, n);
+        key[n] = '\0';
+        CHECK(strstr(delta, key) != NULL, "delta lacks %s", key + 1);
+        keys++;
+    }
+    CHECK(keys == 17, "snapshot has %d settings, expected 17", keys);
+
+    payload_settings_base_t same = { 1, &s_worst, widest_live_format() };
+    char empty[SETTINGS_JSON_MAX];
+    size_t len = payload_settings_json(empty, sizeof(empty), "id", 1, 1, &s_worst, widest_live_format(), &same);
+    CHECK(len > 0 && strcmp(empty, "{\"device_id\":\"id\",\"device_type\":\"" DEVICE_TYPE
+                            "\",\"boot\":1,\"version\":1,\"delta\":true,\"base\":1}") == 0,
+          "unchanged delta: %s", empty);
+}
+
+int main(void)
+{
+    build_worst_state();
+
+    check_fits("live", build_live, LIVE_JSON_MAX);
+    check_fits("settings (snapshot)", build_settings_snapshot, SETTINGS_JSON_MAX);
+    check_fits("settings (delta)", build_settings_delta, SETTINGS_JSON_MAX);
+    check_fits("product info", build_product_info, PRODUCT_INFO_JSON_MAX);
+    check_fits("product info (console)", build_product_info_short, PRODUCT_INFO_JSON_MAX);
+    check_fits("usage", build_usage, USAGE_JSON_MAX);
+    test_delta_has_every_field();
+
+    if (s_failures > 0) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("All payload size checks passed\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include "topic_router.h"
+
+#define FNV_OFFSET  2166136261u
+#define FNV_PRIME   16777619u
+
+typedef struct {
+    char pattern[TOPIC_ROUTER_PATTERN_MAX];
+    uint16_t len;
+    uint32_t hash;
+    bool wildcard;
+    topic_handler_t handler;
+    void *ctx;
+    uint32_t hits;
+} topic_route_t;
+
+static topic_route_t s_routes[TOPIC_ROUTER_MAX_ROUTES];
+static size_t s_count;
+static uint32_t s_unmatched;
+
+// Hash a NUL-terminated string and report its length in the same pass
+static uint32_t topic_hash(const char *s, size_t *len)
+{
+    uint32_t h = FNV_OFFSET;
+    const char *p = s;
+    while (*p) {
+        h = (h ^ (uint8_t)*p++) * FNV_PRIME;
+    }
+    *len = (size_t)(p - s);
+    return h;
+}
+
+// '+' and '#' must fill a whole level, and '#' must be the last one
+static bool pattern_valid(const char *p)
+{
+    for (const char *c = p; *c; c++) {
+        if (*c != '+' && *c != '#') {
+            continue;
+        }
+        bool starts = (c == p) || (c[-1] == '/');
+        bool ends = (c[1] == '\0') || (c[1] == '/' && *c == '+');
+        if (!starts || !ends) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MQTT wildcard match, level by level
+static bool pattern_match(const char *p, const char *t)
+{
+    for (;;) {
+        if (*p == '#') {
+            return true;
+        }
+        if (*p == '+') {
+            while (*t && *t != '/') {
+                t++;
+            }
+            p++;
+        } else {
+            while (*p && *p != '/' && *p == *t) {
+                p++;
+                t++;
+            }
+            if ((*p && *p != '/') || (*t && *t != '/')) {
+                return false;
+            }
+        }
+        // Both at a separator or at the end
+        if (*p == '\0' || *t == '\0') {
+            // "a/#" also matches "a"
+            return *p == *t || (*t == '\0' && p[0] == '/' && p[1] == '#');
+        }
+        p++;
+        t++;
+    }
+}
+
+esp_err_t topic_router_add(const char *pattern, topic_handler_t handler, void *ctx)
+{
+    size_t len = strlen(pattern);
+    if (len == 0 || len >= TOPIC_ROUTER_PATTERN_MAX || handler == NULL || !pattern_valid(pattern)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_count == TOPIC_ROUTER_MAX_ROUTES) {
+        printf("Topic router full, %s not registered\n", pattern);
+        return ESP_ERR_NO_MEM;
+    }
+    topic_route_t *r = &s_routes[s_count];
+    memcpy(r->pattern, pattern, len + 1);
+    r->hash = topic_hash(r->pattern, &len);
+    r->len = (uint16_t)len;
+    r->wildcard = strpbrk(pattern, "+#") != NULL;
+    r->handler = handler;
+    r->ctx = ctx;
+    r->hits = 0;
+    s_count++;
+    return ESP_OK;
+}
+
+bool topic_router_dispatch(const char *topic, const char *data, size_t len)
+{
+    size_t topic_len;
+    uint32_t hash = topic_hash(topic, &topic_len);
+
+    for (size_t i = 0; i < s_count; i++) {
+        topic_route_t *r = &s_routes[i];
+        if (!r->wildcard && r->hash == hash && r->len == topic_len &&
+            memcmp(r->pattern, topic, topic_len) == 0) {
+            r->hits++;
+            r->handler(topic, data, len, r->ctx);
+            return true;
+        }
+    }
+    for (size_t i = 0; i < s_count; i++) {
+        topic_route_t *r = &s_routes[i];
+        if (r->wildcard && pattern_match(r->pattern, topic)) {
+            r->hits++;
+            r->handler(topic, data, len, r->ctx);
+            return true;
+        }
+    }
+
+    s_unmatched++;
+    printf("No route for topic %s\n", topic);
+    return false;
+}
+
+size_t topic_router_get_routes(topic_route_info_t *out, size_t max)
+{
+    for (size_t i = 0; i < s_count && i < max; i++) {
+        out[i].pattern = s_routes[i].pattern;
+        out[i].hits = s_routes[i].hits;
+    }
+    return s_count;
+}
+
+uint32_t topic_router_unmatched(void)
+{
+    return s_unmatched;
+}
@@ -0,0 +1,40 @@
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Dispatch table for inbound MQTT messages. Exact topics are matched by a
+// precomputed FNV-1a hash and length (the incoming topic is hashed once per
+// message); patterns containing MQTT wildcards ('+' one level, '#' the rest)
+// are tried in registration order when no exact route matches.
+//
+// Routes are registered at start-up, before messages arrive; dispatch runs
+// on a single task (the MQTT inbox worker).
+
+#define TOPIC_ROUTER_MAX_ROUTES     16
+#define TOPIC_ROUTER_PATTERN_MAX    64
+
+typedef void (*topic_handler_t)(const char *topic, const char *data, size_t len, void *ctx);
+
+typedef struct {
+    const char *pattern;
+    uint32_t hits;
+} topic_route_info_t;
+
+// Register a handler; the pattern is copied. Fails with ESP_ERR_NO_MEM when
+// the table is full and ESP_ERR_INVALID_ARG for a malformed pattern.
+esp_err_t topic_router_add(const char *pattern, topic_handler_t handler, void *ctx);
+
+// Run the handler for topic. Returns false (and counts it) when nothing matches.
+bool topic_router_dispatch(const char *topic, const char *data, size_t len);
+
+// Copy up to max routes (pattern and hit count); returns the number of routes.
+// Also how the MQTT client learns what to subscribe to.
+size_t topic_router_get_routes(topic_route_info_t *out, size_t max);
+
+uint32_t topic_router_unmatched(void);
+
+#endif // TOPIC_ROUTER_H
@@ -0,0 +1,191 @@
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "track_buffer.h"
+
+#define TRACK_POINTS        CONFIG_TRACK_BUFFER_POINTS
+#define MAX_WINDOW_S        600     // point ages are 10 ms units in a u16
+
+typedef struct {
+    uint32_t t_ms;
+    int16_t x;
+    int16_t y;
+} track_point_t;
+
+// Ring written by the UART parser
+static track_point_t s_points[TRACK_POINTS];
+static uint16_t s_head;         // next write index
+static uint16_t s_count;
+static SemaphoreHandle_t s_lock;
+
+// Export scratch, serialized by s_export_lock so the ring lock is only held for the copy
+static track_point_t s_window[TRACK_POINTS];
+static uint8_t s_keep[(TRACK_POINTS + 7) / 8];
+static uint16_t s_stack[TRACK_POINTS][2];
+static SemaphoreHandle_t s_export_lock;
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static inline void keep(uint16_t i)
+{
+    s_keep[i / 8] |= 1 << (i % 8);
+}
+
+static inline bool kept(uint16_t i)
+{
+    return s_keep[i / 8] & (1 << (i % 8));
+}
+
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+// Ramer-Douglas-Peucker over s_window[0..n), iterative with a preallocated
+// stack. Marks the points to keep in s_keep.
+static void decimate(uint16_t n, uint16_t epsilon_cm)
+{
+    memset(s_keep, 0, sizeof(s_keep));
+    if (n == 0) {
+        return;
+    }
+    keep(0);
+    keep(n - 1);
+
+    int sp = 0;
+    s_stack[sp][0] = 0;
+    s_stack[sp][1] = n - 1;
+    sp++;
+
+    while (sp > 0) {
+        sp--;
+        uint16_t a = s_stack[sp][0];
+        uint16_t b = s_stack[sp][1];
+        if (b - a < 2) {
+            continue;
+        }
+
+        int32_t dx = s_window[b].x - s_window[a].x;
+        int32_t dy = s_window[b].y - s_window[a].y;
+        uint64_t len2 = (uint64_t)((int64_t)dx * dx + (int64_t)dy * dy);
+
+        // Distance to the line through a and b is |cross| / |ab|; when a and b
+        // coincide (a loop back to the start) use the distance to a instead.
+        uint64_t best = 0;
+        uint16_t best_i = a;
+        for (uint16_t i = a + 1; i < b; i++) {
+            int64_t px = s_window[i].x - s_window[a].x;
+            int64_t py = s_window[i].y - s_window[a].y;
+            uint64_t d = len2 ? (uint64_t)llabs(px * dy - py * dx) : (uint64_t)(px * px + py * py);
+            if (d > best) {
+                best = d;
+                best_i = i;
+            }
+        }
+        uint64_t limit = len2 ? (uint64_t)epsilon_cm * isqrt64(len2)
+                              : (uint64_t)epsilon_cm * epsilon_cm;
+        if (best <= limit) {
+            continue;
+        }
+
+        keep(best_i);
+        s_stack[sp][0] = a;
+        s_stack[sp][1] = best_i;
+        sp++;
+        s_stack[sp][0] = best_i;
+        s_stack[sp][1] = b;
+        sp++;
+    }
+}
+
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    return p + 2;
+}
+
+void track_buffer_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_export_lock = xSemaphoreCreateMutex();
+}
+
+void track_buffer_add(int16_t x, int16_t y)
+{
+    track_point_t p = { now_ms(), x, y };
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_points[s_head] = p;
+    s_head = (s_head + 1) % TRACK_POINTS;
+    if (s_count < TRACK_POINTS) {
+        s_count++;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+size_t track_buffer_export(uint8_t *buf, track_reason_t reason, uint16_t window_s, uint16_t epsilon_cm)
+{
+    if (window_s > MAX_WINDOW_S) {
+        window_s = MAX_WINDOW_S;
+    }
+    uint32_t window_ms = (uint32_t)window_s * 1000;
+
+    xSemaphoreTake(s_export_lock, portMAX_DELAY);
+
+    // Copy the window out, oldest first
+    uint32_t now = now_ms();
+    uint16_t n = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint16_t i = 0; i < s_count; i++) {
+        const track_point_t *p = &s_points[(s_head + TRACK_POINTS - s_count + i) % TRACK_POINTS];
+        if (now - p->t_ms <= window_ms) {
+            s_window[n++] = *p;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    decimate(n, epsilon_cm);
+
+    uint8_t *out = buf + TRACK_EXPORT_HDR_LEN;
+    uint16_t kept_count = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        if (!kept(i)) {
+            continue;
+        }
+        out = put_u16(out, (uint16_t)((now - s_window[i].t_ms) / 10));
+        out = put_u16(out, (uint16_t)s_window[i].x);
+        out = put_u16(out, (uint16_t)s_window[i].y);
+        kept_count++;
+    }
+
+    uint8_t *h = buf;
+    *h++ = TRACK_EXPORT_VERSION;
+    *h++ = (uint8_t)reason;
+    h = put_u16(h, window_s);
+    h = put_u16(h, epsilon_cm);
+    put_u16(h, kept_count);
+
+    xSemaphoreGive(s_export_lock);
+    return (size_t)(out - buf);
+}
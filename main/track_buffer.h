@@ -0,0 +1,48 @@
+#ifndef TRACK_BUFFER_H
+#define TRACK_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+// Fixed-size history of trajectory points (0x83/0x12 reports) with a
+// Ramer-Douglas-Peucker decimated export. All memory is static; adding a
+// point never allocates.
+//
+// Export layout (little-endian):
+//
+// offset size  field
+//   0     1    format version (TRACK_EXPORT_VERSION)
+//   1     1    reason (track_reason_t)
+//   2     2    window covered (seconds)
+//   4     2    RDP tolerance (cm)
+//   6     2    point count (n)
+//   8     6n   points, oldest first: u16 age before the export (10 ms units),
+//              int16 x, int16 y (cm)
+#define TRACK_EXPORT_VERSION    1
+#define TRACK_EXPORT_HDR_LEN    8
+#define TRACK_EXPORT_POINT_LEN  6
+
+#ifndef CONFIG_TRACK_BUFFER_POINTS
+#define CONFIG_TRACK_BUFFER_POINTS 512
+#endif
+
+// Largest possible export: every buffered point kept
+#define TRACK_EXPORT_MAX_LEN (TRACK_EXPORT_HDR_LEN + CONFIG_TRACK_BUFFER_POINTS * TRACK_EXPORT_POINT_LEN)
+
+typedef enum {
+    TRACK_REASON_REQUEST = 0,   // asked for over MQTT
+    TRACK_REASON_FALL,          // attached to a fall alarm
+} track_reason_t;
+
+void track_buffer_init(void);
+
+// Record a point at the current time. Called from the UART parser.
+void track_buffer_add(int16_t x, int16_t y);
+
+// Encode the points from the last window_s seconds, decimated so that no
+// dropped point is further than epsilon_cm from the exported path. buf must
+// hold TRACK_EXPORT_MAX_LEN bytes. Returns the encoded length.
+size_t track_buffer_export(uint8_t *buf, track_reason_t reason, uint16_t window_s, uint16_t epsilon_cm);
+
+#endif // TRACK_BUFFER_H
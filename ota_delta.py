@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# Delta firmware patches for esp32-R60AFD1 (format: main/delta_patch.h)
+#
+#   python ota_delta.py make build/old/esp32-R60AFD1.bin build/esp32-R60AFD1.bin build/1.0.4.patch
+#   python ota_delta.py apply build/old/esp32-R60AFD1.bin build/1.0.4.patch rebuilt.bin
+#   python ota_delta.py info build/1.0.4.patch
+#
+# The device applies a patch only on top of the exact image it was made from
+# (the source SHA-256 in the header must match the running firmware), so keep
+# the .bin of every released version.
+
+import argparse
+import hashlib
+import re
+import struct
+import sys
+
+MAGIC = b"R6DP"
+VERSION = 1
+HEADER = struct.Struct("<4sB3xII32s32s")
+
+OP_END = 0x00
+OP_ADD = 0x01
+OP_INSERT = 0x02
+
+BLOCK = 16          # bytes hashed to find a candidate match
+STRIDE = 4          # source positions indexed (every STRIDE bytes)
+CANDIDATES = 4      # source positions kept per block
+MIN_SCORE = 16      # 2 * matching bytes - length needed to use a match
+GIVE_UP = 32        # stop extending once this far below the best score
+
+NONZERO_GROUPS = re.compile(rb"[^\x00]+(?:\x00{1,2}[^\x00]+)*")
+
+
+def varint(v):
+    out = bytearray()
+    while True:
+        b = v & 0x7F
+        v >>= 7
+        if v:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def zigzag(v):
+    return (v << 1) if v >= 0 else ((-v << 1) - 1)
+
+
+def read_varint(data, pos):
+    v = shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, pos
+
+
+def build_index(src):
+    index = {}
+    for s in range(0, len(src) - BLOCK + 1, STRIDE):
+        positions = index.setdefault(src[s:s + BLOCK], [])
+        if len(positions) < CANDIDATES:
+            positions.append(s)
+    return index
+
+
+def extend(src, tgt, s, t):
+    """Longest prefix of tgt[t:] that is cheap to express as src[s:] + diff
+    (bsdiff's criterion: maximise 2 * matches - length)."""
+    limit = min(len(src) - s, len(tgt) - t)
+    i = matches = best = best_i = 0
+    while i < limit:
+        # Fast path over identical stretches
+        while i + 64 <= limit and src[s + i:s + i + 64] == tgt[t + i:t + i + 64]:
+            i += 64
+            matches += 64
+        if 2 * matches - i > best:
+            best, best_i = 2 * matches - i, i
+        if i >= limit:
+            break
+        if src[s + i] == tgt[t + i]:
+            matches += 1
+        i += 1
+        score = 2 * matches - i
+        if score > best:
+            best, best_i = score, i
+        elif score < best - GIVE_UP:
+            break
+    return best_i, best
+
+
+def encode_add(src, tgt, s, t, length):
+    diff = bytes((tgt[t + i] - src[s + i]) & 0xFF for i in range(length))
+    out = bytearray()
+    prev = 0
+    for m in NONZERO_GROUPS.finditer(diff):
+        out += varint(m.start() - prev)
+        out += varint(m.end() - m.start())
+        out += m.group()
+        prev = m.end()
+    if prev < length:
+        out += varint(length - prev)
+    return bytes(out)
+
+
+def make_patch(src, tgt):
+    index = build_index(src)
+    ops = bytearray()
+    stats = {"add": 0, "insert": 0, "copied": 0, "inserted": 0}
+    src_pos = 0
+    t = lit_start = 0
+    last_delta = None
+
+    def flush_literal(end):
+        if end > lit_start:
+            ops.append(OP_INSERT)
+            ops.extend(varint(end - lit_start))
+            ops.extend(tgt[lit_start:end])
+            stats["insert"] += 1
+            stats["inserted"] += end - lit_start
+
+    while t < len(tgt):
+        candidates = list(index.get(tgt[t:t + BLOCK], ()))
+        # Code moved by a fixed amount keeps matching at the previous alignment
+        if last_delta is not None and 0 <= t + last_delta < len(src):
+            candidates.insert(0, t + last_delta)
+        best_len = best_score = 0
+        best_s = None
+        for s in candidates:
+            length, score = extend(src, tgt, s, t)
+            if score > best_score:
+                best_len, best_score, best_s = length, score, s
+        if best_s is None or best_score < MIN_SCORE:
+            t += 1
+            continue
+
+        flush_literal(t)
+        ops.append(OP_ADD)
+        ops.extend(varint(zigzag(best_s - src_pos)))
+        ops.extend(varint(best_len))
+        ops.extend(encode_add(src, tgt, best_s, t, best_len))
+        stats["add"] += 1
+        stats["copied"] += best_len
+        src_pos = best_s + best_len
+        last_delta = best_s - t
+        t += best_len
+        lit_start = t
+
+    flush_literal(len(tgt))
+    ops.append(OP_END)
+    header = HEADER.pack(MAGIC, VERSION, len(src), len(tgt),
+                         hashlib.sha256(src).digest(), hashlib.sha256(tgt).digest())
+    return header + bytes(ops), stats
+
+
+def apply_patch(src, patch):
+    magic, version, src_size, tgt_size, src_sha, tgt_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a version %d delta patch" % VERSION)
+    if len(src) != src_size or hashlib.sha256(src).digest() != src_sha:
+        raise ValueError("patch was made for a different source image")
+    out = bytearray()
+    pos = HEADER.size
+    src_pos = 0
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_INSERT:
+            length, pos = read_varint(patch, pos)
+            out += patch[pos:pos + length]
+            pos += length
+        elif op == OP_ADD:
+            seek, pos = read_varint(patch, pos)
+            src_pos += (seek >> 1) if not seek & 1 else -(seek >> 1) - 1
+            remaining, pos = read_varint(patch, pos)
+            while remaining:
+                run, pos = read_varint(patch, pos)
+                out += src[src_pos:src_pos + run]
+                src_pos += run
+                remaining -= run
+                if not remaining:
+                    break
+                count, pos = read_varint(patch, pos)
+                for b in patch[pos:pos + count]:
+                    out.append((src[src_pos] + b) & 0xFF)
+                    src_pos += 1
+                pos += count
+                remaining -= count
+        else:
+            raise ValueError("unknown operation 0x%02x at %d" % (op, pos - 1))
+    if pos != len(patch):
+        raise ValueError("data after end of patch")
+    if len(out) != tgt_size or hashlib.sha256(out).digest() != tgt_sha:
+        raise ValueError("patched image does not match the target hash")
+    return bytes(out)
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def cmd_make(args):
+    src, tgt = read(args.old), read(args.new)
+    patch, stats = make_patch(src, tgt)
+    if apply_patch(src, patch) != tgt:
+        sys.exit("internal error: patch does not reproduce the new image")
+    with open(args.patch, "wb") as f:
+        f.write(patch)
+    print("source  %8d bytes  sha256 %s" % (len(src), hashlib.sha256(src).hexdigest()))
+    print("target  %8d bytes  sha256 %s" % (len(tgt), hashlib.sha256(tgt).hexdigest()))
+    print("patch   %8d bytes  (%.1f%% of target, %d add / %d insert ops, %d literal bytes)"
+          % (len(patch), 100.0 * len(patch) / max(len(tgt), 1),
+             stats["add"], stats["insert"], stats["inserted"]))
+    print('OTA job: {"url": "<url of %s>", "delta": true, "sha256": "%s"}'
+          % (args.patch, hashlib.sha256(tgt).hexdigest()))
+
+
+def cmd_apply(args):
+    out = apply_patch(read(args.old), read(args.patch))
+    with open(args.out, "wb") as f:
+        f.write(out)
+    print("wrote %d bytes, sha256 %s" % (len(out), hashlib.sha256(out).hexdigest()))
+
+
+def cmd_info(args):
+    magic, version, src_size, tgt_size, src_sha, tgt_sha = HEADER.unpack_from(read(args.patch))
+    print("magic %s version %d" % (magic.decode(errors="replace"), version))
+    print("source %d bytes sha256 %s" % (src_size, src_sha.hex()))
+    print("target %d bytes sha256 %s" % (tgt_size, tgt_sha.hex()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Delta OTA patches for esp32-R60AFD1")
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("make", help="create a patch from OLD to NEW")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("patch")
+    p.set_defaults(func=cmd_make)
+    p = sub.add_parser("apply", help="rebuild NEW from OLD and a patch (host check)")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("out")
+    p.set_defaults(func=cmd_apply)
+    p = sub.add_parser("info", help="print a patch header")
+    p.add_argument("patch")
+    p.set_defaults(func=cmd_info)
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()